@@ -0,0 +1,298 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef ASYNCIO_H_
+#define ASYNCIO_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+#include "InputSource.h"
+#include "OutputSink.h"
+#include "SpscRing.h"
+
+
+namespace whitepp {
+
+/**
+ * This class implements a dedicated I/O thread that owns two file
+ * descriptors.
+ *
+ * The virtual machine exchanges data with the thread through lock-free ring
+ * buffers, using input() and output().  It only waits when the input ring
+ * is empty or the output ring is full; these stalls are counted.  A short
+ * wait spins, a longer one blocks until the I/O thread wakes it.
+ */
+class AsyncIo {
+
+public:
+
+  /**
+   * The size of each ring buffer.
+   */
+  static std::size_t const ring_size = 1 << 20;
+
+
+  /**
+   * The statistics of stalls in one direction.
+   */
+  struct Stalls {
+
+    /**
+     * The number of stalls.
+     */
+    unsigned long long count = 0;
+
+
+    /**
+     * The time spent waiting, in nanoseconds.
+     */
+    unsigned long long nanoseconds = 0;
+
+  };
+
+
+private:
+
+  /**
+   * This class implements the input source reading from the input ring.
+   */
+  class Input : public InputSource {
+
+  private:
+
+    AsyncIo& io_;
+
+
+    std::unique_ptr<char[]> buffer_;
+
+
+  protected:
+
+    virtual bool refill() override;
+
+
+  public:
+
+    Input(AsyncIo& io);
+
+  };
+
+
+  /**
+   * This class implements the output sink writing to the output ring.
+   */
+  class Output : public OutputSink {
+
+  private:
+
+    AsyncIo& io_;
+
+
+  protected:
+
+    virtual void write(char const* data, std::size_t size) override;
+
+
+  public:
+
+    Output(AsyncIo& io) : io_(io) {}
+
+  };
+
+
+  /**
+   * The file descriptor input is read from.
+   */
+  int in_fd_;
+
+
+  /**
+   * The file descriptor output is written to.
+   */
+  int out_fd_;
+
+
+  SpscRing<char> input_ring_;
+
+
+  SpscRing<char> output_ring_;
+
+
+  /**
+   * Set by the I/O thread at the end of the input.
+   */
+  std::atomic<bool> input_eof_;
+
+
+  /**
+   * Set by the I/O thread if writing the output failed.
+   */
+  std::atomic<bool> output_failed_;
+
+
+  /**
+   * Set by the I/O thread before it waits for events.
+   */
+  std::atomic<bool> sleeping_;
+
+
+  /**
+   * Set to stop the I/O thread.
+   */
+  std::atomic<bool> stop_;
+
+
+  /**
+   * A pipe used to wake up the I/O thread.
+   */
+  int wake_pipe_[2];
+
+
+  /**
+   * Set by the virtual machine before it blocks in a stall.
+   */
+  std::atomic<bool> blocked_;
+
+
+  std::mutex stall_mutex_;
+
+
+  /**
+   * Signalled by the I/O thread when it moved data or ended a direction
+   * while the virtual machine is blocked.
+   */
+  std::condition_variable stall_cv_;
+
+
+  Stalls input_stalls_;
+
+
+  Stalls output_stalls_;
+
+
+  Input input_;
+
+
+  Output output_;
+
+
+  std::thread thread_;
+
+
+  /**
+   * The main loop of the I/O thread.
+   */
+  void serve();
+
+
+  /**
+   * Write the content of the output ring.
+   *
+   * @returns false if writing failed.
+   */
+  bool drain_output();
+
+
+  /**
+   * Wake up the I/O thread if it waits for events.
+   */
+  void wake();
+
+
+  /**
+   * Wake up the virtual machine if it is blocked in a stall.
+   */
+  void wake_vm();
+
+
+  /**
+   * Wait in the virtual machine until a condition holds, spinning first and
+   * blocking later.
+   *
+   * @param condition The condition, which only the I/O thread or a signal
+   *                  can make true.
+   * @param stalls Receives the time spent waiting.
+   */
+  template <typename Condition>
+  void wait_until(Condition condition, Stalls& stalls);
+
+
+public:
+
+  /**
+   * The standard constructor, which starts the I/O thread.
+   *
+   * @param in_fd The file descriptor to read input from.
+   * @param out_fd The file descriptor to write output to.
+   * @throws std::runtime_error if the thread cannot be started.
+   */
+  AsyncIo(int const in_fd, int const out_fd);
+
+
+  /**
+   * The destructor, which calls stop().
+   */
+  ~AsyncIo();
+
+
+  /**
+   * @returns The input source reading from the I/O thread.
+   */
+  InputSource& input() {
+    return input_;
+  }
+
+
+  /**
+   * @returns The output sink writing to the I/O thread.
+   */
+  OutputSink& output() {
+    return output_;
+  }
+
+
+  /**
+   * Flush the output sink, write all output and stop the I/O thread.
+   */
+  void stop();
+
+
+  /**
+   * @returns The stalls waiting for input.
+   */
+  Stalls const& get_input_stalls() const {
+    return input_stalls_;
+  }
+
+
+  /**
+   * @returns The stalls waiting for room in the output ring.
+   */
+  Stalls const& get_output_stalls() const {
+    return output_stalls_;
+  }
+
+
+  /**
+   * Print the statistics of stalls.
+   *
+   * @param out The output stream.
+   */
+  void print_stalls(std::ostream& out) const;
+
+};
+
+} // namespace whitepp
+
+
+#endif // ASYNCIO_H_
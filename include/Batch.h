@@ -0,0 +1,161 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <chrono>
+#include <cstddef>
+#include <istream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Program.h"
+#include "WorkStealingPool.h"
+
+
+namespace whitepp {
+
+/**
+ * This class runs many jobs, each a program with an input and an output
+ * file, in one process.
+ *
+ * The manifest lists one job per line as "PROGRAM INPUT OUTPUT", where "-"
+ * stands for empty input or discarded output.  Empty lines and lines
+ * starting with '#' are skipped.  Every distinct program is parsed once and
+ * shared read-only by all virtual machines running it.
+ */
+class Batch {
+
+private:
+
+  /**
+   * A job and its result.
+   */
+  struct Job {
+
+    std::string program;
+
+
+    std::string input;
+
+
+    std::string output;
+
+
+    /**
+     * True iff the program ended normally.
+     */
+    bool ok = false;
+
+
+    /**
+     * The error message if the job failed.
+     */
+    std::string error;
+
+
+    /**
+     * The number of instructions performed.
+     */
+    unsigned long long steps = 0;
+
+
+    /**
+     * The wall-clock time of the job.
+     */
+    std::chrono::steady_clock::duration time = std::chrono::steady_clock::duration::zero();
+
+  };
+
+
+  std::vector<Job> jobs_;
+
+
+  /**
+   * The parsed programs, or nullptr if a program cannot be parsed.
+   */
+  std::map<std::string, std::shared_ptr<Program const>> programs_;
+
+
+  /**
+   * The error messages of the programs that cannot be parsed.
+   */
+  std::map<std::string, std::string> program_errors_;
+
+
+  /**
+   * The wall-clock time of parsing the programs.
+   */
+  std::chrono::steady_clock::duration parse_time_;
+
+
+  /**
+   * The wall-clock time of running the jobs.
+   */
+  std::chrono::steady_clock::duration run_time_;
+
+
+  /**
+   * Run one job.
+   *
+   * @param job The job.
+   * @param max_steps The maximal number of instructions of the job.
+   */
+  void run_job(Job& job, unsigned long long const max_steps);
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param manifest The manifest.
+   * @throws std::runtime_error if the manifest is malformed.
+   */
+  Batch(std::istream& manifest);
+
+
+  /**
+   * The destructor.
+   */
+  ~Batch() {}
+
+
+  /**
+   * Parse the programs and run all jobs.
+   *
+   * @param pool The threads to run the jobs on.
+   * @param max_steps The maximal number of instructions of each job.
+   */
+  void run(WorkStealingPool& pool, unsigned long long const max_steps =
+           std::numeric_limits<unsigned long long>::max());
+
+
+  /**
+   * Print one tab-separated line per job and a total.
+   *
+   * @param out The stream to print to.
+   */
+  void print_summary(std::ostream& out) const;
+
+
+  /**
+   * @returns The number of jobs that failed.
+   */
+  std::size_t get_failures() const;
+
+};
+
+} // namespace whitepp
+
+
+#endif // BATCH_H_
@@ -0,0 +1,239 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef COWHEAP_H_
+#define COWHEAP_H_
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+namespace whitepp {
+
+/**
+ * This class implements a heap whose memory is divided into copy-on-write
+ * pages.
+ *
+ * Copying a heap is O(1).  Afterwards both copies share all pages, and a page
+ * is only duplicated when one of the copies writes to it.  Copies never write
+ * to the heap they were copied from, so several threads may copy the same
+ * heap concurrently.
+ */
+class CowHeap {
+
+public:
+
+  /**
+   * The number of cells of a page is 2^page_bits.
+   */
+  static int const page_bits = 8;
+
+
+  static int const page_size = 1 << page_bits;
+
+
+private:
+
+  /**
+   * A page of consecutive heap cells.
+   */
+  struct Page {
+
+    /**
+     * The values of the cells.
+     */
+    std::array<int, page_size> values;
+
+
+    /**
+     * The cells that were written to.
+     */
+    std::bitset<page_size> used;
+
+
+    Page() : values() {}
+
+  };
+
+
+  typedef std::map<int, std::shared_ptr<Page>> table_t;
+
+
+  /**
+   * The page table, which is shared between copies as well.
+   */
+  std::shared_ptr<table_t> table_;
+
+
+  /**
+   * The number of cells that were written to.
+   */
+  std::size_t size_;
+
+
+  /**
+   * The key of the last page accessed.
+   */
+  mutable int cache_key_;
+
+
+  /**
+   * The entry of the last page accessed in the page table, or nullptr.
+   */
+  mutable std::shared_ptr<Page>* cache_slot_;
+
+
+  /**
+   * @param key The key of a page.
+   * @returns The page, which is not shared, created if necessary.
+   */
+  Page& writable_page(int const key);
+
+
+  static int key_of(int const address) {
+    return address >> page_bits;
+  }
+
+
+  static int index_of(int const address) {
+    return address & (page_size - 1);
+  }
+
+
+public:
+
+  /**
+   * The standard constructor.
+   */
+  CowHeap() :
+      table_(std::make_shared<table_t>()), size_(0),
+      cache_key_(0), cache_slot_(nullptr) {}
+
+
+  /**
+   * The copy constructor, which shares all pages with other.
+   */
+  CowHeap(CowHeap const& other) :
+      table_(other.table_), size_(other.size_),
+      cache_key_(0), cache_slot_(nullptr) {}
+
+
+  /**
+   * The assignment operator, which shares all pages with other.
+   */
+  CowHeap& operator=(CowHeap const& other) {
+
+    table_ = other.table_;
+    size_ = other.size_;
+
+    cache_slot_ = nullptr;
+
+    return *this;
+  }
+
+
+  /**
+   * The destructor.
+   */
+  ~CowHeap() {}
+
+
+  /**
+   * @param address An address.
+   * @returns The value stored at address, or 0 if there is none.
+   */
+  int get(int const address) const {
+
+    auto const key = key_of(address);
+
+    if (cache_slot_ == nullptr || cache_key_ != key) {
+
+      auto const it = table_->find(key);
+      if (it == table_->end()) {
+        return 0;
+      }
+
+      cache_key_ = key;
+      cache_slot_ = &it->second;
+    }
+
+    return (*cache_slot_)->values[index_of(address)];
+  }
+
+
+  /**
+   * Store a value.
+   *
+   * @param address The address.
+   * @param value The value.
+   */
+  void set(int const address, int const value) {
+
+    auto const key = key_of(address);
+
+    // The cached page may only be written to if neither it nor the page
+    // table is shared with a copy.
+    Page& page = (cache_slot_ != nullptr && cache_key_ == key &&
+                  table_.use_count() == 1 && cache_slot_->use_count() == 1)
+        ? **cache_slot_ : writable_page(key);
+
+    auto const index = index_of(address);
+    if (!page.used[index]) {
+      page.used[index] = true;
+      ++size_;
+    }
+
+    page.values[index] = value;
+  }
+
+
+  /**
+   * @returns The number of cells that were written to.
+   */
+  std::size_t size() const {
+    return size_;
+  }
+
+
+  /**
+   * @returns The number of pages.
+   */
+  std::size_t page_count() const {
+    return table_->size();
+  }
+
+
+  /**
+   * @returns The memory taken by the pages, in bytes.
+   */
+  std::size_t bytes() const {
+    return table_->size() * sizeof(Page);
+  }
+
+
+  /**
+   * @returns All cells that were written to, ordered by address.
+   */
+  std::vector<std::pair<int, int>> entries() const;
+
+
+  /**
+   * Remove all cells.
+   */
+  void clear();
+
+};
+
+} // namespace whitepp
+
+
+#endif // COWHEAP_H_
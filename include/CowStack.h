@@ -0,0 +1,345 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef COWSTACK_H_
+#define COWSTACK_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+
+namespace whitepp {
+
+/**
+ * This class implements a stack that consists of persistent chunks.
+ *
+ * The elements pushed since the stack was last frozen live in an ordinary
+ * vector.  Freezing moves that vector into an immutable chunk, which copies
+ * of the stack share, so copying a frozen stack is O(1).  Popping into a
+ * frozen chunk copies at most thaw_size elements of it back into the vector.
+ *
+ * Copying never modifies the original, so a stack may be copied by several
+ * threads concurrently.
+ */
+template <typename T>
+class CowStack {
+
+public:
+
+  /**
+   * The maximal number of elements copied out of a frozen chunk at once.
+   */
+  static std::size_t const thaw_size = 1024;
+
+
+private:
+
+  /**
+   * An immutable chunk of the stack.
+   */
+  struct Chunk {
+
+    /**
+     * The elements, the first one at the bottom.
+     */
+    std::vector<T> values;
+
+
+    /**
+     * The chunk below, or nullptr.
+     */
+    std::shared_ptr<Chunk const> below;
+
+
+    /**
+     * The number of elements of the chunk below that belong to the stack.
+     */
+    std::size_t below_top;
+
+  };
+
+
+  /**
+   * The elements above the frozen chunks.
+   */
+  std::vector<T> live_;
+
+
+  /**
+   * The topmost frozen chunk, or nullptr.
+   */
+  std::shared_ptr<Chunk const> frozen_;
+
+
+  /**
+   * The number of elements of the topmost frozen chunk that belong to this
+   * stack.
+   */
+  std::size_t frozen_top_;
+
+
+  /**
+   * The number of elements in all frozen chunks belonging to this stack.
+   */
+  std::size_t frozen_size_;
+
+
+  /**
+   * Copy elements of the topmost frozen chunk back into the vector.
+   *
+   * @throws std::runtime_error if the stack is empty.
+   */
+  void thaw() {
+
+    while (frozen_ && frozen_top_ == 0) {
+
+      frozen_top_ = frozen_->below_top;
+      frozen_ = frozen_->below;
+    }
+
+    if (!frozen_) {
+      throw std::runtime_error("Runtime error: Stack underflow!");
+    }
+
+    auto const count = (frozen_top_ < thaw_size) ? frozen_top_ : thaw_size;
+    auto const first = frozen_->values.begin() + (frozen_top_ - count);
+
+    live_.insert(live_.begin(), first, first + count);
+
+    frozen_top_ -= count;
+    frozen_size_ -= count;
+  }
+
+
+public:
+
+  /**
+   * The standard constructor.
+   */
+  CowStack() : frozen_top_(0), frozen_size_(0) {}
+
+
+  /**
+   * The copy constructor, which shares the frozen elements with other and
+   * copies the others.
+   */
+  CowStack(CowStack const& other) = default;
+
+
+  /**
+   * The assignment operator, which shares the frozen elements with other
+   * and copies the others.
+   */
+  CowStack& operator=(CowStack const& other) = default;
+
+
+  /**
+   * The destructor.
+   */
+  ~CowStack() {}
+
+
+  /**
+   * Move the elements above the frozen chunks into a new frozen chunk, so
+   * the stack can be copied in O(1).
+   */
+  void freeze() {
+
+    if (live_.empty()) {
+      return;
+    }
+
+    auto const count = live_.size();
+
+    auto chunk = std::make_shared<Chunk>();
+    chunk->values = std::move(live_);
+    chunk->below = frozen_;
+    chunk->below_top = frozen_top_;
+
+    frozen_ = chunk;
+    frozen_top_ = count;
+    frozen_size_ += count;
+
+    live_.clear();
+  }
+
+
+  /**
+   * @returns The topmost element.
+   * @throws std::runtime_error if the stack is empty.
+   */
+  T& back() {
+
+    if (live_.empty()) {
+      thaw();
+    }
+
+    return live_.back();
+  }
+
+
+  /**
+   * Read an element near the top without thawing it.
+   *
+   * @param value Set to the element, if there is one.
+   * @param depth The number of elements above it.
+   * @returns false iff the stack has at most depth elements.
+   */
+  bool peek(T& value, std::size_t depth = 0) const {
+
+    if (depth < live_.size()) {
+
+      value = live_[live_.size() - 1 - depth];
+      return true;
+    }
+
+    depth -= live_.size();
+
+    for (auto chunk = std::make_pair(frozen_.get(), frozen_top_);
+         chunk.first != nullptr;
+         chunk = std::make_pair(chunk.first->below.get(), chunk.first->below_top)) {
+
+      if (depth < chunk.second) {
+
+        value = chunk.first->values[chunk.second - 1 - depth];
+        return true;
+      }
+
+      depth -= chunk.second;
+    }
+
+    return false;
+  }
+
+
+  /**
+   * Remove the topmost element.
+   *
+   * @throws std::runtime_error if the stack is empty.
+   */
+  void pop_back() {
+
+    if (live_.empty()) {
+      thaw();
+    }
+
+    live_.pop_back();
+  }
+
+
+  /**
+   * Add an element on top.
+   */
+  void emplace_back(T const value) {
+    live_.emplace_back(value);
+  }
+
+
+  /**
+   * @returns The number of elements.
+   */
+  std::size_t size() const {
+    return frozen_size_ + live_.size();
+  }
+
+
+  /**
+   * @returns true iff there are no elements.
+   */
+  bool empty() const {
+    return size() == 0;
+  }
+
+
+  /**
+   * @returns All elements, the first one at the bottom.
+   */
+  std::vector<T> to_vector() const {
+
+    std::vector<std::pair<Chunk const*, std::size_t>> chunks;
+    for (auto chunk = std::make_pair(frozen_.get(), frozen_top_);
+         chunk.first != nullptr;
+         chunk = std::make_pair(chunk.first->below.get(), chunk.first->below_top)) {
+      chunks.emplace_back(chunk);
+    }
+
+    std::vector<T> result;
+    result.reserve(size());
+
+    for (auto it = chunks.rbegin(); it != chunks.rend(); ++it) {
+
+      auto const& values = it->first->values;
+      result.insert(result.end(), values.begin(), values.begin() + it->second);
+    }
+
+    result.insert(result.end(), live_.begin(), live_.end());
+
+    return result;
+  }
+
+
+  /**
+   * @param count The maximal number of elements.
+   * @returns The topmost count elements, the first one lowest.  Unlike
+   *          to_vector(), this takes O(count) time.
+   */
+  std::vector<T> top(std::size_t count) const {
+
+    std::vector<T> result;
+    result.reserve(std::min(count, size()));
+
+    // Collected top down, reversed at the end.
+    for (auto it = live_.rbegin(); it != live_.rend() && count > 0; ++it, --count) {
+      result.emplace_back(*it);
+    }
+
+    for (auto chunk = std::make_pair(frozen_.get(), frozen_top_);
+         chunk.first != nullptr && count > 0;
+         chunk = std::make_pair(chunk.first->below.get(), chunk.first->below_top)) {
+
+      for (auto i = chunk.second; i > 0 && count > 0; --i, --count) {
+        result.emplace_back(chunk.first->values[i - 1]);
+      }
+    }
+
+    std::reverse(result.begin(), result.end());
+
+    return result;
+  }
+
+
+  /**
+   * Replace all elements.
+   *
+   * @param values The new elements, the first one at the bottom.
+   */
+  void assign(std::vector<T> const& values) {
+
+    live_ = values;
+    frozen_.reset();
+    frozen_top_ = 0;
+    frozen_size_ = 0;
+  }
+
+
+  /**
+   * Remove all elements.
+   */
+  void clear() {
+    assign({});
+  }
+
+};
+
+} // namespace whitepp
+
+
+#endif // COWSTACK_H_
@@ -0,0 +1,216 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CowHeap.h"
+#include "InputSource.h"
+#include "OutputSink.h"
+#include "Program.h"
+#include "VirtualMachine.h"
+
+
+namespace whitepp {
+
+/**
+ * This class is the interface through which Lockstep drives an engine that
+ * executes programs.
+ *
+ * Positions are indices of the instructions of the original program, so an
+ * engine that translates the program has to map them back.  It only has to
+ * do so at the basic block boundaries run_for() is asked to stop at.
+ */
+class Engine {
+
+public:
+
+  /**
+   * The destructor.
+   */
+  virtual ~Engine() {}
+
+
+  /**
+   * @returns The name of the engine.
+   */
+  virtual std::string get_name() const = 0;
+
+
+  /**
+   * Perform instructions until the program ends, that is the program counter
+   * passes the last instruction, or the given number of instructions was
+   * performed.
+   *
+   * @param max_steps The number of instructions to perform.
+   * @param written Receives the address of every heap cell written to.
+   * @throws std::runtime_error if the program fails.
+   */
+  virtual void run_for(unsigned long long const max_steps, std::vector<int>& written) = 0;
+
+
+  /**
+   * @returns The index of the next instruction.
+   */
+  virtual unsigned int get_program_counter() const = 0;
+
+
+  /**
+   * @returns The number of instructions performed.
+   */
+  virtual unsigned long long get_steps() const = 0;
+
+
+  /**
+   * @returns The number of values on the stack.
+   */
+  virtual std::size_t get_stack_size() const = 0;
+
+
+  /**
+   * @param count The maximal number of values.
+   * @returns The topmost count values of the stack, the first one lowest.
+   */
+  virtual std::vector<int> get_stack_top(std::size_t const count) const = 0;
+
+
+  /**
+   * @returns The heap.
+   */
+  virtual CowHeap const& get_heap() const = 0;
+
+};
+
+
+/**
+ * This class is the reference engine, VirtualMachine, which defines the
+ * semantics every other engine has to match.
+ */
+class ReferenceEngine : public Engine {
+
+private:
+
+  VirtualMachine vm_;
+
+
+  /**
+   * For each instruction, 0 if it does not write to the heap, or 1 plus the
+   * depth of the address on the stack.
+   */
+  std::vector<unsigned char> writes_;
+
+
+  /**
+   * An observer that records the address the next instruction writes to.
+   */
+  struct WriteObserver {
+
+    ReferenceEngine const& engine;
+
+
+    std::vector<int>& written;
+
+
+    void step(unsigned int const, unsigned int const next) {
+
+      if (next < engine.writes_.size() && engine.writes_[next] != 0) {
+        engine.record_write(next, written);
+      }
+    }
+
+  };
+
+
+  /**
+   * Record the address an instruction will write to.
+   */
+  void record_write(unsigned int const index, std::vector<int>& written) const;
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param program The program.
+   * @param in The source of the input, which must outlive the engine.
+   * @param out The destination of the output, which must outlive the engine.
+   */
+  ReferenceEngine(std::shared_ptr<Program const> const& program, InputSource& in,
+                  OutputSink& out);
+
+
+  /**
+   * The destructor.
+   */
+  virtual ~ReferenceEngine() {}
+
+
+  virtual std::string get_name() const override {
+    return "reference";
+  }
+
+
+  virtual void run_for(unsigned long long const max_steps, std::vector<int>& written) override;
+
+
+  virtual unsigned int get_program_counter() const override {
+    return vm_.get_program_counter();
+  }
+
+
+  virtual unsigned long long get_steps() const override {
+    return vm_.get_steps();
+  }
+
+
+  virtual std::size_t get_stack_size() const override {
+    return vm_.get_stack().size();
+  }
+
+
+  virtual std::vector<int> get_stack_top(std::size_t const count) const override {
+    return vm_.get_stack().top(count);
+  }
+
+
+  virtual CowHeap const& get_heap() const override {
+    return vm_.get_heap();
+  }
+
+};
+
+
+/**
+ * @returns The names of the engines make_engine() knows.
+ */
+std::vector<std::string> engine_names();
+
+
+/**
+ * Construct an engine by name.
+ *
+ * @param name The name of the engine.
+ * @param program The program.
+ * @param in The source of the input, which must outlive the engine.
+ * @param out The destination of the output, which must outlive the engine.
+ * @returns The engine.
+ * @throws std::runtime_error if there is no engine of that name.
+ */
+std::unique_ptr<Engine> make_engine(std::string const& name,
+                                    std::shared_ptr<Program const> const& program,
+                                    InputSource& in, OutputSink& out);
+
+} // namespace whitepp
+
+
+#endif // ENGINE_H_
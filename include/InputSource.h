@@ -0,0 +1,538 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef INPUTSOURCE_H_
+#define INPUTSOURCE_H_
+
+#include <csignal>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "OutputSink.h"
+
+
+namespace whitepp {
+
+/**
+ * This class implements a buffered input source for the virtual machine.
+ *
+ * Characters and integers are read directly from a block of memory that
+ * refill() provides.  At the end of the input, get_char() returns eof and
+ * get_int() fails.
+ */
+class InputSource {
+
+public:
+
+  /**
+   * The value get_char() returns at the end of the input.
+   */
+  static int const eof = -1;
+
+
+private:
+
+  /**
+   * The output sink that is flushed before waiting for input, or nullptr.
+   */
+  OutputSink* tie_;
+
+
+  /**
+   * The number of bytes consumed from the blocks before the current one.
+   */
+  unsigned long long consumed_;
+
+
+  /**
+   * The flag passed to wait() while it runs, or nullptr.
+   */
+  volatile std::sig_atomic_t const* interrupt_;
+
+
+  /**
+   * True iff refill() gave up waiting since the flag was set.
+   */
+  bool interrupted_;
+
+
+  /**
+   * Flush the tied output sink and refill the buffer.
+   *
+   * @returns false at the end of the input.
+   */
+  bool fill();
+
+
+protected:
+
+  /**
+   * The next character available.
+   */
+  char const* pos_;
+
+
+  /**
+   * The end of the characters available.
+   */
+  char const* end_;
+
+
+  /**
+   * The start of the current block.  Sources that provide a block in their
+   * constructor rather than in refill() set it, too.
+   */
+  char const* start_;
+
+
+  /**
+   * Make more input available between pos_ and end_.
+   *
+   * @returns false at the end of the input.
+   * @throws std::runtime_error if the input cannot be read.
+   */
+  virtual bool refill() = 0;
+
+
+  /**
+   * @returns true iff the input is not complete yet, but refill() cannot
+   *          provide more of it without waiting.  A source that waits inside
+   *          refill() returns false.
+   */
+  virtual bool is_pending() const {
+    return false;
+  }
+
+
+  /**
+   * Sources that wait inside refill() call this when a signal interrupts
+   * the wait, or may arrive.
+   *
+   * @returns true iff refill() should give up and return false, since the
+   *          flag passed to wait() is set.
+   */
+  bool give_up();
+
+
+  /**
+   * Count the bytes consumed from the current block and let a new one start
+   * at pos_.  Sources that move their block outside of refill() call this
+   * first.
+   */
+  void restart_block() {
+
+    consumed_ += pos_ - start_;
+    start_ = pos_;
+  }
+
+
+public:
+
+  /**
+   * The standard constructor.
+   */
+  InputSource() :
+      tie_(nullptr), consumed_(0), interrupt_(nullptr), interrupted_(false), pos_(nullptr),
+      end_(nullptr), start_(nullptr) {}
+
+
+  /**
+   * The destructor.
+   */
+  virtual ~InputSource() {}
+
+
+  /**
+   * @returns The next character without consuming it, or eof.
+   */
+  int peek() {
+
+    if (pos_ == end_ && !fill()) {
+      return eof;
+    }
+
+    return static_cast<unsigned char>(*pos_);
+  }
+
+
+  /**
+   * @returns The next character, or eof.
+   */
+  int get_char() {
+
+    auto const c = peek();
+    if (c != eof) {
+      ++pos_;
+    }
+
+    return c;
+  }
+
+
+  /**
+   * @returns The number of bytes consumed.
+   */
+  unsigned long long get_bytes_read() const {
+    return consumed_ + (pos_ - start_);
+  }
+
+
+  /**
+   * Read the characters available, waiting only if there are none.
+   *
+   * @param buffer The buffer to fill.
+   * @param size The size of the buffer.
+   * @returns The number of characters read, or 0 at the end of the input.
+   */
+  std::size_t get_block(char* const buffer, std::size_t const size);
+
+
+  /**
+   * Wait until a character is available or the input ends.  A source that
+   * waits inside refill() gives up early once a signal sets the flag.
+   *
+   * @param flag The flag, usually set by a signal handler.
+   * @param skip_space If true, white space is consumed first.
+   * @returns false iff the wait was given up.
+   */
+  bool wait(volatile std::sig_atomic_t const& flag, bool const skip_space);
+
+
+  /**
+   * Read a decimal integer, skipping leading white space.
+   *
+   * @param value Receives the integer.
+   * @returns false if there is no integer in the range of int.
+   */
+  bool get_int(int& value);
+
+
+  /**
+   * Read up to and including the next delimiter, or up to the end of the
+   * input.
+   *
+   * @param record Receives the characters read.
+   * @param delimiter The delimiter.
+   * @returns false if the input ended before any character was read.
+   */
+  bool get_record(std::string& record, char const delimiter);
+
+
+  /**
+   * @returns true iff get_char() can be called without waiting for input
+   *          that did not arrive yet.
+   */
+  bool ready_char() const {
+    return pos_ != end_ || !is_pending();
+  }
+
+
+  /**
+   * @returns true iff get_int() can be called without waiting for input
+   *          that did not arrive yet.
+   */
+  bool ready_int() const;
+
+
+  /**
+   * @param out The output sink to flush before waiting for input, or nullptr.
+   */
+  void tie(OutputSink* const out) {
+    tie_ = out;
+  }
+
+};
+
+
+/**
+ * This class implements an input source that reads from a file descriptor.
+ *
+ * Regular files are mapped into memory as a whole; everything else is read
+ * in large blocks.
+ */
+class FdInputSource : public InputSource {
+
+public:
+
+  /**
+   * The size of the blocks read.
+   */
+  static std::size_t const block_size = 1 << 16;
+
+
+private:
+
+  /**
+   * The file descriptor.
+   */
+  int fd_;
+
+
+  /**
+   * The mapped file, or nullptr.
+   */
+  void* map_;
+
+
+  /**
+   * The size of the mapped file.
+   */
+  std::size_t map_size_;
+
+
+  /**
+   * The buffer for blocks read.
+   */
+  std::unique_ptr<char[]> buffer_;
+
+
+protected:
+
+  virtual bool refill() override;
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param fd The file descriptor, which is not closed by the source.
+   * @param tie The output sink to flush before waiting for input, or nullptr.
+   */
+  FdInputSource(int const fd, OutputSink* const tie = nullptr);
+
+
+  /**
+   * The destructor.
+   */
+  virtual ~FdInputSource();
+
+};
+
+
+/**
+ * This class implements an input source that reads from memory owned by the
+ * caller.
+ */
+class MemoryInputSource : public InputSource {
+
+protected:
+
+  virtual bool refill() override {
+    return false;
+  }
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param data The input, which must outlive the source.
+   * @param size The size of the input.
+   */
+  MemoryInputSource(char const* const data, std::size_t const size) {
+
+    pos_ = start_ = data;
+    end_ = data + size;
+  }
+
+
+  /**
+   * The destructor.
+   */
+  virtual ~MemoryInputSource() {}
+
+};
+
+
+/**
+ * This class implements an input source that reads from a string it owns.
+ */
+class StringInputSource : public InputSource {
+
+private:
+
+  /**
+   * The input.
+   */
+  std::string str_;
+
+
+protected:
+
+  virtual bool refill() override {
+    return false;
+  }
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param str The input.
+   */
+  StringInputSource(std::string const& str) : str_(str) {
+
+    pos_ = start_ = str_.data();
+    end_ = str_.data() + str_.size();
+  }
+
+
+  /**
+   * The destructor.
+   */
+  virtual ~StringInputSource() {}
+
+};
+
+
+/**
+ * This class implements an input source that asks a callback for blocks of
+ * input, e.g. to read from a stream of an embedding application.
+ */
+class CallbackInputSource : public InputSource {
+
+public:
+
+  /**
+   * Reads up to size bytes into the buffer and returns the number read, or
+   * 0 at the end of the input.  May throw std::runtime_error.
+   */
+  typedef std::function<std::size_t(char* buffer, std::size_t size)> read_t;
+
+
+private:
+
+  read_t read_;
+
+
+  /**
+   * The buffer for blocks read.
+   */
+  std::unique_ptr<char[]> buffer_;
+
+
+protected:
+
+  virtual bool refill() override;
+
+
+public:
+
+  /**
+   * The size of the blocks read.
+   */
+  static std::size_t const block_size = 1 << 12;
+
+
+  /**
+   * The standard constructor.
+   *
+   * @param read The callback.
+   */
+  CallbackInputSource(read_t const& read) :
+      read_(read), buffer_(new char[block_size]) {}
+
+
+  /**
+   * The destructor.
+   */
+  virtual ~CallbackInputSource() {}
+
+};
+
+
+/**
+ * This class implements an input source the caller pushes input into while
+ * the program runs.
+ *
+ * It never waits: until close() is called, the virtual machine suspends
+ * instead of reading input that did not arrive yet.
+ */
+class PushInputSource : public InputSource {
+
+private:
+
+  /**
+   * The input, of which the part before pos_ was read already.
+   */
+  std::string buffer_;
+
+
+  /**
+   * True iff the end of the input was pushed.
+   */
+  bool closed_;
+
+
+protected:
+
+  virtual bool refill() override {
+    return false;
+  }
+
+
+  virtual bool is_pending() const override {
+    return !closed_;
+  }
+
+
+public:
+
+  /**
+   * The standard constructor.
+   */
+  PushInputSource() : closed_(false) {}
+
+
+  /**
+   * The destructor.
+   */
+  virtual ~PushInputSource() {}
+
+
+  /**
+   * Append input.
+   *
+   * @param data The bytes.
+   * @param size The number of bytes.
+   */
+  void push(char const* data, std::size_t size);
+
+
+  /**
+   * Mark the end of the input.
+   */
+  void close() {
+    closed_ = true;
+  }
+
+
+  /**
+   * @returns true iff the end of the input was pushed.
+   */
+  bool is_closed() const {
+    return closed_;
+  }
+
+};
+
+
+/**
+ * @returns The input source for the standard input, which is tied to the
+ *          standard output.
+ */
+InputSource& standard_input();
+
+} // namespace whitepp
+
+
+#endif // INPUTSOURCE_H_
@@ -0,0 +1,47 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef LAYOUT_H_
+#define LAYOUT_H_
+
+#include <memory>
+#include <vector>
+
+#include "Program.h"
+
+
+namespace whitepp {
+
+/**
+ * Reorder the instructions of a program by a profile, so the instructions
+ * performed most often are adjacent and cold code moves to the end.
+ *
+ * The program is cut into chains that only end after Jump, Ret and End, so
+ * every chain can move without inserting jumps.  The chain at the start stays
+ * first, and a chain that runs off the end stays last.  The hot chains follow
+ * hottest first, except that a chain ending with a jump to the start of a hot
+ * chain not yet placed is followed by that chain, so the jump continues with
+ * the next instruction.  The chains never performed keep their order at the
+ * end.  The labels move with their instructions, so the program performs the
+ * same instructions in the same number of steps.
+ *
+ * The instructions are copied in their new order, so hot instructions are
+ * also adjacent in memory.
+ *
+ * @param program The program.
+ * @param counts How often each instruction was performed, as collected by a
+ *               Profiler.
+ * @returns The reordered program.
+ * @throws std::runtime_error if counts does not fit the program.
+ */
+std::shared_ptr<Program const> lay_out(std::shared_ptr<Program const> const& program,
+                                       std::vector<unsigned long long> const& counts);
+
+} // namespace whitepp
+
+
+#endif // LAYOUT_H_
@@ -0,0 +1,209 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef LOCKSTEP_H_
+#define LOCKSTEP_H_
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "CowHeap.h"
+#include "Engine.h"
+#include "InputSource.h"
+#include "OutputSink.h"
+#include "Program.h"
+
+
+namespace whitepp {
+
+/**
+ * This class runs an engine in lockstep with the reference engine and stops
+ * at the first basic block after which they differ.
+ *
+ * Both engines get the same input, which is read as the reference needs
+ * it, so interactive programs work.  After every block, the program counters,
+ * the numbers of instructions performed, the errors, the depths and topmost
+ * values of the stacks, the heap cells written to during the block and the
+ * output are compared.  Values deeper in the stack are compared once the
+ * program ends, or when they reach the top.  Since the heaps agreed before
+ * every block, they agree at the end as well.
+ */
+class Lockstep {
+
+public:
+
+  /**
+   * The number of topmost stack values compared after every block.
+   */
+  static std::size_t const stack_window = 16;
+
+
+private:
+
+  std::shared_ptr<Program const> program_;
+
+
+  /**
+   * The number of instructions from each instruction to the end of its
+   * basic block, inclusively.
+   */
+  std::vector<unsigned int> block_lengths_;
+
+
+  /**
+   * The source of the input.
+   */
+  InputSource& in_;
+
+
+  /**
+   * The destination of the output that was verified.
+   */
+  OutputSink& out_;
+
+
+  /**
+   * The input read so far, which both engines read from.
+   */
+  std::string input_;
+
+
+  /**
+   * The number of bytes of input the reference has read.
+   */
+  std::size_t reference_read_;
+
+
+  /**
+   * The number of bytes of input the candidate has read.
+   */
+  std::size_t candidate_read_;
+
+
+  CallbackInputSource reference_in_;
+
+
+  CallbackInputSource candidate_in_;
+
+
+  StringOutputSink reference_out_;
+
+
+  StringOutputSink candidate_out_;
+
+
+  std::unique_ptr<Engine> reference_;
+
+
+  std::unique_ptr<Engine> candidate_;
+
+
+  /**
+   * The addresses of the heap cells the reference wrote to during the
+   * current block.
+   */
+  std::vector<int> reference_written_;
+
+
+  /**
+   * The addresses of the heap cells the candidate wrote to during the
+   * current block.
+   */
+  std::vector<int> candidate_written_;
+
+
+  /**
+   * The addresses of the heap cells either engine wrote to, sorted.
+   */
+  std::vector<int> written_;
+
+
+  /**
+   * The number of bytes of output that were compared already.
+   */
+  std::size_t output_checked_;
+
+
+  /**
+   * The number of bytes of output of the reference written to out_.
+   */
+  std::size_t output_written_;
+
+
+  /**
+   * Provide input to an engine, reading more from in_ if it has read all
+   * input read so far.
+   *
+   * @param read The number of bytes of input the engine has read.
+   * @param buffer The buffer to fill.
+   * @param size The size of the buffer.
+   * @returns The number of bytes provided, or 0 at the end of the input.
+   */
+  std::size_t provide_input(std::size_t& read, char* buffer, std::size_t const size);
+
+
+  /**
+   * Write the output of the reference to out_.
+   *
+   * @param count The number of bytes of output to write at most.
+   */
+  void write_output(std::size_t const count);
+
+
+  /**
+   * Compare the engines after a block and report the differences.
+   *
+   * @param block The index of the first instruction of the block.
+   * @param steps The number of instructions performed before the block.
+   * @param reference_error The error of the reference, or "".
+   * @param candidate_error The error of the candidate, or "".
+   * @param stack_count The number of topmost stack values to compare.
+   * @param report The output stream to report differences to.
+   * @returns true iff the engines agree.
+   */
+  bool compare(unsigned int const block, unsigned long long const steps,
+               std::string const& reference_error, std::string const& candidate_error,
+               std::size_t const stack_count, std::ostream& report);
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param program The program.
+   * @param candidate The name of the engine to verify, see make_engine().
+   * @param in The source of the input, which must outlive the object.
+   * @param out The destination of the output, which receives the output of
+   *            the reference once it was verified, or when the reference
+   *            waits for input.  It must outlive the object.
+   * @throws std::runtime_error if there is no engine of that name.
+   */
+  Lockstep(std::shared_ptr<Program const> const& program, std::string const& candidate,
+           InputSource& in, OutputSink& out);
+
+
+  /**
+   * Run the program until it ends, fails, or the engines differ.
+   *
+   * @param max_steps The maximal number of instructions to perform.
+   * @param report The output stream a difference is reported to.
+   * @returns false iff the engines differ.
+   * @throws std::runtime_error if the program fails in both engines alike,
+   *         or exceeds max_steps.
+   */
+  bool run(unsigned long long const max_steps, std::ostream& report);
+
+};
+
+} // namespace whitepp
+
+
+#endif // LOCKSTEP_H_
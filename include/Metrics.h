@@ -0,0 +1,141 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "VirtualMachine.h"
+
+
+namespace whitepp {
+
+/**
+ * This class collects the resource usage of one run for export as JSON.
+ *
+ * Everything but the phase times is read from counters the virtual machine
+ * and its input and output maintain anyway, so collecting metrics costs
+ * nothing while the program runs.
+ */
+class Metrics {
+
+public:
+
+  /**
+   * The version of the JSON format.  Fields are only ever added; any other
+   * change increments it.
+   */
+  static unsigned int const version = 1;
+
+
+private:
+
+  /**
+   * The duration of each phase in nanoseconds, in order.
+   */
+  std::vector<std::pair<std::string, unsigned long long>> phases_;
+
+
+  /**
+   * The error that ended the run, or "".
+   */
+  std::string error_;
+
+
+  std::size_t tokens_;
+
+
+  std::size_t instructions_;
+
+
+  std::size_t labels_;
+
+
+  unsigned long long steps_;
+
+
+  std::size_t peak_stack_;
+
+
+  std::size_t peak_calls_;
+
+
+  std::size_t heap_entries_;
+
+
+  std::size_t heap_bytes_;
+
+
+  unsigned long long bytes_read_;
+
+
+  unsigned long long bytes_written_;
+
+
+public:
+
+  /**
+   * The standard constructor.
+   */
+  Metrics() :
+      tokens_(0), instructions_(0), labels_(0), steps_(0), peak_stack_(0), peak_calls_(0),
+      heap_entries_(0), heap_bytes_(0), bytes_read_(0), bytes_written_(0) {}
+
+
+  /**
+   * @param name The name of a phase.
+   * @param duration How long it took.
+   */
+  void add_phase(std::string const& name, std::chrono::nanoseconds const duration) {
+    phases_.emplace_back(name, duration.count());
+  }
+
+
+  /**
+   * @param tokens The number of tokens of the program.
+   */
+  void set_tokens(std::size_t const tokens) {
+    tokens_ = tokens;
+  }
+
+
+  /**
+   * @param error The error that ended the run.
+   */
+  void set_error(std::string const& error) {
+    error_ = error;
+  }
+
+
+  /**
+   * Read the statistics of a virtual machine, its program and its input and
+   * output.
+   *
+   * @param vm The virtual machine.
+   */
+  void collect(VirtualMachine const& vm);
+
+
+  /**
+   * Write the metrics as a JSON object.
+   *
+   * @param out The output stream.
+   */
+  void write_json(std::ostream& out) const;
+
+};
+
+} // namespace whitepp
+
+
+#endif // METRICS_H_
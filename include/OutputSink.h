@@ -0,0 +1,396 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef OUTPUTSINK_H_
+#define OUTPUTSINK_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+
+namespace whitepp {
+
+/**
+ * This class implements a buffered output sink for the virtual machine.
+ *
+ * The output is collected in a user-space buffer and handed to write() in
+ * large blocks: when the buffer is full, on every newline in line-buffered
+ * mode, and when flush() is called explicitly.
+ */
+class OutputSink {
+
+public:
+
+  /**
+   * The buffering modes.
+   */
+  enum class Mode {
+    Line,
+    Full
+  };
+
+
+  /**
+   * The default size of the buffer.
+   */
+  static std::size_t const default_capacity = 1 << 16;
+
+
+private:
+
+  /**
+   * The buffer.
+   */
+  std::unique_ptr<char[]> buffer_;
+
+
+  /**
+   * The size of the buffer.
+   */
+  std::size_t capacity_;
+
+
+  /**
+   * The number of bytes in the buffer.
+   */
+  std::size_t used_;
+
+
+  /**
+   * The number of bytes flushed so far.
+   */
+  unsigned long long flushed_;
+
+
+  /**
+   * The buffering mode.
+   */
+  Mode mode_;
+
+
+  /**
+   * True iff the output is not consumed fast enough.
+   */
+  bool backlog_;
+
+
+protected:
+
+  /**
+   * Write a block of output to its final destination.
+   *
+   * @param data The bytes.
+   * @param size The number of bytes.
+   * @throws std::runtime_error if the output cannot be written.
+   */
+  virtual void write(char const* data, std::size_t size) = 0;
+
+
+  /**
+   * @param backlog true iff the virtual machine should pause until the output
+   *                is consumed.
+   */
+  void set_backlog(bool const backlog) {
+    backlog_ = backlog;
+  }
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param mode The buffering mode.
+   * @param capacity The size of the buffer.
+   */
+  OutputSink(Mode const mode = Mode::Full,
+             std::size_t const capacity = default_capacity);
+
+
+  /**
+   * The destructor.  Derived classes must flush the buffer themselves.
+   */
+  virtual ~OutputSink() {}
+
+
+  /**
+   * @param c A character to output.
+   */
+  void put_char(char const c) {
+
+    buffer_[used_++] = c;
+
+    if (used_ == capacity_ || (c == '\n' && mode_ == Mode::Line)) {
+      flush();
+    }
+  }
+
+
+  /**
+   * @param i An integer to output in decimal.
+   */
+  void put_int(int const i);
+
+
+  /**
+   * @param str A string to output.
+   */
+  void put_str(std::string const& str);
+
+
+  /**
+   * Write the buffered output.
+   */
+  void flush();
+
+
+  /**
+   * @returns The buffering mode.
+   */
+  Mode get_mode() const {
+    return mode_;
+  }
+
+
+  /**
+   * @param mode The buffering mode.
+   */
+  void set_mode(Mode const mode) {
+    mode_ = mode;
+  }
+
+
+  /**
+   * @returns true iff the virtual machine should pause until the output is
+   *          consumed.
+   */
+  bool has_backlog() const {
+    return backlog_;
+  }
+
+
+  /**
+   * @returns The number of bytes output, including those still buffered.
+   */
+  unsigned long long get_bytes_written() const {
+    return flushed_ + used_;
+  }
+
+};
+
+
+/**
+ * This class implements an output sink that writes to a file descriptor.
+ */
+class FdOutputSink : public OutputSink {
+
+private:
+
+  /**
+   * The file descriptor.
+   */
+  int fd_;
+
+
+protected:
+
+  virtual void write(char const* data, std::size_t size) override;
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param fd The file descriptor, which is not closed by the sink.
+   * @param mode The buffering mode.
+   */
+  FdOutputSink(int const fd, Mode const mode = Mode::Full) :
+      OutputSink(mode), fd_(fd) {}
+
+
+  /**
+   * The destructor, which flushes the buffer.
+   */
+  virtual ~FdOutputSink();
+
+};
+
+
+/**
+ * This class implements an output sink that collects the output in a string.
+ */
+class StringOutputSink : public OutputSink {
+
+private:
+
+  /**
+   * The output written so far.
+   */
+  std::string str_;
+
+
+protected:
+
+  virtual void write(char const* data, std::size_t size) override {
+    str_.append(data, size);
+  }
+
+
+public:
+
+  /**
+   * The standard constructor.
+   */
+  StringOutputSink() {}
+
+
+  /**
+   * The destructor.
+   */
+  virtual ~StringOutputSink() {}
+
+
+  /**
+   * @returns The output, including the buffered part.
+   */
+  std::string const& get_str() {
+
+    flush();
+    return str_;
+  }
+
+};
+
+
+/**
+ * This class implements an output sink that hands blocks of output to a
+ * callback, e.g. to write to a stream of an embedding application.
+ */
+class CallbackOutputSink : public OutputSink {
+
+public:
+
+  /**
+   * Consumes a block of output.  May throw std::runtime_error.
+   */
+  typedef std::function<void(char const* data, std::size_t size)> write_t;
+
+
+private:
+
+  write_t write_;
+
+
+protected:
+
+  virtual void write(char const* data, std::size_t size) override {
+    write_(data, size);
+  }
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param write The callback.
+   * @param mode The buffering mode.
+   */
+  CallbackOutputSink(write_t const& write, Mode const mode = Mode::Full) :
+      OutputSink(mode), write_(write) {}
+
+
+  /**
+   * The destructor.  The buffer must be flushed before.
+   */
+  virtual ~CallbackOutputSink() {}
+
+};
+
+
+/**
+ * This class implements an output sink the caller pulls output from while
+ * the program runs.
+ *
+ * Once more than a limit of output is waiting, the sink reports a backlog,
+ * upon which the virtual machine suspends until the output is taken.
+ */
+class PullOutputSink : public OutputSink {
+
+private:
+
+  /**
+   * The output not taken yet.
+   */
+  std::string pending_;
+
+
+  /**
+   * The amount of output that causes a backlog.
+   */
+  std::size_t limit_;
+
+
+protected:
+
+  virtual void write(char const* data, std::size_t size) override {
+
+    pending_.append(data, size);
+
+    if (pending_.size() >= limit_) {
+      set_backlog(true);
+    }
+  }
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param limit The amount of output that causes a backlog.
+   */
+  PullOutputSink(std::size_t const limit = default_capacity) :
+      OutputSink(Mode::Full, default_capacity), limit_(limit) {}
+
+
+  /**
+   * The destructor.
+   */
+  virtual ~PullOutputSink() {}
+
+
+  /**
+   * @returns The output not taken yet, including the buffered part.
+   */
+  std::string take() {
+
+    flush();
+
+    std::string output;
+    output.swap(pending_);
+
+    set_backlog(false);
+
+    return output;
+  }
+
+};
+
+
+/**
+ * @returns The output sink for the standard output.
+ */
+OutputSink& standard_output();
+
+} // namespace whitepp
+
+
+#endif // OUTPUTSINK_H_
@@ -421,6 +421,14 @@ public:
   virtual ~SetLbl() {}
 
 
+  /**
+   * @returns The label.
+   */
+  std::string const& get_label() const {
+    return label_;
+  }
+
+
   virtual void accept(InstructionVisitor& visitor) override;
 
 
@@ -0,0 +1,135 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef PERFCOUNTERS_H_
+#define PERFCOUNTERS_H_
+
+#include <array>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace whitepp {
+
+/**
+ * This class counts hardware events of the calling thread in user space,
+ * using perf_event_open(2).
+ *
+ * Counters that cannot be opened, for instance in containers or on
+ * virtual machines without a PMU, are unavailable; their values are -1.
+ */
+class PerfCounters {
+
+public:
+
+  /**
+   * The events counted.
+   */
+  enum Counter {
+    Cycles, Instructions, BranchMisses, L1dMisses, L1iMisses, LlcMisses
+  };
+
+
+  static std::size_t const count = 6;
+
+
+  /**
+   * The value of each counter, or -1 if it is unavailable.
+   */
+  typedef std::array<long long, count> values_t;
+
+
+  /**
+   * The values of each counter during named phases.
+   */
+  typedef std::vector<std::pair<std::string, values_t>> phases_t;
+
+
+private:
+
+  /**
+   * The file descriptor of each counter, or -1.
+   */
+  std::array<int, count> fds_;
+
+
+  /**
+   * The reason the first unavailable counter could not be opened.
+   */
+  std::string error_;
+
+
+public:
+
+  /**
+   * The standard constructor, which starts counting.
+   */
+  PerfCounters();
+
+
+  PerfCounters(PerfCounters const&) = delete;
+
+
+  PerfCounters& operator=(PerfCounters const&) = delete;
+
+
+  ~PerfCounters();
+
+
+  /**
+   * @param counter A counter.
+   * @returns The name of the counter, such as "branch-misses".
+   */
+  static char const* name(std::size_t const counter);
+
+
+  /**
+   * @returns true iff at least one counter is available.
+   */
+  bool is_available() const;
+
+
+  /**
+   * @returns Why a counter is unavailable, or "".
+   */
+  std::string const& get_error() const {
+    return error_;
+  }
+
+
+  /**
+   * @returns The events counted since the construction, scaled up if the
+   *          kernel multiplexed the counter.
+   */
+  values_t read() const;
+
+
+  /**
+   * @param before The values at the start of a phase.
+   * @param after The values at its end.
+   * @returns The events counted during the phase.
+   */
+  static values_t difference(values_t const& before, values_t const& after);
+
+
+  /**
+   * Print a table of the events counted during each phase.
+   *
+   * @param out The output stream.
+   * @param phases The phases.
+   */
+  void print(std::ostream& out, phases_t const& phases) const;
+
+};
+
+} // namespace whitepp
+
+
+#endif // PERFCOUNTERS_H_
@@ -0,0 +1,129 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "Program.h"
+#include "VirtualMachine.h"
+
+
+namespace whitepp {
+
+/**
+ * This class counts how often each instruction of a program is performed,
+ * and how often jumps leave the straight path.
+ *
+ * It observes VirtualMachine::run(), so the virtual machine is only slowed
+ * down when a profile is taken.
+ */
+class Profiler {
+
+private:
+
+  std::shared_ptr<Program const> program_;
+
+
+  /**
+   * The virtual machine observed.
+   */
+  VirtualMachine const& vm_;
+
+
+  /**
+   * How often each instruction was performed.
+   */
+  std::vector<unsigned long long> counts_;
+
+
+  /**
+   * How often each jump, call and conditional jump continued at its target,
+   * and each return elsewhere than at the next instruction.
+   */
+  std::vector<unsigned long long> taken_;
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param vm The virtual machine whose program to profile.
+   */
+  Profiler(VirtualMachine const& vm) :
+      program_(vm.get_program()), vm_(vm), counts_(program_->size()),
+      taken_(program_->size()) {}
+
+
+  /**
+   * Count an instruction performed.
+   *
+   * @param index The index of the instruction.
+   * @param next The index of the instruction performed next.
+   */
+  void step(unsigned int const index, unsigned int const next) {
+
+    ++counts_[index];
+
+    // A branch to the next instruction continues there either way, so only
+    // the virtual machine knows whether it was taken.
+    if (next != index + 1 ||
+        (program_->get_target(index) == static_cast<int>(next) && vm_.is_branch_taken())) {
+      ++taken_[index];
+    }
+  }
+
+
+  /**
+   * @returns How often each instruction was performed.
+   */
+  std::vector<unsigned long long> const& get_counts() const {
+    return counts_;
+  }
+
+
+  /**
+   * Print the number of instructions performed per opcode and a listing of
+   * the blocks that were performed, hottest first.  A block starts at a
+   * label; conditional jumps are annotated with how often they were taken.
+   *
+   * @param out The output stream.
+   */
+  void print(std::ostream& out) const;
+
+
+  /**
+   * Write the counts as text: a header line, the program's fingerprint, and
+   * one line "INDEX COUNT" per instruction performed.
+   *
+   * @param out The output stream.
+   */
+  void write(std::ostream& out) const;
+
+
+  /**
+   * Read counts written by write().
+   *
+   * @param in The input stream.
+   * @param program The program the counts must belong to.
+   * @returns How often each instruction of the program was performed.
+   * @throws std::runtime_error if the counts cannot be read or belong to
+   *         another program.
+   */
+  static std::vector<unsigned long long> read(std::istream& in, Program const& program);
+
+};
+
+} // namespace whitepp
+
+
+#endif // PROFILER_H_
@@ -0,0 +1,166 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef PROGRAM_H_
+#define PROGRAM_H_
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Parser.h"
+
+
+namespace whitepp {
+
+/**
+ * This class represents a parsed program whose jump targets are resolved.
+ *
+ * A program is immutable once constructed, so it can be shared by many
+ * virtual machines.
+ */
+class Program {
+
+private:
+
+  /**
+   * The instructions of the program.
+   */
+  instructions_t instructions_;
+
+
+  /**
+   * A map where to find labels in the instructions vector.
+   */
+  std::map<std::string, int> labels_;
+
+
+  /**
+   * The jump target of every instruction, or -1 if the instruction does not
+   * jump or its label is undefined.
+   */
+  std::vector<int> targets_;
+
+
+  /**
+   * The instructions as plain pointers, so executing them never touches the
+   * reference counts shared by all threads.
+   */
+  std::vector<Instruction*> code_;
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param instructions The instructions parsed.
+   * @param labels The labels parsed.
+   */
+  Program(instructions_t const& instructions,
+          std::map<std::string, int> const& labels);
+
+
+  /**
+   * The destructor.
+   */
+  ~Program() {}
+
+
+  /**
+   * @returns The instructions of the program.
+   */
+  instructions_t const& get_instructions() const {
+    return instructions_;
+  }
+
+
+  /**
+   * @returns The instructions as plain pointers, valid as long as the
+   *          program.
+   */
+  Instruction* const* get_code() const {
+    return code_.data();
+  }
+
+
+  /**
+   * @returns The labels of the program.
+   */
+  std::map<std::string, int> const& get_labels() const {
+    return labels_;
+  }
+
+
+  /**
+   * @param index The index of an instruction.
+   * @returns The index the instruction jumps to, or -1 if there is none.
+   */
+  int get_target(unsigned int const index) const {
+    return targets_[index];
+  }
+
+
+  /**
+   * @returns The number of instructions.
+   */
+  std::size_t size() const {
+    return instructions_.size();
+  }
+
+};
+
+
+/**
+ * Compute a fingerprint of a program, which is used to detect snapshots and
+ * recordings that were taken with another program.
+ *
+ * @param program The program.
+ * @returns The FNV-1a hash of the textual representation of the program.
+ */
+std::uint64_t fingerprint(Program const& program);
+
+
+/**
+ * Write a program as Whitespace in its most compact form: without comments,
+ * with every number in its shortest encoding, and with the labels renamed so
+ * the ones used most often get the shortest names.  Parsing the result gives
+ * a program that behaves the same.
+ *
+ * @param program The program.
+ * @param out The output stream.
+ */
+void minify(Program const& program, std::ostream& out);
+
+
+/**
+ * Tokenise and parse a program.
+ *
+ * @param in The source code.
+ * @returns The program.
+ * @throws std::runtime_error if the program cannot be parsed.
+ */
+std::shared_ptr<Program const> parse_program(std::istream& in);
+
+
+/**
+ * Read, tokenise and parse a program.
+ *
+ * @param file The name of the file.
+ * @returns The program.
+ * @throws std::runtime_error if the file cannot be read or parsed.
+ */
+std::shared_ptr<Program const> load_program(std::string const& file);
+
+} // namespace whitepp
+
+
+#endif // PROGRAM_H_
@@ -0,0 +1,110 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef PROGRAMCACHE_H_
+#define PROGRAMCACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "Program.h"
+
+
+namespace whitepp {
+
+/**
+ * This class keeps the most recently used parsed programs, keyed by a hash
+ * of their source code.  It can be used by many threads.
+ */
+class ProgramCache {
+
+private:
+
+  /**
+   * A cached program with its source code, to rule out hash collisions.
+   */
+  struct Entry {
+
+    std::uint64_t hash;
+
+
+    std::string source;
+
+
+    std::shared_ptr<Program const> program;
+
+  };
+
+
+  typedef std::list<Entry> entries_t;
+
+
+  /**
+   * The maximal number of programs.
+   */
+  std::size_t capacity_;
+
+
+  std::mutex mutex_;
+
+
+  /**
+   * The programs, most recently used first.
+   */
+  entries_t entries_;
+
+
+  /**
+   * The entries by hash.
+   */
+  std::unordered_multimap<std::uint64_t, entries_t::iterator> index_;
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param capacity The maximal number of programs.
+   */
+  ProgramCache(std::size_t const capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+
+
+  /**
+   * The destructor.
+   */
+  ~ProgramCache() {}
+
+
+  /**
+   * Look up a program, parsing it if it is not cached.  Parsing happens
+   * outside the lock, so a slow program does not hold up other threads.
+   *
+   * @param source The source code.
+   * @returns The program, and true iff it was cached.
+   * @throws std::runtime_error if the program cannot be parsed.
+   */
+  std::pair<std::shared_ptr<Program const>, bool> get(std::string const& source);
+
+
+  /**
+   * @returns The number of cached programs.
+   */
+  std::size_t size();
+
+};
+
+} // namespace whitepp
+
+
+#endif // PROGRAMCACHE_H_
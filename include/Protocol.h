@@ -0,0 +1,149 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+#include <cstdint>
+#include <string>
+
+
+namespace whitepp {
+
+/**
+ * The protocol between the daemon and its clients.
+ *
+ * A connection carries any number of requests, each answered by a response
+ * before the next request is read.  Integers are sent in network byte order,
+ * strings as a 32-bit length followed by the bytes:
+ *
+ *   request:  program, input, u64 max_steps, u32 timeout_ms
+ *   response: u8 status, u8 cached, u64 steps, u64 time_us, output, error
+ *
+ * A limit of 0 means no limit.
+ */
+namespace protocol {
+
+/**
+ * The maximal length of a string, to reject garbage early.  It also caps
+ * the output of a program run by the server.
+ */
+std::uint32_t const max_length = 1u << 26;
+
+
+/**
+ * The ways an execution can end.
+ */
+enum class Status : std::uint8_t {
+  Finished = 0,
+  Failed = 1,
+  StepLimit = 2,
+  Deadline = 3
+};
+
+
+struct Request {
+
+  /**
+   * The source code of the program.
+   */
+  std::string program;
+
+
+  std::string input;
+
+
+  std::uint64_t max_steps = 0;
+
+
+  std::uint32_t timeout_ms = 0;
+
+};
+
+
+struct Response {
+
+  Status status = Status::Failed;
+
+
+  /**
+   * True iff the program was parsed before.
+   */
+  bool cached = false;
+
+
+  /**
+   * The number of instructions performed.
+   */
+  std::uint64_t steps = 0;
+
+
+  /**
+   * The wall-clock time of the execution in microseconds.
+   */
+  std::uint64_t time_us = 0;
+
+
+  std::string output;
+
+
+  /**
+   * The error message if the program failed.
+   */
+  std::string error;
+
+};
+
+
+/**
+ * @param fd A connected socket.
+ * @param request The request to send.
+ * @throws std::runtime_error if the connection fails.
+ */
+void write_request(int const fd, Request const& request);
+
+
+/**
+ * @param fd A connected socket.
+ * @param request Receives the request.
+ * @returns false if the peer closed the connection before a request.
+ * @throws std::runtime_error if the connection fails or the request is
+ *         malformed.
+ */
+bool read_request(int const fd, Request& request);
+
+
+/**
+ * @param fd A connected socket.
+ * @param response The response to send.
+ * @throws std::runtime_error if the connection fails.
+ */
+void write_response(int const fd, Response const& response);
+
+
+/**
+ * @param fd A connected socket.
+ * @param response Receives the response.
+ * @throws std::runtime_error if the connection fails or the response is
+ *         malformed.
+ */
+void read_response(int const fd, Response& response);
+
+
+/**
+ * @param path The path of the socket.
+ * @returns A socket connected to path.
+ * @throws std::runtime_error if the connection fails.
+ */
+int connect_to(std::string const& path);
+
+} // namespace protocol
+
+} // namespace whitepp
+
+
+#endif // PROTOCOL_H_
@@ -0,0 +1,137 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef RECORDRUNNER_H_
+#define RECORDRUNNER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "InputSource.h"
+#include "OutputSink.h"
+#include "Program.h"
+#include "WorkStealingPool.h"
+
+
+namespace whitepp {
+
+/**
+ * This class runs a program once per record of its input, in parallel.
+ *
+ * Every record, including its delimiter, is the complete input of an
+ * independent virtual machine.  The outputs are written in the order of the
+ * records.  At most a window of records is in flight, so a slow record
+ * holds back only a bounded amount of finished output.
+ */
+class RecordRunner {
+
+private:
+
+  /**
+   * A record in flight.
+   */
+  struct Slot {
+
+    std::string input;
+
+
+    std::string output;
+
+
+    /**
+     * The error message if the program failed on the record.
+     */
+    std::string error;
+
+
+    bool done = false;
+
+  };
+
+
+  std::shared_ptr<Program const> program_;
+
+
+  WorkStealingPool& pool_;
+
+
+  /**
+   * The ring of records in flight.
+   */
+  std::vector<Slot> slots_;
+
+
+  unsigned long long max_steps_;
+
+
+  /**
+   * Guards done in the slots.
+   */
+  std::mutex mutex_;
+
+
+  /**
+   * Signalled when a record is done.
+   */
+  std::condition_variable done_cv_;
+
+
+  /**
+   * Run the program on the record in a slot.
+   *
+   * @param slot The slot.
+   */
+  void run_record(Slot& slot);
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param program The program.
+   * @param pool The threads to run the program on.
+   * @param window The maximal number of records in flight.
+   * @param max_steps The maximal number of instructions per record.
+   */
+  RecordRunner(std::shared_ptr<Program const> const& program,
+               WorkStealingPool& pool, std::size_t const window,
+               unsigned long long const max_steps =
+               std::numeric_limits<unsigned long long>::max());
+
+
+  /**
+   * The destructor.
+   */
+  ~RecordRunner() {}
+
+
+  /**
+   * Run the program on all records of an input.  A failing record produces
+   * no output; its error is reported and the other records go on.
+   *
+   * @param in The input.
+   * @param delimiter The character that ends a record.
+   * @param out The output.
+   * @param errors The stream to report failed records to.
+   * @returns The number of failed records.
+   */
+  std::size_t run(InputSource& in, char const delimiter, OutputSink& out,
+                  std::ostream& errors);
+
+};
+
+} // namespace whitepp
+
+
+#endif // RECORDRUNNER_H_
@@ -0,0 +1,240 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef RECORDING_H_
+#define RECORDING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "InputSource.h"
+#include "OutputSink.h"
+#include "VirtualMachine.h"
+
+
+namespace whitepp {
+
+/**
+ * This struct holds the input and output of a run of a program, so the run
+ * can be repeated without its original input.
+ *
+ * It is stored as text: a header line, the program's fingerprint, one line
+ * "char STEPS VALUE" or "int STEPS VALUE" per input instruction performed,
+ * the number of instructions, the error if any, and finally the input
+ * consumed and the output, each as "input SIZE" or "output SIZE" followed by
+ * a newline and SIZE raw bytes.
+ */
+struct Recording {
+
+  /**
+   * An input instruction performed.
+   */
+  struct Read {
+
+    /**
+     * The number of instructions performed before.
+     */
+    unsigned long long steps;
+
+
+    bool is_int;
+
+
+    /**
+     * The value stored, InputSource::eof at the end of the input.
+     */
+    int value;
+
+  };
+
+
+  std::uint64_t program = 0;
+
+
+  std::vector<Read> reads;
+
+
+  /**
+   * The number of instructions performed.
+   */
+  unsigned long long steps = 0;
+
+
+  /**
+   * The error the program failed with, or "".
+   */
+  std::string error;
+
+
+  /**
+   * The input consumed.
+   */
+  std::string input;
+
+
+  std::string output;
+
+
+  /**
+   * @param out The output stream to write the recording to.
+   */
+  void write(std::ostream& out) const;
+
+
+  /**
+   * @param in The input stream to read the recording from.
+   * @throws std::runtime_error if the recording cannot be read.
+   */
+  void read(std::istream& in);
+
+};
+
+
+/**
+ * This class records the input instructions and the output of a program
+ * run by a virtual machine, or checks them against a recording.
+ *
+ * It is passed to VirtualMachine::run() as the observer, and takes over the
+ * input and output of the virtual machine: when recording, it keeps a copy
+ * of the input read from the original source; when replaying, the input is
+ * the one recorded.  Either way, the output is copied to the original
+ * destination.
+ */
+class Recorder {
+
+public:
+
+  enum class Mode {
+    Record,
+    Replay
+  };
+
+
+private:
+
+  VirtualMachine& vm_;
+
+
+  Recording& recording_;
+
+
+  Mode mode_;
+
+
+  /**
+   * For every instruction, 1 if it reads a character, 2 if it reads an
+   * integer, and 0 otherwise.
+   */
+  std::vector<unsigned char> reads_;
+
+
+  /**
+   * The number of instructions performed.
+   */
+  unsigned long long steps_;
+
+
+  /**
+   * The number of reads performed.
+   */
+  std::size_t read_count_;
+
+
+  /**
+   * The heap cell the next instruction reads into, if pending_.
+   */
+  int address_;
+
+
+  bool pending_;
+
+
+  /**
+   * True iff a difference to the recording was thrown already.
+   */
+  bool failed_;
+
+
+  /**
+   * The source the recorded input is read from.
+   */
+  InputSource* original_in_;
+
+
+  std::unique_ptr<InputSource> in_;
+
+
+  /**
+   * The output so far.
+   */
+  std::string output_;
+
+
+  CallbackOutputSink out_;
+
+
+  /**
+   * Note where the next instruction reads into, if it reads.
+   */
+  void prepare(unsigned int const next);
+
+
+  /**
+   * Record or check a read that was just performed, and prepare the next one.
+   */
+  void track(unsigned int const index, unsigned int const next);
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param vm The virtual machine, whose input and output are replaced.
+   * @param recording The recording to fill, or to check against.
+   * @param mode Whether to record or to replay.
+   * @param in The source of the input, which is only used when recording.
+   * @param out The destination of the output.
+   * @throws std::runtime_error if the recording belongs to another program.
+   */
+  Recorder(VirtualMachine& vm, Recording& recording, Mode const mode, InputSource& in,
+           OutputSink& out);
+
+
+  /**
+   * Record or check an instruction performed.
+   */
+  void step(unsigned int const index, unsigned int const next) {
+
+    if (pending_ || reads_[next] != 0) {
+      track(index, next);
+    }
+
+    ++steps_;
+  }
+
+
+  /**
+   * Complete the recording, or check the end of the run against it.
+   *
+   * @param error The error the program failed with, or "".
+   * @returns The first difference to the recording, or "" if there is none
+   *          or the mode is Record.
+   */
+  std::string finish(std::string const& error);
+
+};
+
+} // namespace whitepp
+
+
+#endif // RECORDING_H_
@@ -0,0 +1,343 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef REGISTERENGINE_H_
+#define REGISTERENGINE_H_
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CowHeap.h"
+#include "Engine.h"
+#include "InputSource.h"
+#include "OutputSink.h"
+#include "Program.h"
+
+
+namespace whitepp {
+
+/**
+ * This class is an engine that translates the straight-line code of every
+ * basic block into three-address code over a register file, and interprets
+ * that.
+ *
+ * The translation simulates the stack: Push, Dupl, Swap, Discard and labels
+ * only rename registers and produce no operation, constants live in
+ * registers that are written once, and operations on constants are folded.
+ * A unit of translated code loads the values it consumes from the stack into
+ * registers when it starts, and writes back the values that changed when it
+ * ends, together with the jump, call or return that ends its block.
+ *
+ * A unit is only run if the stack holds the values it consumes and the
+ * instructions it performs fit the number asked for.  Otherwise, and for
+ * jumps to undefined labels, the instructions are performed one by one
+ * exactly like VirtualMachine does.  If an operation of a unit fails, the
+ * stack is restored to what it was when the original instruction failed.
+ */
+class RegisterEngine : public Engine {
+
+private:
+
+  /**
+   * The kinds of instructions and operations.
+   */
+  enum class Kind : unsigned char {
+    Push, Dupl, Swap, Discard, Add, Sub, Mul, Div, Mod, Store, Retrieve,
+    Label, Call, Jump, JumpZero, JumpNeg, Ret, End, PrintChar, PrintInt, ReadChar, ReadInt
+  };
+
+
+  /**
+   * An instruction of the program, for performing it on its own.
+   */
+  struct Instr {
+
+    Kind kind;
+
+
+    int num;
+
+
+    int target;
+
+  };
+
+
+  /**
+   * An operation of the translated code: register d = a op b.  Store writes
+   * b to the cell a; the output and input operations use a.
+   */
+  struct Op {
+
+    Kind kind;
+
+
+    unsigned int d;
+
+
+    unsigned int a;
+
+
+    unsigned int b;
+
+
+    /**
+     * The index of the failure of this operation, for those that can fail.
+     */
+    unsigned int failure;
+
+  };
+
+
+  /**
+   * What the stack holds when an operation fails: the values of the unit not
+   * consumed yet, and then the registers listed.
+   */
+  struct Failure {
+
+    /**
+     * The index of the original instruction.
+     */
+    unsigned int index;
+
+
+    /**
+     * The number of values of the unit consumed before.
+     */
+    unsigned int consumed;
+
+
+    std::size_t begin;
+
+
+    std::size_t size;
+
+  };
+
+
+  /**
+   * The translation of a run of instructions within a basic block.
+   */
+  struct Unit {
+
+    /**
+     * The index of the first instruction.
+     */
+    unsigned int begin;
+
+
+    /**
+     * The index after the last instruction.
+     */
+    unsigned int end;
+
+
+    std::size_t ops_begin;
+
+
+    std::size_t ops_end;
+
+
+    /**
+     * The number of values it consumes from the stack, which are loaded into
+     * the registers from 0 on.
+     */
+    unsigned int inputs;
+
+
+    /**
+     * The number of these values that are left as they were.
+     */
+    unsigned int keep;
+
+
+    /**
+     * The registers written back above them.
+     */
+    std::size_t spill_begin;
+
+
+    std::size_t spill_size;
+
+
+    /**
+     * The instruction that ends the unit, or Label if it continues with the
+     * next one.
+     */
+    Kind exit;
+
+
+    /**
+     * The register holding the condition of JumpZero and JumpNeg.
+     */
+    unsigned int condition;
+
+
+    int target;
+
+
+    /**
+     * If true, the unit is always performed instruction by instruction.
+     */
+    bool slow;
+
+  };
+
+
+  std::shared_ptr<Program const> program_;
+
+
+  InputSource& in_;
+
+
+  OutputSink& out_;
+
+
+  std::vector<Instr> instrs_;
+
+
+  std::vector<Unit> units_;
+
+
+  /**
+   * The unit starting at every instruction, or -1.
+   */
+  std::vector<int> unit_at_;
+
+
+  std::vector<Op> code_;
+
+
+  std::vector<Failure> failures_;
+
+
+  /**
+   * The registers written back by units and listed by failures.
+   */
+  std::vector<unsigned int> slots_;
+
+
+  std::vector<int> registers_;
+
+
+  std::vector<int> stack_;
+
+
+  std::vector<unsigned int> call_stack_;
+
+
+  CowHeap heap_;
+
+
+  unsigned int program_counter_;
+
+
+  unsigned long long steps_;
+
+
+  /**
+   * Translate the program.
+   */
+  void translate();
+
+
+  /**
+   * Translate a unit.
+   *
+   * @param begin The index of its first instruction.
+   * @param limit The index where its basic block ends.
+   * @param constants The number of every constant used so far.
+   * @param values The constants by number.
+   * @returns The number of registers besides the constants it uses.
+   */
+  unsigned int translate_unit(unsigned int const begin, unsigned int const limit,
+                              std::map<int, unsigned int>& constants, std::vector<int>& values);
+
+
+  /**
+   * Perform a unit.
+   *
+   * @param unit The unit.
+   * @param written Receives the address of every heap cell written to.
+   */
+  void run_unit(Unit const& unit, std::vector<int>& written);
+
+
+  /**
+   * Perform the instruction at the program counter.
+   *
+   * @param written Receives the address of every heap cell written to.
+   */
+  void step(std::vector<int>& written);
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param program The program.
+   * @param in The source of the input, which must outlive the engine.
+   * @param out The destination of the output, which must outlive the engine.
+   */
+  RegisterEngine(std::shared_ptr<Program const> const& program, InputSource& in,
+                 OutputSink& out);
+
+
+  /**
+   * The destructor.
+   */
+  virtual ~RegisterEngine() {}
+
+
+  virtual std::string get_name() const override {
+    return "register";
+  }
+
+
+  virtual void run_for(unsigned long long const max_steps, std::vector<int>& written) override;
+
+
+  virtual unsigned int get_program_counter() const override {
+    return program_counter_;
+  }
+
+
+  virtual unsigned long long get_steps() const override {
+    return steps_;
+  }
+
+
+  virtual std::size_t get_stack_size() const override {
+    return stack_.size();
+  }
+
+
+  virtual std::vector<int> get_stack_top(std::size_t const count) const override;
+
+
+  virtual CowHeap const& get_heap() const override {
+    return heap_;
+  }
+
+
+  /**
+   * @returns The number of operations of the translated code.
+   */
+  std::size_t get_operation_count() const {
+    return code_.size();
+  }
+
+};
+
+} // namespace whitepp
+
+
+#endif // REGISTERENGINE_H_
@@ -0,0 +1,130 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include <csignal>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "VirtualMachine.h"
+
+
+namespace whitepp {
+
+/**
+ * This class samples where a virtual machine spends its time.
+ *
+ * A SIGPROF timer fires at a fixed rate of CPU time, and the signal handler
+ * only sets a flag.  At the next dispatch boundary, step() records the
+ * instruction just performed together with the calls not returned from
+ * yet, each mapped to the label it belongs to, which is the last label
+ * defined in front of it.  The samples are written as folded stacks, as
+ * consumed by flamegraph.pl and similar tools.
+ *
+ * Only one sampler may exist at a time, since the timer is process-wide.
+ */
+class Sampler {
+
+public:
+
+  /**
+   * The maximal number of calls recorded per sample, the innermost ones;
+   * the outer calls are folded into one frame.
+   */
+  static std::size_t const max_depth = 256;
+
+
+private:
+
+  /**
+   * Set by the signal handler.
+   */
+  static volatile std::sig_atomic_t pending_;
+
+
+  VirtualMachine const& vm_;
+
+
+  /**
+   * The index of the label each instruction belongs to, or -1.
+   */
+  std::vector<int> labels_;
+
+
+  /**
+   * The number of samples per stack of label indices, the outermost first.
+   */
+  std::map<std::vector<int>, unsigned long long> stacks_;
+
+
+  struct sigaction old_action_;
+
+
+  static void handle_signal(int);
+
+
+  /**
+   * Record a sample.
+   *
+   * @param index The index of the instruction just performed.
+   */
+  void sample(unsigned int const index);
+
+
+public:
+
+  /**
+   * The standard constructor, which starts the timer.
+   *
+   * @param vm The virtual machine, which the sampler observes.
+   * @param frequency The number of samples per second of CPU time.
+   * @throws std::runtime_error if the timer cannot be started or another
+   *         sampler exists.
+   */
+  Sampler(VirtualMachine const& vm, unsigned int const frequency);
+
+
+  Sampler(Sampler const&) = delete;
+
+
+  Sampler& operator=(Sampler const&) = delete;
+
+
+  /**
+   * The destructor, which stops the timer.
+   */
+  ~Sampler();
+
+
+  /**
+   * Take a sample if the timer fired.  The check is a single flag test.
+   */
+  void step(unsigned int const index, unsigned int const) {
+
+    if (pending_ != 0) {
+      sample(index);
+    }
+  }
+
+
+  /**
+   * Write one line "frame;frame;… count" per stack sampled.
+   *
+   * @param out The output stream.
+   */
+  void write_folded(std::ostream& out) const;
+
+};
+
+} // namespace whitepp
+
+
+#endif // SAMPLER_H_
@@ -0,0 +1,318 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Session.h"
+
+
+namespace whitepp {
+
+/**
+ * This class time-slices many sessions over a pool of worker threads.
+ *
+ * Runnable sessions wait in a single queue.  A worker takes the first one,
+ * lets it perform weight * quantum instructions, and puts it back at the
+ * end, so no session can occupy a worker for longer than one slice.
+ * Sessions that exceed their instruction quota, their output quota or their
+ * wall-clock deadline are stopped.
+ */
+class Scheduler {
+
+public:
+
+  /**
+   * The default number of instructions per slice and weight.
+   */
+  static unsigned long long const default_quantum = 10000;
+
+
+  /**
+   * The limits of a session.
+   */
+  struct Limits {
+
+    /**
+     * The share of the workers relative to other sessions.
+     */
+    unsigned int weight = 1;
+
+
+    /**
+     * The maximal number of instructions.
+     */
+    unsigned long long max_steps = std::numeric_limits<unsigned long long>::max();
+
+
+    /**
+     * The maximal wall-clock time from submission, or zero for no limit.  A
+     * session waiting for input is stopped, too.
+     */
+    std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::zero();
+
+
+    /**
+     * The maximal length of the output.  A session writing more fails, with
+     * the output cut at this length.
+     */
+    std::size_t max_output = std::numeric_limits<std::size_t>::max();
+
+  };
+
+
+  /**
+   * The ways a session can end.
+   */
+  enum class Outcome {
+    Finished,
+    Failed,
+    StepLimit,
+    Deadline
+  };
+
+
+  /**
+   * The result of a session.
+   */
+  struct Result {
+
+    Outcome outcome;
+
+
+    /**
+     * The output of the program.
+     */
+    std::string output;
+
+
+    /**
+     * The error message if the program failed.
+     */
+    std::string error;
+
+
+    /**
+     * The number of instructions performed.
+     */
+    unsigned long long steps;
+
+
+    /**
+     * The wall-clock time from submission to the end.
+     */
+    std::chrono::steady_clock::duration time;
+
+  };
+
+
+  typedef unsigned long long id_t;
+
+
+  typedef std::function<void(id_t, Result const&)> callback_t;
+
+
+private:
+
+  /**
+   * A submitted session.
+   */
+  struct Task {
+
+    id_t id;
+
+
+    std::unique_ptr<Session> session;
+
+
+    Limits limits;
+
+
+    callback_t done;
+
+
+    std::chrono::steady_clock::time_point start;
+
+
+    std::string output;
+
+
+    /**
+     * The status returned by the last slice.
+     */
+    VirtualMachine::Status status;
+
+
+    /**
+     * Input fed while a worker may run the session.
+     */
+    std::string input;
+
+
+    /**
+     * True iff the end of the input was fed.
+     */
+    bool close;
+
+
+    /**
+     * True iff the session waits for input and is not queued.
+     */
+    bool parked;
+
+  };
+
+
+  /**
+   * The number of instructions per slice and weight.
+   */
+  unsigned long long quantum_;
+
+
+  std::mutex mutex_;
+
+
+  /**
+   * Signalled when a task is queued or the workers are stopped.
+   */
+  std::condition_variable work_cv_;
+
+
+  /**
+   * Signalled when the last task ends.
+   */
+  std::condition_variable idle_cv_;
+
+
+  /**
+   * The runnable tasks.
+   */
+  std::deque<Task*> queue_;
+
+
+  /**
+   * All tasks that did not end yet.
+   */
+  std::map<id_t, std::unique_ptr<Task>> tasks_;
+
+
+  typedef std::pair<std::chrono::steady_clock::time_point, id_t> deadline_t;
+
+
+  /**
+   * The deadlines of the tasks with a timeout, the earliest on top.  Those
+   * of tasks that ended are removed only once they expire.
+   */
+  std::priority_queue<deadline_t, std::vector<deadline_t>, std::greater<deadline_t>> deadlines_;
+
+
+  id_t next_id_;
+
+
+  bool stop_;
+
+
+  std::vector<std::thread> workers_;
+
+
+  /**
+   * The main loop of a worker.
+   */
+  void work();
+
+
+  /**
+   * Queue the parked tasks whose deadline expired, so they end by the next
+   * slice.  The mutex must be held.
+   */
+  void expire();
+
+
+  /**
+   * Run one slice of a task.
+   *
+   * @param task The task.
+   * @param result Receives how the task ended.
+   * @returns true iff the task ended.
+   */
+  bool run_slice(Task& task, Result& result);
+
+
+public:
+
+  /**
+   * The standard constructor, which starts the workers.
+   *
+   * @param workers The number of worker threads.
+   * @param quantum The number of instructions per slice and weight.
+   */
+  Scheduler(unsigned int workers = std::thread::hardware_concurrency(),
+            unsigned long long const quantum = default_quantum);
+
+
+  /**
+   * The destructor, which waits for all sessions to end.
+   */
+  ~Scheduler();
+
+
+  Scheduler(Scheduler const&) = delete;
+
+
+  Scheduler& operator=(Scheduler const&) = delete;
+
+
+  /**
+   * Submit a session.
+   *
+   * @param session The session, with the input known so far pushed.
+   * @param limits The limits of the session.
+   * @param done Called by a worker thread once the session has ended.
+   * @returns The id of the session.
+   */
+  id_t submit(std::unique_ptr<Session> session, Limits const& limits,
+              callback_t const& done);
+
+
+  /**
+   * Provide more input to a session.  A session that waits for input is
+   * parked until then, without occupying a worker.
+   *
+   * @param id The id of the session.
+   * @param input The input.
+   * @param close true iff this is the end of the input.
+   * @returns false if the session has ended already.
+   */
+  bool feed(id_t const id, std::string const& input, bool const close);
+
+
+  /**
+   * Wait until all sessions have ended.
+   */
+  void wait();
+
+};
+
+} // namespace whitepp
+
+
+#endif // SCHEDULER_H_
@@ -0,0 +1,179 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "ProgramCache.h"
+#include "Protocol.h"
+#include "Scheduler.h"
+
+
+namespace whitepp {
+
+/**
+ * This class implements a daemon that runs programs for clients connecting
+ * to a Unix domain socket.
+ *
+ * Every connection is served by a thread of its own that reads requests and
+ * writes responses, see Protocol.h.  The programs run on a Scheduler, so
+ * the number of connections does not affect the number of threads
+ * executing programs, and parsed programs are kept in a ProgramCache.  At
+ * most max_connections connections are served at a time; further clients
+ * wait in the backlog of the socket.
+ */
+class Server {
+
+public:
+
+  /**
+   * The default maximal number of connections served at a time.
+   */
+  static std::size_t const default_max_connections = 64;
+
+
+private:
+
+  /**
+   * A connection and the thread serving it.
+   */
+  struct Connection {
+
+    int fd;
+
+
+    std::thread thread;
+
+
+    /**
+     * True iff the thread is done with the connection.
+     */
+    bool done;
+
+  };
+
+  /**
+   * The path of the socket.
+   */
+  std::string path_;
+
+
+  /**
+   * The listening socket.
+   */
+  int fd_;
+
+
+  /**
+   * The maximal number of instructions of any request.
+   */
+  unsigned long long max_steps_;
+
+
+  std::size_t max_connections_;
+
+
+  ProgramCache cache_;
+
+
+  Scheduler scheduler_;
+
+
+  std::mutex mutex_;
+
+
+  /**
+   * Signalled when a connection is done.
+   */
+  std::condition_variable done_cv_;
+
+
+  /**
+   * The connections whose threads were not joined yet.
+   */
+  std::list<Connection> connections_;
+
+
+  /**
+   * Serve the requests of a connection until the client closes it.
+   *
+   * @param connection The connection, which is marked done in the end.
+   */
+  void serve_connection(Connection& connection);
+
+
+  /**
+   * Join the threads of the connections that are done and close them.  The
+   * mutex must be held.
+   */
+  void reap();
+
+
+  /**
+   * Run a request.
+   *
+   * @param request The request.
+   * @returns The response.
+   */
+  protocol::Response execute(protocol::Request const& request);
+
+
+public:
+
+  /**
+   * The standard constructor, which creates the socket.  A stale socket at
+   * the path is removed.
+   *
+   * @param path The path of the socket.
+   * @param workers The number of threads executing programs.
+   * @param cache_size The maximal number of cached programs.
+   * @param max_steps The maximal number of instructions of any request.
+   * @param max_connections The maximal number of connections served at a
+   *        time.
+   * @throws std::runtime_error if the socket cannot be created.
+   */
+  Server(std::string const& path, unsigned int const workers,
+         std::size_t const cache_size, unsigned long long const max_steps =
+         std::numeric_limits<unsigned long long>::max(),
+         std::size_t const max_connections = default_max_connections);
+
+
+  /**
+   * The destructor, which shuts down the open connections, waits for their
+   * threads and removes the socket.
+   */
+  ~Server();
+
+
+  Server(Server const&) = delete;
+
+
+  Server& operator=(Server const&) = delete;
+
+
+  /**
+   * Accept connections until accepting fails.  Errors caused by a lack of
+   * resources, such as running out of file descriptors, are waited out.
+   *
+   * @throws std::runtime_error if accepting fails.
+   */
+  void serve();
+
+};
+
+} // namespace whitepp
+
+
+#endif // SERVER_H_
@@ -0,0 +1,170 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef SESSION_H_
+#define SESSION_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "InputSource.h"
+#include "OutputSink.h"
+#include "Program.h"
+#include "VirtualMachine.h"
+
+
+namespace whitepp {
+
+/**
+ * This class represents an interactive execution of a program that never
+ * blocks its thread.
+ *
+ * The caller pushes input and takes output, and calls resume() whenever
+ * input arrived or output was consumed.  This way one thread, e.g. with an
+ * epoll loop, can drive many sessions:
+ *
+ *   switch (session.resume()) {
+ *     case VirtualMachine::Status::NeedsInput: // send output, wait for input
+ *     case VirtualMachine::Status::HasOutput:  // send output, resume later
+ *     case VirtualMachine::Status::Finished:   // send output, close
+ *   }
+ */
+class Session {
+
+private:
+
+  /**
+   * The input pushed by the caller.
+   */
+  PushInputSource input_;
+
+
+  /**
+   * The output taken by the caller.
+   */
+  PullOutputSink output_;
+
+
+  /**
+   * The virtual machine.
+   */
+  VirtualMachine vm_;
+
+
+public:
+
+  /**
+   * Start a session for a program.
+   *
+   * @param program The program.
+   */
+  Session(std::shared_ptr<Program const> const& program) : vm_(program) {
+
+    vm_.set_input(input_);
+    vm_.set_output(output_);
+  }
+
+
+  /**
+   * Start a session from a copy of a virtual machine, e.g. one that was run
+   * until it reads input for the first time.
+   *
+   * @param vm The virtual machine, which is forked in O(1).
+   */
+  Session(VirtualMachine& vm) : vm_(vm.fork()) {
+
+    vm_.set_input(input_);
+    vm_.set_output(output_);
+  }
+
+
+  Session(Session const&) = delete;
+
+
+  Session& operator=(Session const&) = delete;
+
+
+  /**
+   * The destructor.
+   */
+  ~Session() {}
+
+
+  /**
+   * Continue the program.
+   *
+   * @returns Why the program stopped.
+   * @throws std::runtime_error if the program fails.
+   */
+  VirtualMachine::Status resume() {
+    return vm_.resume();
+  }
+
+
+  /**
+   * Continue the program for at most the given number of instructions.
+   *
+   * @param max_steps The maximal number of instructions to perform.
+   * @returns Why the program stopped.
+   * @throws std::runtime_error if the program fails.
+   */
+  VirtualMachine::Status run_for(unsigned long long const max_steps) {
+    return vm_.run_for(max_steps);
+  }
+
+
+  /**
+   * Provide input to the program.
+   *
+   * @param data The bytes.
+   * @param size The number of bytes.
+   */
+  void push_input(char const* data, std::size_t size) {
+    input_.push(data, size);
+  }
+
+
+  /**
+   * Provide input to the program.
+   *
+   * @param str The input.
+   */
+  void push_input(std::string const& str) {
+    input_.push(str.data(), str.size());
+  }
+
+
+  /**
+   * Mark the end of the input.
+   */
+  void close_input() {
+    input_.close();
+  }
+
+
+  /**
+   * @returns The output produced since the last call.
+   */
+  std::string take_output() {
+    return output_.take();
+  }
+
+
+  /**
+   * @returns The virtual machine.
+   */
+  VirtualMachine& get_vm() {
+    return vm_;
+  }
+
+};
+
+} // namespace whitepp
+
+
+#endif // SESSION_H_
@@ -0,0 +1,158 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef SPSCRING_H_
+#define SPSCRING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+
+namespace whitepp {
+
+/**
+ * This class implements a lock-free ring buffer for exactly one producer
+ * thread and one consumer thread.
+ */
+template <typename T>
+class SpscRing {
+
+private:
+
+  /**
+   * The elements.
+   */
+  std::unique_ptr<T[]> data_;
+
+
+  /**
+   * The number of elements, which is a power of two.
+   */
+  std::size_t capacity_;
+
+
+  /**
+   * The number of elements ever pushed, written by the producer only.
+   */
+  std::atomic<std::size_t> head_;
+
+
+  /**
+   * Keeps head_ and tail_ in separate cache lines.
+   */
+  char padding_[64];
+
+
+  /**
+   * The number of elements ever popped, written by the consumer only.
+   */
+  std::atomic<std::size_t> tail_;
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param capacity The number of elements, which must be a power of two.
+   */
+  SpscRing(std::size_t const capacity) :
+      data_(new T[capacity]), capacity_(capacity), head_(0), tail_(0) {
+
+    if (capacity_ == 0 || (capacity_ & (capacity_ - 1)) != 0) {
+      throw std::invalid_argument("Ring capacity must be a power of two");
+    }
+  }
+
+
+  /**
+   * The destructor.
+   */
+  ~SpscRing() {}
+
+
+  /**
+   * Add elements, which may be called by the producer only.
+   *
+   * @param values The elements.
+   * @param count The number of elements.
+   * @returns The number of elements added, which is less than count if the
+   *          ring is full.
+   */
+  std::size_t push(T const* values, std::size_t count) {
+
+    auto const head = head_.load(std::memory_order_relaxed);
+    auto const tail = tail_.load(std::memory_order_acquire);
+
+    auto const free = capacity_ - (head - tail);
+    if (count > free) {
+      count = free;
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+      data_[(head + i) & (capacity_ - 1)] = values[i];
+    }
+
+    head_.store(head + count, std::memory_order_release);
+
+    return count;
+  }
+
+
+  /**
+   * Remove elements, which may be called by the consumer only.
+   *
+   * @param values Receives the elements.
+   * @param count The maximal number of elements.
+   * @returns The number of elements removed, which is less than count if the
+   *          ring runs empty.
+   */
+  std::size_t pop(T* values, std::size_t count) {
+
+    auto const tail = tail_.load(std::memory_order_relaxed);
+    auto const head = head_.load(std::memory_order_acquire);
+
+    auto const used = head - tail;
+    if (count > used) {
+      count = used;
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+      values[i] = data_[(tail + i) & (capacity_ - 1)];
+    }
+
+    tail_.store(tail + count, std::memory_order_release);
+
+    return count;
+  }
+
+
+  /**
+   * @returns The number of elements in the ring.
+   */
+  std::size_t size() const {
+
+    auto const tail = tail_.load(std::memory_order_acquire);
+    return head_.load(std::memory_order_acquire) - tail;
+  }
+
+
+  /**
+   * @returns The number of elements that fit into the ring.
+   */
+  std::size_t capacity() const {
+    return capacity_;
+  }
+
+};
+
+} // namespace whitepp
+
+
+#endif // SPSCRING_H_
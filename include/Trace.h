@@ -0,0 +1,271 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Program.h"
+#include "VirtualMachine.h"
+
+
+namespace whitepp {
+
+/**
+ * This class records the last instructions a virtual machine performed in a
+ * ring buffer, together with the top of the stack after each.
+ *
+ * Recording is a few stores per instruction, so a trace can be kept during
+ * long runs.  It is dumped to a file when the program fails, when the
+ * process crashes, and on SIGUSR2 at the next dispatch boundary.  Dumps are
+ * binary unless text was requested; decode() renders binary dumps.
+ *
+ * Only one trace may exist at a time, since the signal handlers are
+ * process-wide.
+ */
+class Trace {
+
+public:
+
+  /**
+   * An instruction performed.
+   */
+  struct Entry {
+
+    /**
+     * The index of the instruction.
+     */
+    std::uint32_t index;
+
+
+    /**
+     * The top of the stack after the instruction, if has_top is set.
+     */
+    std::int32_t top;
+
+
+    /**
+     * The opcode, an index into the table of opcode_name().
+     */
+    std::uint8_t opcode;
+
+
+    /**
+     * A combination of has_top and failed.
+     */
+    std::uint8_t flags;
+
+
+    std::uint16_t reserved;
+
+  };
+
+
+  /**
+   * The stack was not empty after the instruction.
+   */
+  static std::uint8_t const has_top = 1;
+
+
+  /**
+   * The instruction failed and was not performed.
+   */
+  static std::uint8_t const failed = 2;
+
+
+  /**
+   * The version of the binary format.
+   */
+  static std::uint32_t const version = 2;
+
+
+private:
+
+  /**
+   * Set by the signal handler of SIGUSR2.
+   */
+  static volatile std::sig_atomic_t pending_;
+
+
+  VirtualMachine const& vm_;
+
+
+  /**
+   * The fingerprint of the program, which dumps carry.
+   */
+  std::uint64_t program_;
+
+
+  /**
+   * The opcode of each instruction.
+   */
+  std::vector<std::uint8_t> opcodes_;
+
+
+  /**
+   * The ring buffer, whose size is a power of two.
+   */
+  std::vector<Entry> entries_;
+
+
+  /**
+   * The number of instructions recorded so far.
+   */
+  std::uint64_t recorded_;
+
+
+  /**
+   * The file dumps are written to.
+   */
+  std::string path_;
+
+
+  /**
+   * If true, dumps are written as text, except after a crash.
+   */
+  bool text_;
+
+
+  static void handle_request(int);
+
+
+  static void handle_crash(int signal);
+
+
+  /**
+   * Write a dump with system calls only, so it can be done after a crash.
+   */
+  void write_raw() const;
+
+
+public:
+
+  /**
+   * The standard constructor, which installs the signal handlers.
+   *
+   * @param vm The virtual machine, which the trace observes.
+   * @param capacity The number of instructions kept, rounded up to a power
+   *                 of two.
+   * @param path The file dumps are written to.
+   * @param text If true, dumps are written as text.
+   * @throws std::runtime_error if another trace exists.
+   */
+  Trace(VirtualMachine const& vm, std::size_t const capacity, std::string const& path,
+        bool const text);
+
+
+  Trace(Trace const&) = delete;
+
+
+  Trace& operator=(Trace const&) = delete;
+
+
+  /**
+   * The destructor, which restores the signal handlers.
+   */
+  ~Trace();
+
+
+  /**
+   * Record an instruction performed, and dump the trace if SIGUSR2 arrived.
+   */
+  void step(unsigned int const index, unsigned int const) {
+
+    auto& entry = entries_[recorded_ & (entries_.size() - 1)];
+
+    int top = 0;
+    entry.flags = vm_.get_stack().peek(top) ? has_top : 0;
+    entry.index = index;
+    entry.top = top;
+    entry.opcode = opcodes_[index];
+
+    ++recorded_;
+
+    if (pending_ != 0) {
+
+      pending_ = 0;
+      dump();
+    }
+  }
+
+
+  /**
+   * Record the instruction the virtual machine failed at, so it ends the
+   * trace.  This only stores, so it is safe in a signal handler.
+   */
+  void record_failure() {
+
+    auto const index = vm_.get_program_counter();
+
+    if (index < opcodes_.size()) {
+
+      auto& entry = entries_[recorded_ & (entries_.size() - 1)];
+
+      entry.index = index;
+      entry.top = 0;
+      entry.opcode = opcodes_[index];
+      entry.flags = failed;
+
+      ++recorded_;
+    }
+  }
+
+
+  /**
+   * Write the trace to its file.  Errors are reported to the standard error.
+   */
+  void dump() const;
+
+
+  /**
+   * Write the trace in the binary format.
+   *
+   * @param out The binary output stream.
+   */
+  void write_binary(std::ostream& out) const;
+
+
+  /**
+   * Write the trace as text, one instruction per line, the oldest first.
+   *
+   * @param out The output stream.
+   */
+  void write_text(std::ostream& out) const;
+
+
+  /**
+   * @param opcode An opcode.
+   * @returns Its name, as printed by Instruction::to_str().
+   */
+  static char const* opcode_name(unsigned int const opcode);
+
+
+  /**
+   * Render a binary dump as text.
+   *
+   * @param in The binary input stream.
+   * @param program The program that was traced, or nullptr to print the
+   *                opcodes only.
+   * @param out The output stream.
+   * @throws std::runtime_error if the dump is invalid or belongs to another
+   *         program.
+   */
+  static void decode(std::istream& in, Program const* program, std::ostream& out);
+
+};
+
+} // namespace whitepp
+
+
+#endif // TRACE_H_
@@ -8,12 +8,21 @@
 #ifndef VIRTUALMACHINE_H_
 #define VIRTUALMACHINE_H_
 
+#include <csignal>
+#include <cstddef>
+#include <istream>
+#include <limits>
 #include <map>
 #include <memory>
+#include <ostream>
 #include <string>
-#include <vector>
 
+#include "CowHeap.h"
+#include "CowStack.h"
+#include "InputSource.h"
+#include "OutputSink.h"
 #include "Parser.h"
+#include "Program.h"
 
 
 namespace whitepp {
@@ -23,18 +32,42 @@ namespace whitepp {
  */
 class VirtualMachine : public InstructionVisitor {
 
-private:
+public:
 
   /**
-   * The set of instructions, i.e. the program.
+   * The reasons why the virtual machine returns control to its caller.
    */
-  instructions_t instructions_;
+  enum class Status {
+
+    /**
+     * The program has ended.
+     */
+    Finished,
+
+    /**
+     * The next instruction reads input that did not arrive yet.
+     */
+    NeedsInput,
+
+    /**
+     * The output has to be consumed before the program can continue.
+     */
+    HasOutput,
 
+    /**
+     * The budget of instructions is exhausted.
+     */
+    Preempted
+
+  };
+
+
+private:
 
   /**
-   * A map where to find labels in the instructions vector.
+   * The program, which may be shared with other virtual machines.
    */
-  std::map<std::string, int> labels_;
+  std::shared_ptr<Program const> program_;
 
 
   //
@@ -44,19 +77,19 @@ private:
   /**
    * The heap.
    */
-  std::map<int, int> heap_;
+  CowHeap heap_;
 
 
   /**
    * The stack.
    */
-  std::vector<int> stack_;
+  CowStack<int> stack_;
 
 
   /**
    * The call stack.
    */
-  std::vector<int> call_stack_;
+  CowStack<int> call_stack_;
 
 
   /**
@@ -65,12 +98,167 @@ private:
   unsigned int program_counter_;
 
 
+  /**
+   * The source of the input.
+   */
+  InputSource* in_;
+
+
+  /**
+   * The destination of the output.
+   */
+  OutputSink* out_;
+
+
+  /**
+   * The number of instructions performed.
+   */
+  unsigned long long steps_;
+
+
+  /**
+   * The maximal depth of the stack so far.
+   */
+  std::size_t peak_stack_;
+
+
+  /**
+   * The maximal depth of the call stack so far.
+   */
+  std::size_t peak_calls_;
+
+
   /**
    * Once run() was called, it cannot be called again.
    */
   bool finished_;
 
 
+  /**
+   * If true, the virtual machine stops in front of input instructions.
+   */
+  bool stop_at_input_;
+
+
+  /**
+   * True iff the virtual machine has to return control to its caller.
+   */
+  bool suspended_;
+
+
+  /**
+   * The reason why the virtual machine was suspended.
+   */
+  Status suspend_status_;
+
+
+  /**
+   * True iff the last instruction is an input instruction that was not
+   * performed, since it has to wait for input or its wait was given up.
+   */
+  bool waiting_for_input_;
+
+
+  /**
+   * True iff the last jump, call or conditional jump performed continued at
+   * its target.
+   */
+  bool branch_taken_;
+
+
+  /**
+   * Set by request_state().
+   */
+  static volatile std::sig_atomic_t state_requested_;
+
+
+  /**
+   * The stream requested states are printed to, or nullptr.
+   */
+  static std::ostream* state_out_;
+
+
+  /**
+   * Print the state to state_out_ and clear the request.
+   *
+   * @param steps The number of instructions performed, including those of
+   *              the current call of execute().
+   */
+  void answer_state_request(unsigned long long const steps) const;
+
+
+  /**
+   * Like print_state(), with the given number of instructions performed.
+   */
+  void write_state(std::ostream& out, unsigned long long const steps) const;
+
+
+  /**
+   * Return control to the caller after the current instruction.
+   *
+   * @param status The reason.
+   */
+  void suspend(Status const status) {
+
+    suspended_ = true;
+    suspend_status_ = status;
+  }
+
+
+  /**
+   * An observer that ignores all instructions.  With it, the dispatch loop
+   * compiles to the same code as without observer.
+   */
+  struct NoObserver {
+
+    void step(unsigned int const, unsigned int const) {}
+
+  };
+
+
+  /**
+   * Perform instructions until the program ends, the virtual machine is
+   * suspended, or the given number of instructions was performed.
+   *
+   * @param max_steps The maximal number of instructions to perform.
+   * @param observer An object whose step(index, next) is called after every
+   *                 instruction performed, with the index of the instruction
+   *                 and the index of the next.
+   */
+  template<typename Observer>
+  void execute(unsigned long long const max_steps, Observer& observer);
+
+
+  void execute(unsigned long long const max_steps) {
+
+    NoObserver observer;
+    execute(max_steps, observer);
+  }
+
+
+  /**
+   * Flush the output and determine why execute() returned.
+   *
+   * @returns The status run_for() returns.
+   */
+  Status end_slice();
+
+
+  /**
+   * @param status The status that ended run().
+   * @throws std::runtime_error unless status is Finished.
+   */
+  void check_finished(Status const status) const;
+
+
+  /**
+   * Continue at the target of the current instruction.
+   *
+   * @throws std::runtime_error if the label of the instruction is undefined.
+   */
+  void jump();
+
+
   //
   // Abstract methods inherited from InstructionVisitor.
   //
@@ -101,12 +289,56 @@ private:
 
 public:
 
+  /**
+   * This class stores the state of a virtual machine.
+   *
+   * Taking and restoring a checkpoint is O(1), since the heap and the stacks
+   * are shared with the virtual machine until either of them is modified.
+   */
+  class Checkpoint {
+
+  private:
+
+    friend class VirtualMachine;
+
+
+    CowHeap heap_;
+
+
+    CowStack<int> stack_;
+
+
+    CowStack<int> call_stack_;
+
+
+    unsigned int program_counter_;
+
+
+    unsigned long long steps_;
+
+
+    bool finished_;
+
+  };
+
+
   /**
    * The standard constructor.
    */
   VirtualMachine(instructions_t const& instructions,
                  std::map<std::string, int> const& labels) :
-      instructions_(instructions), labels_(labels), program_counter_(0), finished_(false) {}
+      VirtualMachine(std::make_shared<Program const>(instructions, labels)) {}
+
+
+  /**
+   * Construct a virtual machine for a program that may be shared.
+   */
+  VirtualMachine(std::shared_ptr<Program const> const& program) :
+      program_(program), program_counter_(0),
+      in_(&standard_input()), out_(&standard_output()), steps_(0), peak_stack_(0),
+      peak_calls_(0), finished_(false),
+      stop_at_input_(false), suspended_(false), suspend_status_(Status::Finished),
+      waiting_for_input_(false), branch_taken_(false) {}
 
 
   /**
@@ -117,17 +349,372 @@ public:
 
   /**
    * Run the virtual machine.
+   *
+   * @param max_steps The maximal number of instructions the program may
+   *                  perform in total.
+   * @throws std::runtime_error if the program fails, exceeds max_steps, or
+   *         waits for input from a source that never waits by itself.
+   */
+  void run(unsigned long long const max_steps =
+           std::numeric_limits<unsigned long long>::max()) {
+
+    NoObserver observer;
+    run(max_steps, observer);
+  }
+
+
+  /**
+   * Like run(), but report every instruction performed to an observer, as
+   * execute() does.  This is a separate instance of the dispatch loop, so
+   * observing costs nothing when it is not used.
+   */
+  template<typename Observer>
+  void run(unsigned long long const max_steps, Observer& observer);
+
+
+  /**
+   * Run the virtual machine until the program ends or it has to return
+   * control to the caller instead of waiting.
+   *
+   * When input is read from a PushInputSource, the virtual machine returns
+   * NeedsInput in front of an input instruction whose input did not arrive
+   * yet.  When output is written to a PullOutputSink, it returns HasOutput
+   * once output is waiting to be taken.  Afterwards, resume() continues
+   * where the virtual machine stopped.  All output is flushed on return.
+   *
+   * @returns Why the virtual machine returned.
    */
-  void run();
+  Status resume();
 
 
   /**
-   * Reset the virtual machine.
+   * Like resume(), but return Preempted after the given number of
+   * instructions.  The check is a counter comparison in the dispatch loop,
+   * so small budgets can be used to time-slice many virtual machines.
+   *
+   * @param max_steps The maximal number of instructions to perform.
+   * @returns Why the virtual machine returned.
+   */
+  Status run_for(unsigned long long const max_steps) {
+
+    NoObserver observer;
+    return run_for(max_steps, observer);
+  }
+
+
+  /**
+   * Like run_for(), but report every instruction performed to an observer.
+   */
+  template<typename Observer>
+  Status run_for(unsigned long long const max_steps, Observer& observer);
+
+
+  /**
+   * @returns The number of instructions performed.
+   */
+  unsigned long long get_steps() const {
+    return steps_;
+  }
+
+
+  /**
+   * Run the virtual machine until the next instruction would read input, the
+   * program ends, or the given number of instructions was performed.
+   *
+   * @param max_steps The maximal number of instructions to perform.
+   */
+  void run_until_input(unsigned long long const max_steps);
+
+
+  /**
+   * Write the state of the virtual machine to a snapshot.
+   *
+   * @param out The binary output stream to write to.
+   * @param output The output produced by the program so far.
+   */
+  void save_snapshot(std::ostream& out, std::string const& output) const;
+
+
+  /**
+   * Restore the state of the virtual machine from a snapshot that was taken
+   * with the same program.
+   *
+   * @param in The binary input stream to read from.
+   * @returns The output the program had produced when the snapshot was taken.
+   * @throws std::runtime_error if the snapshot cannot be read or belongs to
+   *         another program.
+   */
+  std::string load_snapshot(std::istream& in);
+
+
+  /**
+   * Reset the virtual machine, so it can run its program again.
    */
   void reset();
 
+
+  /**
+   * Reset the virtual machine and let it run another program.  This is
+   * cheaper than constructing a new one, since the stacks keep their
+   * capacity.
+   *
+   * @param program The program.
+   */
+  void reset(std::shared_ptr<Program const> const& program);
+
+
+  /**
+   * Copy the virtual machine in O(1).  The copy shares the program and,
+   * until either is modified, the heap and the stacks.
+   *
+   * This freezes the stacks, so the virtual machine must not be used by
+   * other threads meanwhile.  Plain copies do not modify it, but take time
+   * linear in the elements pushed since the stacks were frozen.
+   *
+   * @returns The copy.
+   */
+  VirtualMachine fork() {
+
+    stack_.freeze();
+    call_stack_.freeze();
+
+    return *this;
+  }
+
+
+  /**
+   * Save the state of the virtual machine in O(1).  Like fork(), this
+   * freezes the stacks.
+   *
+   * @returns The checkpoint.
+   */
+  Checkpoint checkpoint();
+
+
+  /**
+   * Restore a state of the virtual machine in O(1).  Pages and chunks
+   * modified since the checkpoint are released.
+   *
+   * @param checkpoint A checkpoint of this or a forked virtual machine.
+   */
+  void restore(Checkpoint const& checkpoint);
+
+
+  /**
+   * @param in The source of the input, which must outlive the virtual
+   *           machine.
+   */
+  void set_input(InputSource& in) {
+    in_ = &in;
+  }
+
+
+  /**
+   * @param out The destination of the output, which must outlive the
+   *            virtual machine.
+   */
+  void set_output(OutputSink& out) {
+    out_ = &out;
+  }
+
+
+  /**
+   * @returns The source of the input.
+   */
+  InputSource const& get_input() const {
+    return *in_;
+  }
+
+
+  /**
+   * @returns The destination of the output.
+   */
+  OutputSink const& get_output() const {
+    return *out_;
+  }
+
+
+  /**
+   * @returns The program.
+   */
+  std::shared_ptr<Program const> const& get_program() const {
+    return program_;
+  }
+
+
+  /**
+   * @returns True iff the last jump, call or conditional jump performed
+   *          continued at its target, even if that is the next instruction.
+   */
+  bool is_branch_taken() const {
+    return branch_taken_;
+  }
+
+
+  /**
+   * @returns The index of the next instruction.
+   */
+  unsigned int get_program_counter() const {
+    return program_counter_;
+  }
+
+
+  /**
+   * Print the position, the top of the stack and the calls not returned from
+   * yet.
+   *
+   * @param out The output stream.
+   */
+  void print_state(std::ostream& out) const {
+    write_state(out, steps_);
+  }
+
+
+  /**
+   * Let the virtual machine that reaches the next dispatch boundary first
+   * print its state to the stream set by set_state_output() and continue.
+   * A virtual machine waiting for input answers while it waits if the
+   * signal interrupts the wait, see InputSource::wait().
+   *
+   * This only sets a flag, so it may be called from a signal handler.
+   */
+  static void request_state() {
+    state_requested_ = 1;
+  }
+
+
+  /**
+   * @param out The stream requested states are printed to, or nullptr to
+   *            ignore requests.
+   */
+  static void set_state_output(std::ostream* out) {
+    state_out_ = out;
+  }
+
+
+  /**
+   * @returns The stack.
+   */
+  CowStack<int> const& get_stack() const {
+    return stack_;
+  }
+
+
+  /**
+   * @returns The call stack, holding the index of every call not returned
+   *          from yet.
+   */
+  CowStack<int> const& get_call_stack() const {
+    return call_stack_;
+  }
+
+
+  /**
+   * @returns The heap.
+   */
+  CowHeap const& get_heap() const {
+    return heap_;
+  }
+
+
+  /**
+   * @returns The maximal depth of the stack since the last reset.
+   */
+  std::size_t get_peak_stack() const {
+    return peak_stack_;
+  }
+
+
+  /**
+   * @returns The maximal depth of the call stack since the last reset.
+   */
+  std::size_t get_peak_calls() const {
+    return peak_calls_;
+  }
+
 };
 
+
+template<typename Observer>
+void VirtualMachine::execute(unsigned long long const max_steps, Observer& observer) {
+
+  auto const code = program_->get_code();
+  auto const size = program_->size();
+
+  suspended_ = false;
+  waiting_for_input_ = false;
+
+  unsigned long long steps = 0;
+
+  try {
+
+    for (;;) {
+
+      for (; program_counter_ < size && steps < max_steps && !suspended_ &&
+             state_requested_ == 0; ++steps) {
+
+        auto const index = program_counter_;
+        code[index]->accept(*this);
+
+        // An input instruction that waits for input is not performed.  Any
+        // other one is, even if it continues at itself, like a Ret returning
+        // to a CallLbl right before it.
+        if (!waiting_for_input_) {
+          observer.step(index, program_counter_);
+        }
+      }
+
+      // The input instruction that waits was counted, but is not performed.
+      if (waiting_for_input_) {
+
+        waiting_for_input_ = false;
+        --steps;
+      }
+
+      if (state_requested_ == 0) {
+        break;
+      }
+
+      answer_state_request(steps_ + steps);
+    }
+
+  } catch (...) {
+
+    // The instructions before the one that failed were performed.
+    steps_ += steps;
+    throw;
+  }
+
+  steps_ += steps;
+}
+
+
+template<typename Observer>
+void VirtualMachine::run(unsigned long long const max_steps, Observer& observer) {
+
+  Status status;
+
+  do {
+    status = run_for(max_steps - steps_, observer);
+  } while (status == Status::HasOutput);
+
+  check_finished(status);
+}
+
+
+template<typename Observer>
+VirtualMachine::Status VirtualMachine::run_for(unsigned long long const max_steps,
+                                               Observer& observer) {
+
+  if (finished_) {
+    return Status::Finished;
+  }
+
+  execute(max_steps, observer);
+
+  return end_slice();
+}
+
 } // namespace whitepp
 
 
@@ -0,0 +1,165 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef WORKSTEALINGPOOL_H_
+#define WORKSTEALINGPOOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace whitepp {
+
+/**
+ * This class implements a thread pool with one task queue per worker.
+ *
+ * A worker takes the newest task from its own queue and, once that is
+ * empty, steals the oldest task from the queue of another worker.  Tasks
+ * submitted by a worker go to its own queue, other tasks are distributed
+ * round-robin.  So workers rarely contend for the same queue, and uneven
+ * tasks still keep all workers busy.
+ */
+class WorkStealingPool {
+
+public:
+
+  typedef std::function<void()> task_t;
+
+
+private:
+
+  /**
+   * The queue of a worker.
+   */
+  struct Queue {
+
+    std::mutex mutex;
+
+
+    std::deque<task_t> tasks;
+
+  };
+
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+
+
+  std::vector<std::thread> workers_;
+
+
+  /**
+   * Guards the counters below.
+   */
+  std::mutex mutex_;
+
+
+  /**
+   * Signalled when a task is queued or the workers are stopped.
+   */
+  std::condition_variable work_cv_;
+
+
+  /**
+   * Signalled when the last task is done.
+   */
+  std::condition_variable idle_cv_;
+
+
+  /**
+   * The number of queued tasks no worker has claimed yet.
+   */
+  std::size_t unclaimed_;
+
+
+  /**
+   * The number of tasks submitted but not done.
+   */
+  std::size_t pending_;
+
+
+  /**
+   * The queue the next task from outside the pool goes to.
+   */
+  std::size_t next_queue_;
+
+
+  bool stop_;
+
+
+  /**
+   * The main loop of a worker.
+   *
+   * @param index The index of the worker.
+   */
+  void work(std::size_t const index);
+
+
+  /**
+   * Take a task from the own queue or steal one.  The caller must have
+   * claimed a task.
+   *
+   * @param index The index of the worker.
+   * @returns The task.
+   */
+  task_t take(std::size_t const index);
+
+
+public:
+
+  /**
+   * The standard constructor, which starts the workers.
+   *
+   * @param workers The number of worker threads.
+   */
+  WorkStealingPool(unsigned int workers = std::thread::hardware_concurrency());
+
+
+  /**
+   * The destructor, which waits for all tasks to be done.
+   */
+  ~WorkStealingPool();
+
+
+  WorkStealingPool(WorkStealingPool const&) = delete;
+
+
+  WorkStealingPool& operator=(WorkStealingPool const&) = delete;
+
+
+  /**
+   * Submit a task.  Tasks must not throw.
+   *
+   * @param task The task.
+   */
+  void submit(task_t task);
+
+
+  /**
+   * Wait until all tasks are done.
+   */
+  void wait();
+
+
+  /**
+   * @returns The number of worker threads.
+   */
+  std::size_t size() const {
+    return workers_.size();
+  }
+
+};
+
+} // namespace whitepp
+
+
+#endif // WORKSTEALINGPOOL_H_
@@ -0,0 +1,152 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#ifndef WHITEPP_H_
+#define WHITEPP_H_
+
+/*
+ * The C interface of libwhitepp.
+ *
+ * A program is parsed once and is immutable afterwards, so one program can
+ * be used by any number of virtual machines on any number of threads.  A
+ * virtual machine is used by one thread at a time; it is cheap to create,
+ * and whitepp_vm_reset() prepares it for another run.
+ *
+ * By default a virtual machine reads empty input and collects its output,
+ * which whitepp_vm_output() returns.  Callbacks can be set instead.
+ *
+ * No function throws; errors are reported by return values, and messages
+ * are available through whitepp_vm_error() or an error buffer.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+typedef struct whitepp_program whitepp_program;
+
+
+typedef struct whitepp_vm whitepp_vm;
+
+
+/*
+ * The results of whitepp_vm_run().
+ */
+enum whitepp_status {
+  WHITEPP_FINISHED = 0,
+  WHITEPP_FAILED = 1,
+  WHITEPP_STEP_LIMIT = 2
+};
+
+
+/*
+ * Reads up to size bytes into buffer and returns the number read, or 0 at
+ * the end of the input.
+ */
+typedef size_t (*whitepp_read_fn)(void* context, char* buffer, size_t size);
+
+
+/*
+ * Consumes size bytes of output and returns 0, or non-zero to fail the run.
+ */
+typedef int (*whitepp_write_fn)(void* context, char const* data, size_t size);
+
+
+/*
+ * Parse a program from memory.  Returns NULL on failure and, if error is
+ * not NULL, stores a NUL-terminated message of at most error_size bytes.
+ */
+whitepp_program* whitepp_program_parse(char const* source, size_t size,
+                                       char* error, size_t error_size);
+
+
+/*
+ * Parse a program from a file, like whitepp_program_parse().
+ */
+whitepp_program* whitepp_program_load(char const* path,
+                                      char* error, size_t error_size);
+
+
+/*
+ * Release a program.  Virtual machines using it keep it alive.
+ */
+void whitepp_program_free(whitepp_program* program);
+
+
+/*
+ * Create a virtual machine for a program.  Returns NULL if out of memory.
+ */
+whitepp_vm* whitepp_vm_new(whitepp_program const* program);
+
+
+void whitepp_vm_free(whitepp_vm* vm);
+
+
+/*
+ * Prepare the virtual machine for another run of program, or of the same
+ * program if program is NULL.  The input and output settings are kept, the
+ * collected output is discarded.
+ *
+ * This and the following functions that change the settings return 0, or
+ * non-zero if out of memory; the message is then available through
+ * whitepp_vm_error().
+ */
+int whitepp_vm_reset(whitepp_vm* vm, whitepp_program const* program);
+
+
+/*
+ * Read the input from memory, which must stay valid during the runs.
+ */
+int whitepp_vm_set_input(whitepp_vm* vm, char const* data, size_t size);
+
+
+int whitepp_vm_set_input_callback(whitepp_vm* vm, whitepp_read_fn read,
+                                  void* context);
+
+
+int whitepp_vm_set_output_callback(whitepp_vm* vm, whitepp_write_fn write,
+                                   void* context);
+
+
+/*
+ * Run the program until it has performed max_steps instructions in total
+ * since whitepp_vm_new() or whitepp_vm_reset(), 0 meaning no limit.  A
+ * program that performed them already stops at once with
+ * WHITEPP_STEP_LIMIT.
+ */
+enum whitepp_status whitepp_vm_run(whitepp_vm* vm, unsigned long long max_steps);
+
+
+/*
+ * Returns the output collected when no output callback is set, valid until
+ * the next call on vm, and stores its size.  Returns NULL if out of memory,
+ * with the message available through whitepp_vm_error().
+ */
+char const* whitepp_vm_output(whitepp_vm const* vm, size_t* size);
+
+
+/*
+ * Returns the message of the last failure, or "".
+ */
+char const* whitepp_vm_error(whitepp_vm const* vm);
+
+
+/*
+ * Returns the number of instructions performed since the last reset.
+ */
+unsigned long long whitepp_vm_steps(whitepp_vm const* vm);
+
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+
+#endif // WHITEPP_H_
@@ -0,0 +1,330 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "AsyncIo.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * The number of bytes moved between a ring and a file descriptor at once.
+ */
+std::size_t const chunk_size = 1 << 16;
+
+} // namespace
+
+
+template <typename Condition>
+void AsyncIo::wait_until(Condition condition, Stalls& stalls) {
+
+  auto const start = std::chrono::steady_clock::now();
+
+  for (unsigned int round = 0; round < 1024 && !condition(); ++round) {
+
+    if (round >= 64) {
+      std::this_thread::yield();
+    }
+  }
+
+  if (!condition()) {
+
+    std::unique_lock<std::mutex> lock(stall_mutex_);
+
+    // Announce the wait before checking the condition once more, so a
+    // wake-up from the I/O thread cannot get lost.
+    blocked_ = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // The timeout lets the condition notice signals, see
+    // InputSource::give_up().
+    while (!condition()) {
+      stall_cv_.wait_for(lock, std::chrono::milliseconds(10));
+    }
+
+    blocked_ = false;
+  }
+
+  auto const time = std::chrono::steady_clock::now() - start;
+
+  ++stalls.count;
+  stalls.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+}
+
+
+AsyncIo::Input::Input(AsyncIo& io) :
+    io_(io), buffer_(new char[chunk_size]) {}
+
+
+bool AsyncIo::Input::refill() {
+
+  auto size = io_.input_ring_.pop(buffer_.get(), chunk_size);
+
+  if (size == 0) {
+
+    auto& ring = io_.input_ring_;
+    auto& eof = io_.input_eof_;
+
+    // Check the ring again after the end of the input was seen, since the
+    // last block may have been pushed right before.
+    io_.wait_until([this, &ring, &eof]() { return ring.size() > 0 || eof.load() || give_up(); },
+                   io_.input_stalls_);
+
+    size = io_.input_ring_.pop(buffer_.get(), chunk_size);
+    if (size == 0) {
+      return false;
+    }
+  }
+
+  // There is room in the ring now.
+  io_.wake();
+
+  pos_ = buffer_.get();
+  end_ = buffer_.get() + size;
+
+  return true;
+}
+
+
+void AsyncIo::Output::write(char const* data, std::size_t size) {
+
+  auto& ring = io_.output_ring_;
+
+  while (size > 0) {
+
+    auto const pushed = ring.push(data, size);
+
+    data += pushed;
+    size -= pushed;
+
+    io_.wake();
+
+    if (size > 0) {
+
+      auto& failed = io_.output_failed_;
+      io_.wait_until([&ring, &failed]() {
+                       return ring.size() < ring.capacity() || failed.load();
+                     }, io_.output_stalls_);
+    }
+
+    if (io_.output_failed_) {
+      throw std::runtime_error("Output error: Cannot write output!");
+    }
+  }
+}
+
+
+AsyncIo::AsyncIo(int const in_fd, int const out_fd) :
+    in_fd_(in_fd), out_fd_(out_fd), input_ring_(ring_size), output_ring_(ring_size),
+    input_eof_(false), output_failed_(false), sleeping_(false), stop_(false), blocked_(false),
+    input_(*this), output_(*this) {
+
+  if (pipe(wake_pipe_) != 0) {
+    throw std::runtime_error(std::string("I/O error: ") + std::strerror(errno));
+  }
+
+  fcntl(wake_pipe_[0], F_SETFL, O_NONBLOCK);
+  fcntl(wake_pipe_[1], F_SETFL, O_NONBLOCK);
+
+  input_.tie(&output_);
+
+  thread_ = std::thread(&AsyncIo::serve, this);
+}
+
+
+AsyncIo::~AsyncIo() {
+
+  try {
+
+    stop();
+
+  } catch (std::runtime_error const& e) {
+
+    // Nothing sensible can be done about it any more.
+  }
+
+  close(wake_pipe_[0]);
+  close(wake_pipe_[1]);
+}
+
+
+void AsyncIo::wake() {
+
+  if (sleeping_.load()) {
+
+    char const c = 0;
+    if (::write(wake_pipe_[1], &c, 1) < 0) {
+      // The pipe is full, so the thread wakes up anyway.
+    }
+  }
+}
+
+
+void AsyncIo::wake_vm() {
+
+  // Pairs with the fence in wait_until(), so either the virtual machine sees
+  // the change or it is seen blocked here.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if (blocked_.load()) {
+
+    std::lock_guard<std::mutex> lock(stall_mutex_);
+    stall_cv_.notify_one();
+  }
+}
+
+
+bool AsyncIo::drain_output() {
+
+  char buffer[chunk_size];
+
+  std::size_t size;
+  while ((size = output_ring_.pop(buffer, sizeof(buffer))) > 0) {
+
+    // There is room in the ring now.
+    wake_vm();
+
+    char const* data = buffer;
+
+    while (size > 0) {
+
+      auto const written = ::write(out_fd_, data, size);
+
+      if (written < 0) {
+
+        if (errno == EINTR) {
+          continue;
+        }
+
+        return false;
+      }
+
+      data += written;
+      size -= written;
+    }
+  }
+
+  return true;
+}
+
+
+void AsyncIo::serve() {
+
+  char buffer[chunk_size];
+
+  while (true) {
+
+    // Whatever was pushed before stop_ was set is drained below, even if
+    // the thread only sees it now.
+    bool const stopping = stop_;
+
+    if (!output_failed_ && !drain_output()) {
+
+      output_failed_ = true;
+      wake_vm();
+    }
+
+    if (stopping) {
+      break;
+    }
+
+    bool const want_input = !input_eof_ &&
+                            input_ring_.size() < input_ring_.capacity();
+
+    // Announce the wait before checking for work once more, so a wake-up
+    // from the virtual machine cannot get lost.
+    sleeping_ = true;
+
+    bool const has_output = output_ring_.size() > 0 && !output_failed_;
+    bool const room_for_input = !input_eof_ &&
+                                input_ring_.size() < input_ring_.capacity();
+
+    if (has_output || stop_ || room_for_input != want_input) {
+
+      sleeping_ = false;
+      continue;
+    }
+
+    pollfd fds[2];
+    fds[0].fd = wake_pipe_[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = in_fd_;
+    fds[1].events = POLLIN;
+
+    auto const ready = poll(fds, want_input ? 2 : 1, -1);
+
+    sleeping_ = false;
+
+    if (ready < 0) {
+      continue;
+    }
+
+    if (fds[0].revents != 0) {
+      while (read(wake_pipe_[0], buffer, sizeof(buffer)) > 0) {}
+    }
+
+    if (want_input && fds[1].revents != 0) {
+
+      auto const free = input_ring_.capacity() - input_ring_.size();
+      auto const size = read(in_fd_, buffer, free < sizeof(buffer) ? free : sizeof(buffer));
+
+      if (size > 0) {
+
+        input_ring_.push(buffer, size);
+        wake_vm();
+
+      } else if (size == 0 || errno != EINTR) {
+
+        input_eof_ = true;
+        wake_vm();
+      }
+    }
+  }
+}
+
+
+void AsyncIo::stop() {
+
+  if (!thread_.joinable()) {
+    return;
+  }
+
+  output_.flush();
+
+  stop_ = true;
+
+  char const c = 0;
+  if (::write(wake_pipe_[1], &c, 1) < 0) {
+    // The pipe is full, so the thread wakes up anyway.
+  }
+
+  thread_.join();
+
+  if (output_failed_) {
+    throw std::runtime_error("Output error: Cannot write output!");
+  }
+}
+
+
+void AsyncIo::print_stalls(std::ostream& out) const {
+
+  out << "Async I/O: " << input_stalls_.count << " input stalls ("
+      << input_stalls_.nanoseconds / 1000000.0 << " ms), "
+      << output_stalls_.count << " output stalls ("
+      << output_stalls_.nanoseconds / 1000000.0 << " ms)" << std::endl;
+}
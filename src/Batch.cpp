@@ -0,0 +1,240 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Batch.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "InputSource.h"
+#include "OutputSink.h"
+#include "VirtualMachine.h"
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * This class closes a file descriptor when it goes out of scope.
+ */
+class File {
+
+private:
+
+  int fd_;
+
+
+public:
+
+  /**
+   * Open a file.
+   *
+   * @param name The name of the file.
+   * @param flags The flags for open(2).
+   * @throws std::runtime_error if the file cannot be opened.
+   */
+  File(std::string const& name, int const flags) :
+      fd_(::open(name.c_str(), flags, 0666)) {
+
+    if (fd_ < 0) {
+      throw std::runtime_error("Cannot open " + name + ": " + std::strerror(errno));
+    }
+  }
+
+
+  ~File() {
+    ::close(fd_);
+  }
+
+
+  File(File const&) = delete;
+
+
+  File& operator=(File const&) = delete;
+
+
+  int get() const {
+    return fd_;
+  }
+
+};
+
+
+/**
+ * @param name The name of a file, or "-".
+ * @param fallback The file to use for "-".
+ * @returns The name of the file to open.
+ */
+std::string resolve(std::string const& name, char const* fallback) {
+  return (name == "-") ? fallback : name;
+}
+
+
+/**
+ * @param duration A duration.
+ * @returns The duration in milliseconds.
+ */
+double to_ms(std::chrono::steady_clock::duration const duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+} // namespace
+
+
+Batch::Batch(std::istream& manifest) :
+    parse_time_(std::chrono::steady_clock::duration::zero()),
+    run_time_(std::chrono::steady_clock::duration::zero()) {
+
+  std::string line;
+  unsigned int number = 0;
+
+  while (std::getline(manifest, line)) {
+
+    ++number;
+
+    std::istringstream fields(line);
+    Job job;
+
+    if (!(fields >> job.program) || job.program[0] == '#') {
+      continue;
+    }
+
+    std::string extra;
+
+    if (!(fields >> job.input >> job.output) || (fields >> extra)) {
+
+      throw std::runtime_error("Manifest line " + std::to_string(number) +
+                               ": expected PROGRAM INPUT OUTPUT.");
+    }
+
+    jobs_.emplace_back(std::move(job));
+  }
+}
+
+
+void Batch::run(WorkStealingPool& pool, unsigned long long const max_steps) {
+
+  auto const parse_start = std::chrono::steady_clock::now();
+
+  for (auto const& job : jobs_) {
+
+    if (programs_.count(job.program) > 0) {
+      continue;
+    }
+
+    try {
+
+      programs_[job.program] = load_program(job.program);
+
+    } catch (std::runtime_error const& e) {
+
+      programs_[job.program] = nullptr;
+      program_errors_[job.program] = e.what();
+    }
+  }
+
+  auto const run_start = std::chrono::steady_clock::now();
+  parse_time_ = run_start - parse_start;
+
+  for (auto& job : jobs_) {
+
+    auto* const j = &job;
+    pool.submit([this, j, max_steps]() { run_job(*j, max_steps); });
+  }
+
+  pool.wait();
+
+  run_time_ = std::chrono::steady_clock::now() - run_start;
+}
+
+
+void Batch::run_job(Job& job, unsigned long long const max_steps) {
+
+  auto const start = std::chrono::steady_clock::now();
+
+  // The map is not modified any more, so all workers can read it.
+  auto const& program = programs_.find(job.program)->second;
+
+  if (!program) {
+
+    job.error = program_errors_.find(job.program)->second;
+    return;
+  }
+
+  try {
+
+    File input(resolve(job.input, "/dev/null"), O_RDONLY);
+    File output(resolve(job.output, "/dev/null"), O_WRONLY | O_CREAT | O_TRUNC);
+
+    FdInputSource source(input.get());
+    FdOutputSink sink(output.get());
+
+    VirtualMachine vm(program);
+    vm.set_input(source);
+    vm.set_output(sink);
+
+    try {
+
+      vm.run(max_steps);
+      sink.flush();
+
+      job.ok = true;
+
+    } catch (std::runtime_error const& e) {
+
+      job.error = e.what();
+    }
+
+    job.steps = vm.get_steps();
+
+  } catch (std::runtime_error const& e) {
+
+    job.error = e.what();
+  }
+
+  job.time = std::chrono::steady_clock::now() - start;
+}
+
+
+void Batch::print_summary(std::ostream& out) const {
+
+  out << "job\tstatus\tms\tsteps\tprogram\tinput\toutput\terror\n";
+
+  for (std::size_t i = 0; i < jobs_.size(); ++i) {
+
+    auto const& job = jobs_[i];
+
+    out << i << '\t' << (job.ok ? "ok" : "failed") << '\t' << to_ms(job.time)
+        << '\t' << job.steps << '\t' << job.program << '\t' << job.input
+        << '\t' << job.output << '\t' << job.error << '\n';
+  }
+
+  out << "# " << jobs_.size() << " jobs, " << get_failures() << " failed, "
+      << programs_.size() << " programs parsed in " << to_ms(parse_time_)
+      << " ms, run in " << to_ms(run_time_) << " ms" << std::endl;
+}
+
+
+std::size_t Batch::get_failures() const {
+
+  std::size_t failures = 0;
+
+  for (auto const& job : jobs_) {
+
+    if (!job.ok) {
+      ++failures;
+    }
+  }
+
+  return failures;
+}
@@ -0,0 +1,339 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "whitepp.h"
+
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "InputSource.h"
+#include "OutputSink.h"
+#include "Program.h"
+#include "VirtualMachine.h"
+
+using namespace whitepp;
+
+
+struct whitepp_program {
+
+  std::shared_ptr<Program const> program;
+
+};
+
+
+struct whitepp_vm {
+
+  /**
+   * The input and output, declared first so they outlive the machine.
+   */
+  std::unique_ptr<InputSource> input;
+
+
+  std::unique_ptr<OutputSink> output;
+
+
+  /**
+   * The output sink if the output is collected, or nullptr.
+   */
+  StringOutputSink* collected;
+
+
+  /**
+   * The message of the last failure, which whitepp_vm_output() can set on a
+   * const virtual machine.
+   */
+  mutable std::string error;
+
+
+  VirtualMachine vm;
+
+
+  whitepp_vm(std::shared_ptr<Program const> const& program) :
+      input(new MemoryInputSource(nullptr, 0)), output(new StringOutputSink()),
+      collected(static_cast<StringOutputSink*>(output.get())), vm(program) {
+
+    vm.set_input(*input);
+    vm.set_output(*output);
+  }
+
+};
+
+
+namespace {
+
+/**
+ * Store an error message in a caller's buffer.
+ */
+void report(char const* message, char* error, std::size_t const error_size) {
+
+  if (error == nullptr || error_size == 0) {
+    return;
+  }
+
+  std::strncpy(error, message, error_size - 1);
+  error[error_size - 1] = '\0';
+}
+
+
+/**
+ * Store the message of a failure in a virtual machine.
+ */
+void fail(whitepp_vm const* vm, char const* message) {
+
+  try {
+
+    vm->error = message;
+
+  } catch (std::exception const&) {
+
+    vm->error.clear();
+  }
+}
+
+
+/**
+ * Change a virtual machine, catching all exceptions.
+ *
+ * @returns 0, or -1 if the change failed.
+ */
+template<typename Change>
+int change_vm(whitepp_vm* vm, Change const& change) {
+
+  try {
+
+    change();
+    return 0;
+
+  } catch (std::exception const& e) {
+
+    fail(vm, e.what());
+    return -1;
+  }
+}
+
+
+/**
+ * Parse a program, catching all exceptions.
+ */
+template<typename Parse>
+whitepp_program* make_program(Parse const& parse, char* error, std::size_t const error_size) {
+
+  try {
+
+    std::unique_ptr<whitepp_program> program(new whitepp_program());
+    program->program = parse();
+
+    return program.release();
+
+  } catch (std::exception const& e) {
+
+    report(e.what(), error, error_size);
+    return nullptr;
+  }
+}
+
+} // namespace
+
+
+whitepp_program* whitepp_program_parse(char const* source, size_t size,
+                                       char* error, size_t error_size) {
+
+  return make_program([source, size]() {
+
+    std::istringstream in(std::string(source, size));
+    return parse_program(in);
+
+  }, error, error_size);
+}
+
+
+whitepp_program* whitepp_program_load(char const* path, char* error, size_t error_size) {
+
+  return make_program([path]() { return load_program(path); }, error, error_size);
+}
+
+
+void whitepp_program_free(whitepp_program* program) {
+  delete program;
+}
+
+
+whitepp_vm* whitepp_vm_new(whitepp_program const* program) {
+
+  try {
+
+    return new whitepp_vm(program->program);
+
+  } catch (std::exception const&) {
+
+    return nullptr;
+  }
+}
+
+
+void whitepp_vm_free(whitepp_vm* vm) {
+  delete vm;
+}
+
+
+int whitepp_vm_reset(whitepp_vm* vm, whitepp_program const* program) {
+
+  return change_vm(vm, [vm, program]() {
+
+    std::unique_ptr<StringOutputSink> collected;
+
+    if (vm->collected != nullptr) {
+      collected.reset(new StringOutputSink());
+    }
+
+    if (program != nullptr) {
+      vm->vm.reset(program->program);
+    } else {
+      vm->vm.reset();
+    }
+
+    if (collected) {
+
+      vm->collected = collected.get();
+      vm->output = std::move(collected);
+      vm->vm.set_output(*vm->output);
+    }
+
+    vm->error.clear();
+  });
+}
+
+
+int whitepp_vm_set_input(whitepp_vm* vm, char const* data, size_t size) {
+
+  return change_vm(vm, [vm, data, size]() {
+
+    vm->input.reset(new MemoryInputSource(data, size));
+    vm->vm.set_input(*vm->input);
+  });
+}
+
+
+int whitepp_vm_set_input_callback(whitepp_vm* vm, whitepp_read_fn read, void* context) {
+
+  return change_vm(vm, [vm, read, context]() {
+
+    vm->input.reset(new CallbackInputSource([read, context](char* buffer, std::size_t size) {
+      return read(context, buffer, size);
+    }));
+
+    vm->vm.set_input(*vm->input);
+  });
+}
+
+
+int whitepp_vm_set_output_callback(whitepp_vm* vm, whitepp_write_fn write, void* context) {
+
+  return change_vm(vm, [vm, write, context]() {
+
+    vm->output.reset(new CallbackOutputSink([write, context](char const* data,
+                                                             std::size_t size) {
+
+      if (write(context, data, size) != 0) {
+        throw std::runtime_error("Output error: Callback failed!");
+      }
+    }));
+
+    vm->collected = nullptr;
+    vm->vm.set_output(*vm->output);
+  });
+}
+
+
+whitepp_status whitepp_vm_run(whitepp_vm* vm, unsigned long long max_steps) {
+
+  if (max_steps == 0) {
+    max_steps = std::numeric_limits<unsigned long long>::max();
+  }
+
+  vm->error.clear();
+
+  try {
+
+    VirtualMachine::Status status;
+
+    do {
+
+      // The limit counts the instructions of earlier calls, too.
+      auto const steps = vm->vm.get_steps();
+      status = vm->vm.run_for(steps < max_steps ? max_steps - steps : 0);
+
+    } while (status == VirtualMachine::Status::HasOutput);
+
+    if (status == VirtualMachine::Status::Preempted) {
+
+      vm->error = "Runtime error: Step limit exceeded!";
+      return WHITEPP_STEP_LIMIT;
+    }
+
+    if (status == VirtualMachine::Status::NeedsInput) {
+      throw std::runtime_error("Runtime error: Input not available!");
+    }
+
+    return WHITEPP_FINISHED;
+
+  } catch (std::exception const& e) {
+
+    fail(vm, e.what());
+  }
+
+  // Keep the output produced before the failure.
+  try {
+
+    vm->output->flush();
+
+  } catch (std::exception const&) {
+
+    // The error reported is more relevant.
+  }
+
+  return WHITEPP_FAILED;
+}
+
+
+char const* whitepp_vm_output(whitepp_vm const* vm, size_t* size) {
+
+  *size = 0;
+
+  if (vm->collected == nullptr) {
+    return "";
+  }
+
+  try {
+
+    auto const& str = vm->collected->get_str();
+
+    *size = str.size();
+    return str.data();
+
+  } catch (std::exception const& e) {
+
+    fail(vm, e.what());
+    return nullptr;
+  }
+}
+
+
+char const* whitepp_vm_error(whitepp_vm const* vm) {
+  return vm->error.c_str();
+}
+
+
+unsigned long long whitepp_vm_steps(whitepp_vm const* vm) {
+  return vm->vm.get_steps();
+}
@@ -0,0 +1,61 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "CowHeap.h"
+
+using namespace whitepp;
+
+
+CowHeap::Page& CowHeap::writable_page(int const key) {
+
+  // Unshare the page table first, which copies pointers only.
+  if (table_.use_count() != 1) {
+    table_ = std::make_shared<table_t>(*table_);
+  }
+
+  auto& page = (*table_)[key];
+
+  if (!page) {
+    page = std::make_shared<Page>();
+  } else if (page.use_count() != 1) {
+    page = std::make_shared<Page>(*page);
+  }
+
+  cache_key_ = key;
+  cache_slot_ = &page;
+
+  return *page;
+}
+
+
+std::vector<std::pair<int, int>> CowHeap::entries() const {
+
+  std::vector<std::pair<int, int>> result;
+  result.reserve(size_);
+
+  for (auto const& entry : *table_) {
+
+    auto const& page = *entry.second;
+
+    for (int i = 0; i < page_size; ++i) {
+      if (page.used[i]) {
+        result.emplace_back(entry.first * page_size + i, page.values[i]);
+      }
+    }
+  }
+
+  return result;
+}
+
+
+void CowHeap::clear() {
+
+  table_ = std::make_shared<table_t>();
+  size_ = 0;
+
+  cache_slot_ = nullptr;
+}
@@ -0,0 +1,78 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Engine.h"
+
+#include <stdexcept>
+
+#include "RegisterEngine.h"
+
+using namespace whitepp;
+
+
+ReferenceEngine::ReferenceEngine(std::shared_ptr<Program const> const& program,
+                                 InputSource& in, OutputSink& out) : vm_(program) {
+
+  vm_.set_input(in);
+  vm_.set_output(out);
+
+  for (auto const& instr : program->get_instructions()) {
+
+    if (dynamic_cast<Store const*>(instr.get()) != nullptr) {
+      writes_.emplace_back(2);
+    } else if (dynamic_cast<ReadChar const*>(instr.get()) != nullptr ||
+               dynamic_cast<ReadInt const*>(instr.get()) != nullptr) {
+      writes_.emplace_back(1);
+    } else {
+      writes_.emplace_back(0);
+    }
+  }
+}
+
+
+void ReferenceEngine::record_write(unsigned int const index, std::vector<int>& written) const {
+
+  int address;
+
+  if (vm_.get_stack().peek(address, writes_[index] - 1)) {
+    written.emplace_back(address);
+  }
+}
+
+
+void ReferenceEngine::run_for(unsigned long long const max_steps, std::vector<int>& written) {
+
+  auto const index = vm_.get_program_counter();
+
+  if (index < writes_.size() && writes_[index] != 0) {
+    record_write(index, written);
+  }
+
+  WriteObserver observer{ *this, written };
+  vm_.run_for(max_steps, observer);
+}
+
+
+std::vector<std::string> whitepp::engine_names() {
+  return { "reference", "register" };
+}
+
+
+std::unique_ptr<Engine> whitepp::make_engine(std::string const& name,
+                                             std::shared_ptr<Program const> const& program,
+                                             InputSource& in, OutputSink& out) {
+
+  if (name == "reference") {
+    return std::unique_ptr<Engine>(new ReferenceEngine(program, in, out));
+  }
+
+  if (name == "register") {
+    return std::unique_ptr<Engine>(new RegisterEngine(program, in, out));
+  }
+
+  throw std::runtime_error("Unknown engine " + name + ".");
+}
@@ -0,0 +1,297 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "InputSource.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace whitepp;
+
+
+bool InputSource::fill() {
+
+  if (tie_ != nullptr) {
+    tie_->flush();
+  }
+
+  consumed_ += pos_ - start_;
+
+  auto const more = refill();
+  start_ = pos_;
+
+  return more;
+}
+
+
+bool InputSource::give_up() {
+
+  if (interrupt_ == nullptr || *interrupt_ == 0) {
+    return false;
+  }
+
+  interrupted_ = true;
+  return true;
+}
+
+
+bool InputSource::wait(volatile std::sig_atomic_t const& flag, bool const skip_space) {
+
+  interrupt_ = &flag;
+  interrupted_ = false;
+
+  int c;
+
+  while ((c = peek()) != eof && skip_space &&
+         (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f')) {
+    ++pos_;
+  }
+
+  interrupt_ = nullptr;
+
+  return !interrupted_;
+}
+
+
+bool InputSource::get_record(std::string& record, char const delimiter) {
+
+  record.clear();
+
+  while (pos_ != end_ || fill()) {
+
+    auto const found = static_cast<char const*>(std::memchr(pos_, delimiter, end_ - pos_));
+
+    if (found != nullptr) {
+
+      record.append(pos_, found + 1);
+      pos_ = found + 1;
+
+      return true;
+    }
+
+    record.append(pos_, end_);
+    pos_ = end_;
+  }
+
+  return !record.empty();
+}
+
+
+std::size_t InputSource::get_block(char* const buffer, std::size_t const size) {
+
+  if (pos_ == end_ && !fill()) {
+    return 0;
+  }
+
+  auto const count = std::min<std::size_t>(size, end_ - pos_);
+
+  std::memcpy(buffer, pos_, count);
+  pos_ += count;
+
+  return count;
+}
+
+
+bool InputSource::get_int(int& value) {
+
+  int c;
+
+  while ((c = peek()) == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+         c == '\v' || c == '\f') {
+    ++pos_;
+  }
+
+  bool const negative = (c == '-');
+  if (c == '-' || c == '+') {
+
+    ++pos_;
+    c = peek();
+  }
+
+  if (c < '0' || c > '9') {
+    return false;
+  }
+
+  // The magnitude of the smallest int.
+  unsigned long long const limit = 2147483648ull;
+
+  unsigned long long num = 0;
+
+  do {
+
+    num = num * 10 + (c - '0');
+    if (num > limit) {
+      return false;
+    }
+
+    ++pos_;
+    c = peek();
+
+  } while (c >= '0' && c <= '9');
+
+  if (!negative && num == limit) {
+    return false;
+  }
+
+  value = negative ? static_cast<int>(0u - static_cast<unsigned int>(num))
+                   : static_cast<int>(num);
+
+  return true;
+}
+
+
+bool InputSource::ready_int() const {
+
+  if (!is_pending()) {
+    return true;
+  }
+
+  // An integer is complete once a character that does not belong to it is
+  // buffered.  Anything else makes get_int() fail at once.
+  auto p = pos_;
+
+  while (p != end_ && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' ||
+                       *p == '\v' || *p == '\f')) {
+    ++p;
+  }
+
+  if (p != end_ && (*p == '-' || *p == '+')) {
+    ++p;
+  }
+
+  while (p != end_ && *p >= '0' && *p <= '9') {
+    ++p;
+  }
+
+  return p != end_;
+}
+
+
+FdInputSource::FdInputSource(int const fd, OutputSink* const tie) :
+    fd_(fd), map_(nullptr), map_size_(0) {
+
+  this->tie(tie);
+
+  struct stat st;
+
+  if (fstat(fd_, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+
+    auto const offset = lseek(fd_, 0, SEEK_CUR);
+
+    if (offset >= 0 && offset < st.st_size) {
+
+      auto const map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+
+      if (map != MAP_FAILED) {
+
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+        map_ = map;
+        map_size_ = st.st_size;
+
+        pos_ = start_ = static_cast<char const*>(map_) + offset;
+        end_ = static_cast<char const*>(map_) + map_size_;
+
+        return;
+      }
+    }
+  }
+
+  // The input cannot be mapped, so it is read in blocks.
+  buffer_.reset(new char[block_size]);
+}
+
+
+bool FdInputSource::refill() {
+
+  if (map_ != nullptr) {
+    return false;
+  }
+
+  for (;;) {
+
+    // Check before every read, since a signal that arrives right before the
+    // read does not interrupt it.
+    if (give_up()) {
+      return false;
+    }
+
+    auto const size = ::read(fd_, buffer_.get(), block_size);
+
+    if (size < 0) {
+
+      if (errno == EINTR) {
+        continue;
+      }
+
+      throw std::runtime_error(std::string("Input error: ") + std::strerror(errno));
+    }
+
+    if (size == 0) {
+      return false;
+    }
+
+    pos_ = buffer_.get();
+    end_ = buffer_.get() + size;
+
+    return true;
+  }
+}
+
+
+FdInputSource::~FdInputSource() {
+
+  if (map_ != nullptr) {
+    munmap(map_, map_size_);
+  }
+}
+
+
+bool CallbackInputSource::refill() {
+
+  auto const size = read_(buffer_.get(), block_size);
+
+  if (size == 0) {
+    return false;
+  }
+
+  pos_ = buffer_.get();
+  end_ = buffer_.get() + (size < block_size ? size : block_size);
+
+  return true;
+}
+
+
+void PushInputSource::push(char const* data, std::size_t size) {
+
+  restart_block();
+
+  // Drop the input read already before appending.  Nothing was pushed
+  // before the first call.
+  if (pos_ != nullptr) {
+    buffer_.erase(0, pos_ - buffer_.data());
+  }
+
+  buffer_.append(data, size);
+
+  pos_ = start_ = buffer_.data();
+  end_ = buffer_.data() + buffer_.size();
+}
+
+
+InputSource& whitepp::standard_input() {
+
+  static FdInputSource source(STDIN_FILENO, &standard_output());
+
+  return source;
+}
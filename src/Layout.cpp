@@ -0,0 +1,235 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Layout.h"
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * This visitor copies an instruction.
+ */
+class Copier : public InstructionVisitor {
+
+private:
+
+  /**
+   * The copy of the last instruction visited.
+   */
+  std::shared_ptr<Instruction> copy_;
+
+
+  template <typename T>
+  void make(T const& instr) {
+    copy_ = std::make_shared<T>(instr);
+  }
+
+
+public:
+
+  /**
+   * @param instr An instruction.
+   * @returns A copy of instr.
+   */
+  std::shared_ptr<Instruction> copy(Instruction& instr) {
+
+    instr.accept(*this);
+    return copy_;
+  }
+
+
+  virtual void visit(Push& instr) override { make(instr); }
+  virtual void visit(Dupl& instr) override { make(instr); }
+  virtual void visit(Swap& instr) override { make(instr); }
+  virtual void visit(Discard& instr) override { make(instr); }
+  virtual void visit(Add& instr) override { make(instr); }
+  virtual void visit(Sub& instr) override { make(instr); }
+  virtual void visit(Mul& instr) override { make(instr); }
+  virtual void visit(Div& instr) override { make(instr); }
+  virtual void visit(Mod& instr) override { make(instr); }
+  virtual void visit(Store& instr) override { make(instr); }
+  virtual void visit(Retrieve& instr) override { make(instr); }
+  virtual void visit(SetLbl& instr) override { make(instr); }
+  virtual void visit(CallLbl& instr) override { make(instr); }
+  virtual void visit(Jump& instr) override { make(instr); }
+  virtual void visit(JumpZero& instr) override { make(instr); }
+  virtual void visit(JumpNeg& instr) override { make(instr); }
+  virtual void visit(Ret& instr) override { make(instr); }
+  virtual void visit(End& instr) override { make(instr); }
+  virtual void visit(PrintChar& instr) override { make(instr); }
+  virtual void visit(PrintInt& instr) override { make(instr); }
+  virtual void visit(ReadChar& instr) override { make(instr); }
+  virtual void visit(ReadInt& instr) override { make(instr); }
+
+};
+
+
+/**
+ * A run of instructions that is only left at its end or by jumps and calls.
+ */
+struct Chain {
+
+  std::size_t begin;
+
+
+  std::size_t end;
+
+
+  /**
+   * How often its most frequent instruction was performed.
+   */
+  unsigned long long heat;
+
+};
+
+
+/**
+ * @returns true iff the instruction never continues with the next one.
+ */
+bool ends_chain(Instruction const& instr) {
+  return dynamic_cast<Jump const*>(&instr) != nullptr ||
+         dynamic_cast<Ret const*>(&instr) != nullptr ||
+         dynamic_cast<End const*>(&instr) != nullptr;
+}
+
+} // namespace
+
+
+std::shared_ptr<Program const> whitepp::lay_out(std::shared_ptr<Program const> const& program,
+                                                std::vector<unsigned long long> const& counts) {
+
+  auto const& instructions = program->get_instructions();
+  auto const size = instructions.size();
+
+  if (counts.size() != size) {
+    throw std::runtime_error("The profile does not fit the program.");
+  }
+
+  if (size == 0) {
+    return program;
+  }
+
+  //
+  // Cut the program into chains.
+  //
+
+  std::vector<Chain> chains;
+  std::vector<std::size_t> chain_of(size);
+
+  for (std::size_t i = 0; i < size; ) {
+
+    Chain chain{ i, i, 0 };
+
+    do {
+
+      chain_of[chain.end] = chains.size();
+      chain.heat = std::max(chain.heat, counts[chain.end]);
+
+    } while (!ends_chain(*instructions[chain.end++]) && chain.end < size);
+
+    chains.emplace_back(chain);
+    i = chain.end;
+  }
+
+  //
+  // Order the chains.
+  //
+
+  auto const last = chains.size() - 1;
+  auto const runs_off = !ends_chain(*instructions[size - 1]);
+
+  std::vector<bool> placed(chains.size(), false);
+  std::vector<std::size_t> order;
+
+  auto place = [&](std::size_t const chain) {
+
+    placed[chain] = true;
+    order.emplace_back(chain);
+  };
+
+  // Whether a chain may be placed among the hot ones.
+  auto is_free = [&](std::size_t const chain) {
+    return !placed[chain] && chains[chain].heat > 0 && !(runs_off && chain == last);
+  };
+
+  std::vector<std::size_t> by_heat(chains.size());
+  std::iota(by_heat.begin(), by_heat.end(), 0);
+  std::stable_sort(by_heat.begin(), by_heat.end(), [&](std::size_t const a, std::size_t const b) {
+    return chains[a].heat > chains[b].heat;
+  });
+
+  auto hottest = by_heat.begin();
+
+  for (place(0); ; ) {
+
+    auto const end = chains[order.back()].end - 1;
+    auto const target = program->get_target(end);
+
+    if (dynamic_cast<Jump const*>(instructions[end].get()) != nullptr && target >= 0 &&
+        is_free(chain_of[target]) && chains[chain_of[target]].begin == std::size_t(target)) {
+
+      place(chain_of[target]);
+      continue;
+    }
+
+    while (hottest != by_heat.end() && !is_free(*hottest)) {
+      ++hottest;
+    }
+
+    if (hottest == by_heat.end()) {
+      break;
+    }
+
+    place(*hottest);
+  }
+
+  for (std::size_t chain = 0; chain < chains.size(); ++chain) {
+
+    if (!placed[chain] && !(runs_off && chain == last)) {
+      place(chain);
+    }
+  }
+
+  if (!placed[last]) {
+    place(last);
+  }
+
+  //
+  // Copy the instructions in their new order.
+  //
+
+  instructions_t reordered;
+  reordered.reserve(size);
+
+  std::vector<int> new_index(size);
+  Copier copier;
+
+  for (auto const chain : order) {
+
+    for (auto i = chains[chain].begin; i < chains[chain].end; ++i) {
+
+      new_index[i] = reordered.size();
+      reordered.emplace_back(copier.copy(*instructions[i]));
+    }
+  }
+
+  std::map<std::string, int> labels;
+
+  for (auto const& label : program->get_labels()) {
+    labels.emplace(label.first, new_index[label.second]);
+  }
+
+  return std::make_shared<Program const>(reordered, labels);
+}
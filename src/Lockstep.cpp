@@ -0,0 +1,346 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Lockstep.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * The maximal number of heap cells and instructions listed in a report.
+ */
+std::size_t const report_lines = 16;
+
+
+/**
+ * The number of bytes of output shown around a difference.
+ */
+std::size_t const output_context = 32;
+
+
+/**
+ * @returns A string as a C literal.
+ */
+std::string quote(std::string const& str) {
+
+  std::ostringstream out;
+  out << '"';
+
+  for (auto const c : str) {
+
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (c == '\n') {
+      out << "\\n";
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << "\\x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(c)
+          << std::dec << std::setfill(' ');
+    } else {
+      out << c;
+    }
+  }
+
+  out << '"';
+  return out.str();
+}
+
+
+/**
+ * @returns Values as a list, the last one first.
+ */
+std::string top_first(std::vector<int> const& values) {
+
+  std::ostringstream out;
+
+  for (auto it = values.rbegin(); it != values.rend(); ++it) {
+    out << (it == values.rbegin() ? "" : " ") << *it;
+  }
+
+  return out.str();
+}
+
+
+/**
+ * @returns An error, or "none".
+ */
+std::string error_or_none(std::string const& error) {
+  return error.empty() ? "none" : quote(error);
+}
+
+} // namespace
+
+
+Lockstep::Lockstep(std::shared_ptr<Program const> const& program, std::string const& candidate,
+                   InputSource& in, OutputSink& out) :
+    program_(program), in_(in), out_(out), reference_read_(0), candidate_read_(0),
+    reference_in_([this](char* buffer, std::size_t size) {
+      return provide_input(reference_read_, buffer, size);
+    }),
+    candidate_in_([this](char* buffer, std::size_t size) {
+      return provide_input(candidate_read_, buffer, size);
+    }),
+    reference_(new ReferenceEngine(program, reference_in_, reference_out_)),
+    candidate_(make_engine(candidate, program, candidate_in_, candidate_out_)),
+    output_checked_(0), output_written_(0) {
+
+  auto const& instructions = program->get_instructions();
+  auto const size = instructions.size();
+
+  // A block starts at the beginning, at labels and jump targets, and after
+  // instructions that do not continue with the next one.
+  std::vector<bool> leaders(size + 1, false);
+  leaders[0] = true;
+  leaders[size] = true;
+
+  for (std::size_t i = 0; i < size; ++i) {
+
+    auto const& instr = *instructions[i];
+
+    if (dynamic_cast<SetLbl const*>(&instr) != nullptr) {
+      leaders[i] = true;
+    }
+
+    if (program->get_target(i) >= 0) {
+      leaders[program->get_target(i)] = true;
+    }
+
+    if (program->get_target(i) >= 0 ||
+        dynamic_cast<Ret const*>(&instr) != nullptr ||
+        dynamic_cast<End const*>(&instr) != nullptr) {
+      leaders[i + 1] = true;
+    }
+  }
+
+  block_lengths_.resize(size);
+
+  for (auto i = size; i-- > 0; ) {
+    block_lengths_[i] = leaders[i + 1] ? 1 : block_lengths_[i + 1] + 1;
+  }
+}
+
+
+std::size_t Lockstep::provide_input(std::size_t& read, char* buffer, std::size_t const size) {
+
+  if (read == input_.size()) {
+
+    // The program may have prompted for the input.
+    write_output(std::string::npos);
+    out_.flush();
+
+    auto const c = in_.get_char();
+    if (c == InputSource::eof) {
+      return 0;
+    }
+
+    input_ += static_cast<char>(c);
+  }
+
+  auto const count = input_.copy(buffer, size, read);
+  read += count;
+
+  return count;
+}
+
+
+void Lockstep::write_output(std::size_t const count) {
+
+  auto const& output = reference_out_.get_str();
+
+  if (output_written_ < output.size() && count > output_written_) {
+
+    auto const end = std::min(output.size(), count);
+
+    out_.put_str(output.substr(output_written_, end - output_written_));
+
+    output_written_ = end;
+  }
+}
+
+
+bool Lockstep::compare(unsigned int const block, unsigned long long const steps,
+                       std::string const& reference_error, std::string const& candidate_error,
+                       std::size_t const stack_count, std::ostream& report) {
+
+  auto const reference_stack = reference_->get_stack_top(stack_count);
+  auto const candidate_stack = candidate_->get_stack_top(stack_count);
+
+  // Both heaps agreed before the block, so only the cells either engine
+  // wrote to can differ now.
+  written_.clear();
+  written_.insert(written_.end(), reference_written_.begin(), reference_written_.end());
+  written_.insert(written_.end(), candidate_written_.begin(), candidate_written_.end());
+  std::sort(written_.begin(), written_.end());
+  written_.erase(std::unique(written_.begin(), written_.end()), written_.end());
+
+  auto const& reference_heap = reference_->get_heap();
+  auto const& candidate_heap = candidate_->get_heap();
+
+  auto const heap_differs = reference_heap.size() != candidate_heap.size() ||
+      std::any_of(written_.begin(), written_.end(), [&](int const address) {
+        return reference_heap.get(address) != candidate_heap.get(address);
+      });
+
+  auto const& reference_output = reference_out_.get_str();
+  auto const& candidate_output = candidate_out_.get_str();
+
+  auto const output_differs = reference_output.compare(output_checked_, std::string::npos,
+                                                       candidate_output, output_checked_,
+                                                       std::string::npos) != 0;
+
+  if (reference_error == candidate_error &&
+      reference_->get_program_counter() == candidate_->get_program_counter() &&
+      reference_->get_steps() == candidate_->get_steps() &&
+      reference_->get_stack_size() == candidate_->get_stack_size() &&
+      reference_stack == candidate_stack && !heap_differs && !output_differs) {
+    return true;
+  }
+
+  report << "The " << candidate_->get_name() << " engine differs from the reference after "
+         << "the block at " << block << ", which started after " << steps << " instructions:"
+         << std::endl;
+
+  if (reference_error != candidate_error) {
+    report << "  Error:   reference " << error_or_none(reference_error) << ", candidate "
+           << error_or_none(candidate_error) << std::endl;
+  }
+
+  if (reference_->get_program_counter() != candidate_->get_program_counter()) {
+    report << "  Next:    reference " << reference_->get_program_counter() << ", candidate "
+           << candidate_->get_program_counter() << std::endl;
+  }
+
+  if (reference_->get_steps() != candidate_->get_steps()) {
+    report << "  Steps:   reference " << reference_->get_steps() << ", candidate "
+           << candidate_->get_steps() << std::endl;
+  }
+
+  if (reference_->get_stack_size() != candidate_->get_stack_size() ||
+      reference_stack != candidate_stack) {
+    report << "  Stack:   reference " << reference_->get_stack_size() << " values, top first: "
+           << top_first(reference_stack) << std::endl
+           << "           candidate " << candidate_->get_stack_size() << " values, top first: "
+           << top_first(candidate_stack) << std::endl;
+  }
+
+  if (reference_heap.size() != candidate_heap.size()) {
+    report << "  Heap:    reference " << reference_heap.size() << " cells, candidate "
+           << candidate_heap.size() << " cells" << std::endl;
+  }
+
+  std::size_t listed = 0;
+
+  for (auto const address : written_) {
+
+    if (reference_heap.get(address) == candidate_heap.get(address)) {
+      continue;
+    }
+
+    if (listed++ == report_lines) {
+      report << "  Heap:    …" << std::endl;
+      break;
+    }
+
+    report << "  Heap:    cell " << address << ": reference " << reference_heap.get(address)
+           << ", candidate " << candidate_heap.get(address) << std::endl;
+  }
+
+  if (output_differs) {
+
+    auto offset = output_checked_;
+
+    while (offset < reference_output.size() && offset < candidate_output.size() &&
+           reference_output[offset] == candidate_output[offset]) {
+      ++offset;
+    }
+
+    report << "  Output:  from byte " << offset << ", reference "
+           << quote(reference_output.substr(offset, output_context)) << ", candidate "
+           << quote(candidate_output.substr(offset, output_context)) << std::endl;
+  }
+
+  auto const& instructions = program_->get_instructions();
+
+  report << "  Block:" << std::endl;
+
+  for (auto i = block; i < block + std::min<std::size_t>(block_lengths_[block], report_lines);
+       ++i) {
+    report << "    " << std::setw(8) << i << "  " << instructions[i]->to_str() << std::endl;
+  }
+
+  if (block_lengths_[block] > report_lines) {
+    report << "    …" << std::endl;
+  }
+
+  return false;
+}
+
+
+bool Lockstep::run(unsigned long long const max_steps, std::ostream& report) {
+
+  auto const size = program_->size();
+
+  while (reference_->get_program_counter() < size) {
+
+    auto const steps = reference_->get_steps();
+
+    if (steps >= max_steps) {
+
+      out_.flush();
+      throw std::runtime_error("Runtime error: Step limit exceeded!");
+    }
+
+    auto const block = reference_->get_program_counter();
+    auto const count = std::min<unsigned long long>(block_lengths_[block], max_steps - steps);
+
+    std::string reference_error;
+    std::string candidate_error;
+
+    reference_written_.clear();
+    candidate_written_.clear();
+
+    try {
+      reference_->run_for(count, reference_written_);
+    } catch (std::runtime_error const& e) {
+      reference_error = e.what();
+    }
+
+    try {
+      candidate_->run_for(count, candidate_written_);
+    } catch (std::runtime_error const& e) {
+      candidate_error = e.what();
+    }
+
+    auto const ended = !reference_error.empty() || reference_->get_program_counter() >= size;
+
+    if (!compare(block, steps, reference_error, candidate_error,
+                 ended ? reference_->get_stack_size() : stack_window, report)) {
+
+      out_.flush();
+      return false;
+    }
+
+    output_checked_ = reference_out_.get_str().size();
+    write_output(output_checked_);
+
+    if (!reference_error.empty()) {
+
+      out_.flush();
+      throw std::runtime_error(reference_error);
+    }
+  }
+
+  out_.flush();
+
+  return true;
+}
@@ -0,0 +1,88 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Metrics.h"
+
+#include <iomanip>
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * Write a string as a JSON string.
+ */
+void write_string(std::ostream& out, std::string const& str) {
+
+  out << '"';
+
+  for (auto const c : str) {
+
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+          << static_cast<int>(c) << std::dec << std::setfill(' ');
+    } else {
+      out << c;
+    }
+  }
+
+  out << '"';
+}
+
+} // namespace
+
+
+void Metrics::collect(VirtualMachine const& vm) {
+
+  auto const& program = *vm.get_program();
+
+  instructions_ = program.size();
+  labels_ = program.get_labels().size();
+
+  steps_ = vm.get_steps();
+  peak_stack_ = vm.get_peak_stack();
+  peak_calls_ = vm.get_peak_calls();
+  heap_entries_ = vm.get_heap().size();
+  heap_bytes_ = vm.get_heap().bytes();
+  bytes_read_ = vm.get_input().get_bytes_read();
+  bytes_written_ = vm.get_output().get_bytes_written();
+}
+
+
+void Metrics::write_json(std::ostream& out) const {
+
+  out << "{\n"
+      << "  \"version\": " << version << ",\n"
+      << "  \"status\": \"" << (error_.empty() ? "finished" : "failed") << "\",\n"
+      << "  \"error\": ";
+
+  write_string(out, error_);
+
+  out << ",\n  \"time_ns\": {";
+
+  for (std::size_t i = 0; i < phases_.size(); ++i) {
+
+    out << (i > 0 ? ", " : " ");
+    write_string(out, phases_[i].first);
+    out << ": " << phases_[i].second;
+  }
+
+  out << " },\n"
+      << "  \"program\": { \"tokens\": " << tokens_ << ", \"instructions\": " << instructions_
+      << ", \"labels\": " << labels_ << " },\n"
+      << "  \"instructions_executed\": " << steps_ << ",\n"
+      << "  \"peak_stack_depth\": " << peak_stack_ << ",\n"
+      << "  \"peak_call_depth\": " << peak_calls_ << ",\n"
+      << "  \"heap\": { \"entries\": " << heap_entries_ << ", \"bytes\": " << heap_bytes_
+      << " },\n"
+      << "  \"io\": { \"bytes_read\": " << bytes_read_ << ", \"bytes_written\": "
+      << bytes_written_ << " }\n"
+      << "}\n";
+}
@@ -0,0 +1,161 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "OutputSink.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <unistd.h>
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * The decimal representations of 0 to 99, two characters each.
+ */
+char const digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+
+/**
+ * The maximal length of a decimal int, including the sign.
+ */
+std::size_t const max_int_length = 11;
+
+} // namespace
+
+
+OutputSink::OutputSink(Mode const mode, std::size_t const capacity) :
+    buffer_(new char[capacity]), capacity_(capacity), used_(0), flushed_(0), mode_(mode),
+    backlog_(false) {
+
+  if (capacity_ < max_int_length) {
+    throw std::invalid_argument("Output buffer too small");
+  }
+}
+
+
+void OutputSink::put_int(int const i) {
+
+  if (capacity_ - used_ < max_int_length) {
+    flush();
+  }
+
+  // Convert two digits at a time from the back of a local buffer.
+  char digits[max_int_length];
+  char* p = digits + max_int_length;
+
+  unsigned int n = (i < 0) ? 0u - static_cast<unsigned int>(i) : i;
+
+  while (n >= 100) {
+
+    auto const pair = (n % 100) * 2;
+    n /= 100;
+
+    *--p = digit_pairs[pair + 1];
+    *--p = digit_pairs[pair];
+  }
+
+  if (n >= 10) {
+
+    *--p = digit_pairs[n * 2 + 1];
+    *--p = digit_pairs[n * 2];
+
+  } else {
+
+    *--p = static_cast<char>('0' + n);
+  }
+
+  if (i < 0) {
+    *--p = '-';
+  }
+
+  auto const length = digits + max_int_length - p;
+  std::memcpy(buffer_.get() + used_, p, length);
+  used_ += length;
+
+  if (used_ == capacity_) {
+    flush();
+  }
+}
+
+
+void OutputSink::put_str(std::string const& str) {
+
+  for (char const c : str) {
+    put_char(c);
+  }
+}
+
+
+void OutputSink::flush() {
+
+  if (used_ == 0) {
+    return;
+  }
+
+  // Empty the buffer first, so a failing write does not repeat.
+  auto const size = used_;
+  used_ = 0;
+  flushed_ += size;
+
+  write(buffer_.get(), size);
+}
+
+
+void FdOutputSink::write(char const* data, std::size_t size) {
+
+  while (size > 0) {
+
+    auto const written = ::write(fd_, data, size);
+
+    if (written < 0) {
+
+      if (errno == EINTR) {
+        continue;
+      }
+
+      throw std::runtime_error(std::string("Output error: ") + std::strerror(errno));
+    }
+
+    data += written;
+    size -= written;
+  }
+}
+
+
+FdOutputSink::~FdOutputSink() {
+
+  try {
+
+    flush();
+
+  } catch (std::runtime_error const& e) {
+
+    // Nothing sensible can be done about it any more.
+  }
+}
+
+
+OutputSink& whitepp::standard_output() {
+
+  static FdOutputSink sink(STDOUT_FILENO);
+  return sink;
+}
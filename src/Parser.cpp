@@ -11,18 +11,22 @@ using namespace whitepp;
 
 
 /**
- * This helper function checks whether string1 starts with string2.  If yes,
- * string1 is chopped.
+ * This helper function checks whether string1 starts with string2 at pos.
+ * If yes, pos is moved past it.
+ *
+ * The tokens are consumed by moving pos rather than by erasing them, which
+ * would make parsing quadratic in the size of the program.
  *
  * @param string1 A string.
+ * @param pos A position in string1.
  * @param string2 A string.
- * @returns true iff string1 starts with string2.
+ * @returns true iff string1 starts with string2 at pos.
  */
-bool starts_with(std::string& string1, std::string const& string2) {
+bool starts_with(std::string const& string1, std::size_t& pos, std::string const& string2) {
 
-  if (std::equal(std::cbegin(string2), std::cend(string2), std::cbegin(string1))) {
+  if (string1.compare(pos, string2.length(), string2) == 0) {
 
-    string1.erase(0, string2.length());
+    pos += string2.length();
     return true;
 
   } else {
@@ -35,25 +39,26 @@ bool starts_with(std::string& string1, std::string const& string2) {
 /**
  * This helper function reads an integer value.
  *
- * In this process, the string is chopped.
+ * In this process, pos is moved past it.
  *
  * @param string A string.
+ * @param pos A position in string.
  * @returns The read integer.
  * @throws std::runtime_error if no number can be read.
  */
-int read_int(std::string& string) {
+int read_int(std::string const& string, std::size_t& pos) {
 
   try {
 
-    if (string.at(0) == 'C') {
+    if (string.at(pos) == 'C') {
       throw std::runtime_error("Parsing error");
     }
 
-    int sign = (string.at(0) == 'A') ? 1 : -1;
+    int sign = (string.at(pos) == 'A') ? 1 : -1;
     int num = 0;
 
-    int i;
-    for (i = 1; string.at(i) != 'C'; ++i) {
+    std::size_t i;
+    for (i = pos + 1; string.at(i) != 'C'; ++i) {
 
       num *= 2;
 
@@ -62,7 +67,7 @@ int read_int(std::string& string) {
       }
     }
 
-    string.erase(0, i + 1);
+    pos = i + 1;
     
     return sign * num;
 
@@ -74,19 +79,19 @@ int read_int(std::string& string) {
 }
 
 
-std::string read_str(std::string& string) {
+std::string read_str(std::string const& string, std::size_t& pos) {
 
   try {
 
-    if (string.at(0) == 'C') {
+    if (string.at(pos) == 'C') {
       throw std::runtime_error("Parsing error");
     }
 
-    auto index = string.find('C');
+    auto index = string.find('C', pos);
     if (index != std::string::npos) {
 
-      auto str = string.substr(0, index);
-      string.erase(0, index + 1);
+      auto str = string.substr(pos, index - pos);
+      pos = index + 1;
 
       return str;
 
@@ -105,88 +110,90 @@ std::string read_str(std::string& string) {
 
 void Parser::parse(std::string& tokens) {
 
-  while (!tokens.empty()) {
+  std::size_t pos = 0;
+
+  while (pos < tokens.size()) {
 
-    if (starts_with(tokens, "AA")) {
+    if (starts_with(tokens, pos, "AA")) {
 
       // Push Integer
-      int num = read_int(tokens);
+      int num = read_int(tokens, pos);
       instructions_.emplace_back(std::make_shared<Push>(num));
 
-    } else if (starts_with(tokens, "ACA")) {
+    } else if (starts_with(tokens, pos, "ACA")) {
 
       // Duplicate last
       instructions_.emplace_back(std::make_shared<Dupl>());
 
-    } else if (starts_with(tokens, "ACB")) {
+    } else if (starts_with(tokens, pos, "ACB")) {
 
       // Swap last
       instructions_.emplace_back(std::make_shared<Swap>());
       
-    } else if (starts_with(tokens, "ACC")) {
+    } else if (starts_with(tokens, pos, "ACC")) {
 
       // Discard
       instructions_.emplace_back(std::make_shared<Discard>());
 
-    } else if (starts_with(tokens, "BAAA")) {
+    } else if (starts_with(tokens, pos, "BAAA")) {
 
       // Add
       instructions_.emplace_back(std::make_shared<Add>());
 
-    } else if (starts_with(tokens, "BAAB")) {
+    } else if (starts_with(tokens, pos, "BAAB")) {
 
       // Substract
       instructions_.emplace_back(std::make_shared<Sub>());
 
-    } else if (starts_with(tokens, "BAAC")) {
+    } else if (starts_with(tokens, pos, "BAAC")) {
 
       // Multiply
       instructions_.emplace_back(std::make_shared<Mul>());
 
-    } else if (starts_with(tokens, "BABA")) {
+    } else if (starts_with(tokens, pos, "BABA")) {
 
       // Divide
       instructions_.emplace_back(std::make_shared<Div>());
 
-    } else if (starts_with(tokens, "BABB")) {
+    } else if (starts_with(tokens, pos, "BABB")) {
 
       // Modulo
       instructions_.emplace_back(std::make_shared<Mod>());
 
-    } else if (starts_with(tokens, "BBA")) {
+    } else if (starts_with(tokens, pos, "BBA")) {
 
       // Store in heap
       instructions_.emplace_back(std::make_shared<Store>());
 
-    } else if (starts_with(tokens, "BBB")) {
+    } else if (starts_with(tokens, pos, "BBB")) {
 
       // Retrieve from heap
       instructions_.emplace_back(std::make_shared<Retrieve>());
 
-    } else if (starts_with(tokens, "BCAA")) {
+    } else if (starts_with(tokens, pos, "BCAA")) {
 
       // Print Char
       instructions_.emplace_back(std::make_shared<PrintChar>());
 
-    } else if (starts_with(tokens, "BCAB")) {
+    } else if (starts_with(tokens, pos, "BCAB")) {
 
       // Print Integer
       instructions_.emplace_back(std::make_shared<PrintInt>());
 
-    } else if (starts_with(tokens, "BCBA")) {
+    } else if (starts_with(tokens, pos, "BCBA")) {
 
       // Read Char
       instructions_.emplace_back(std::make_shared<ReadChar>());
 
-    } else if (starts_with(tokens, "BCBB")) {
+    } else if (starts_with(tokens, pos, "BCBB")) {
 
       // Read Integer
       instructions_.emplace_back(std::make_shared<ReadInt>());
 
-    } else if (starts_with(tokens, "CAA")) {
+    } else if (starts_with(tokens, pos, "CAA")) {
 
       // Set label
-      std::string str = read_str(tokens); 
+      std::string str = read_str(tokens, pos); 
 
       auto ret = labels_.emplace(str, instructions_.size());
       if (!ret.second) {
@@ -197,36 +204,36 @@ void Parser::parse(std::string& tokens) {
 
       instructions_.emplace_back(std::make_shared<SetLbl>(str));
 
-    } else if (starts_with(tokens, "CAB")) {
+    } else if (starts_with(tokens, pos, "CAB")) {
 
       // Call label
-      std::string str = read_str(tokens); 
+      std::string str = read_str(tokens, pos); 
       instructions_.emplace_back(std::make_shared<CallLbl>(str));
 
-    } else if (starts_with(tokens, "CAC")) {
+    } else if (starts_with(tokens, pos, "CAC")) {
 
       // Jump to label
-      std::string str = read_str(tokens); 
+      std::string str = read_str(tokens, pos); 
       instructions_.emplace_back(std::make_shared<Jump>(str));
 
-    } else if (starts_with(tokens, "CBA")) {
+    } else if (starts_with(tokens, pos, "CBA")) {
 
       // Jump to label if zero
-      std::string str = read_str(tokens); 
+      std::string str = read_str(tokens, pos); 
       instructions_.emplace_back(std::make_shared<JumpZero>(str));
 
-    } else if (starts_with(tokens, "CBB")) {
+    } else if (starts_with(tokens, pos, "CBB")) {
 
       // Jump to label if negative
-      std::string str = read_str(tokens); 
+      std::string str = read_str(tokens, pos); 
       instructions_.emplace_back(std::make_shared<JumpNeg>(str));
 
-    } else if (starts_with(tokens, "CBC")) {
+    } else if (starts_with(tokens, pos, "CBC")) {
 
       // Return
       instructions_.emplace_back(std::make_shared<Ret>());
 
-    } else if (starts_with(tokens, "CCC")) {
+    } else if (starts_with(tokens, pos, "CCC")) {
 
       // End
       instructions_.emplace_back(std::make_shared<End>());
@@ -237,6 +244,8 @@ void Parser::parse(std::string& tokens) {
       throw std::runtime_error("Parsing error");
     }
   }
+
+  tokens.clear();
 }
 
 
@@ -0,0 +1,189 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "PerfCounters.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * The type and configuration of each event.
+ */
+struct Event {
+
+  char const* name;
+
+
+  std::uint32_t type;
+
+
+  std::uint64_t config;
+
+};
+
+
+std::uint64_t const read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+
+Event const events[PerfCounters::count] = {
+  { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+  { "l1d-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | read_miss },
+  { "l1i-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1I | read_miss },
+  { "llc-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | read_miss }
+};
+
+
+/**
+ * Open a counter of the calling thread.
+ *
+ * @returns The file descriptor, or -1.
+ */
+int open_counter(Event const& event) {
+
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+
+  attr.size = sizeof(attr);
+  attr.type = event.type;
+  attr.config = event.config;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  // Unprivileged processes may only count user space.
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return ::syscall(__NR_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+} // namespace
+
+
+PerfCounters::PerfCounters() {
+
+  for (std::size_t i = 0; i < count; ++i) {
+
+    fds_[i] = open_counter(events[i]);
+
+    if (fds_[i] < 0 && error_.empty()) {
+      error_ = std::string(events[i].name) + ": " + std::strerror(errno);
+    }
+  }
+}
+
+
+PerfCounters::~PerfCounters() {
+
+  for (auto const fd : fds_) {
+
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+}
+
+
+char const* PerfCounters::name(std::size_t const counter) {
+  return events[counter].name;
+}
+
+
+bool PerfCounters::is_available() const {
+
+  for (auto const fd : fds_) {
+
+    if (fd >= 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+PerfCounters::values_t PerfCounters::read() const {
+
+  values_t values;
+
+  for (std::size_t i = 0; i < count; ++i) {
+
+    // The value, the time enabled and the time running.
+    std::uint64_t data[3];
+
+    if (fds_[i] < 0 || ::read(fds_[i], data, sizeof(data)) != sizeof(data)) {
+
+      values[i] = -1;
+      continue;
+    }
+
+    values[i] = (data[2] == 0) ? 0
+        : static_cast<long long>(static_cast<double>(data[0]) * data[1] / data[2]);
+  }
+
+  return values;
+}
+
+
+PerfCounters::values_t PerfCounters::difference(values_t const& before, values_t const& after) {
+
+  values_t values;
+
+  for (std::size_t i = 0; i < count; ++i) {
+    values[i] = (before[i] < 0 || after[i] < 0) ? -1 : after[i] - before[i];
+  }
+
+  return values;
+}
+
+
+void PerfCounters::print(std::ostream& out, phases_t const& phases) const {
+
+  if (!is_available()) {
+
+    out << "Performance counters unavailable (" << error_ << ")" << std::endl;
+    return;
+  }
+
+  out << "Performance counters:" << std::endl << std::left << std::setw(10) << "phase";
+
+  for (std::size_t i = 0; i < count; ++i) {
+    out << std::right << std::setw(16) << events[i].name;
+  }
+
+  out << std::endl;
+
+  for (auto const& phase : phases) {
+
+    out << std::left << std::setw(10) << phase.first;
+
+    for (auto const value : phase.second) {
+
+      out << std::right << std::setw(16);
+
+      if (value < 0) {
+        out << "n/a";
+      } else {
+        out << value;
+      }
+    }
+
+    out << std::endl;
+  }
+}
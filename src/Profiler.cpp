@@ -0,0 +1,223 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * The first line of every profile.
+ */
+char const profile_header[] = "White++ profile";
+
+
+/**
+ * The version of the profile format.
+ */
+unsigned int const profile_version = 1;
+
+
+/**
+ * A straight run of instructions that starts at a label or at the start of
+ * the program.
+ */
+struct Block {
+
+  std::size_t begin;
+
+
+  std::size_t end;
+
+
+  unsigned long long steps;
+
+};
+
+
+/**
+ * @returns The share of part in total, in percent.
+ */
+double percent(unsigned long long const part, unsigned long long const total) {
+  return (total > 0) ? 100.0 * part / total : 0;
+}
+
+} // namespace
+
+
+void Profiler::print(std::ostream& out) const {
+
+  auto const& instructions = program_->get_instructions();
+
+  unsigned long long total = 0;
+  for (auto const count : counts_) {
+    total += count;
+  }
+
+  auto const flags = out.flags();
+  auto const precision = out.precision();
+  out << std::fixed << std::setprecision(1);
+
+  //
+  // Opcodes.
+  //
+
+  std::map<std::string, unsigned long long> opcodes;
+
+  for (std::size_t i = 0; i < instructions.size(); ++i) {
+
+    if (counts_[i] > 0) {
+
+      auto const str = instructions[i]->to_str();
+      opcodes[str.substr(0, str.find(' '))] += counts_[i];
+    }
+  }
+
+  std::vector<std::pair<std::string, unsigned long long>> by_count(opcodes.begin(), opcodes.end());
+  std::stable_sort(by_count.begin(), by_count.end(),
+                   [](std::pair<std::string, unsigned long long> const& a,
+                      std::pair<std::string, unsigned long long> const& b) {
+                     return a.second > b.second;
+                   });
+
+  out << "Profile: " << total << " instructions performed" << std::endl << std::endl
+      << "Opcodes:" << std::endl;
+
+  for (auto const& opcode : by_count) {
+
+    out << std::setw(16) << opcode.second << std::setw(7) << percent(opcode.second, total)
+        << "%  " << opcode.first << std::endl;
+  }
+
+  //
+  // Blocks.
+  //
+
+  std::vector<Block> blocks;
+
+  for (std::size_t i = 0; i < instructions.size(); ++i) {
+
+    if (blocks.empty() || dynamic_cast<SetLbl const*>(instructions[i].get()) != nullptr) {
+
+      if (!blocks.empty()) {
+        blocks.back().end = i;
+      }
+
+      blocks.push_back(Block{ i, instructions.size(), 0 });
+    }
+
+    blocks.back().steps += counts_[i];
+  }
+
+  std::stable_sort(blocks.begin(), blocks.end(), [](Block const& a, Block const& b) {
+    return a.steps > b.steps;
+  });
+
+  std::size_t cold = 0;
+
+  for (auto const& block : blocks) {
+
+    if (block.steps == 0) {
+
+      ++cold;
+      continue;
+    }
+
+    out << std::endl
+        << (dynamic_cast<SetLbl const*>(instructions[block.begin].get()) == nullptr
+            ? "(start)" : instructions[block.begin]->to_str())
+        << ": " << block.steps << " instructions (" << percent(block.steps, total) << "%)"
+        << std::endl;
+
+    for (auto i = block.begin; i < block.end; ++i) {
+
+      out << std::setw(16) << counts_[i] << std::setw(8) << i << "  "
+          << instructions[i]->to_str();
+
+      auto const instr = instructions[i].get();
+
+      if (dynamic_cast<JumpZero const*>(instr) != nullptr ||
+          dynamic_cast<JumpNeg const*>(instr) != nullptr) {
+
+        out << "  (taken " << taken_[i] << ", not taken " << counts_[i] - taken_[i] << ")";
+      }
+
+      out << std::endl;
+    }
+  }
+
+  if (cold > 0) {
+    out << std::endl << cold << " blocks never performed" << std::endl;
+  }
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+
+void Profiler::write(std::ostream& out) const {
+
+  out << profile_header << ' ' << profile_version << '\n'
+      << "program " << std::hex << fingerprint(*program_) << std::dec << '\n';
+
+  for (std::size_t i = 0; i < counts_.size(); ++i) {
+
+    if (counts_[i] > 0) {
+      out << i << ' ' << counts_[i] << '\n';
+    }
+  }
+}
+
+
+std::vector<unsigned long long> Profiler::read(std::istream& in, Program const& program) {
+
+  std::string header;
+  std::getline(in, header);
+
+  if (header != profile_header + (' ' + std::to_string(profile_version))) {
+    throw std::runtime_error("Profile error: Not a profile of this version!");
+  }
+
+  std::string keyword;
+  std::uint64_t hash;
+
+  if (!(in >> keyword >> std::hex >> hash >> std::dec) || keyword != "program") {
+    throw std::runtime_error("Profile error: Cannot read the profile!");
+  }
+
+  if (hash != fingerprint(program)) {
+    throw std::runtime_error("Profile error: The profile belongs to another program!");
+  }
+
+  std::vector<unsigned long long> counts(program.size());
+  std::size_t index;
+  unsigned long long count;
+
+  while (in >> index >> count) {
+
+    if (index >= counts.size()) {
+      throw std::runtime_error("Profile error: Cannot read the profile!");
+    }
+
+    counts[index] = count;
+  }
+
+  if (!in.eof()) {
+    throw std::runtime_error("Profile error: Cannot read the profile!");
+  }
+
+  return counts;
+}
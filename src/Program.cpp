@@ -0,0 +1,338 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Program.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "Tokeniser.h"
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * This visitor looks up the label an instruction jumps to.
+ */
+class TargetResolver : public InstructionVisitor {
+
+private:
+
+  /**
+   * The labels of the program.
+   */
+  std::map<std::string, int> const& labels_;
+
+
+  /**
+   * The target of the last instruction visited.
+   */
+  int target_;
+
+
+  void resolve(std::string const& label) {
+
+    auto const it = labels_.find(label);
+    target_ = (it != labels_.end()) ? it->second : -1;
+  }
+
+
+public:
+
+  TargetResolver(std::map<std::string, int> const& labels) :
+      labels_(labels), target_(-1) {}
+
+
+  /**
+   * @param instr An instruction.
+   * @returns The index instr jumps to, or -1 if there is none.
+   */
+  int resolve(Instruction& instr) {
+
+    target_ = -1;
+    instr.accept(*this);
+
+    return target_;
+  }
+
+
+  virtual void visit(Push& instr) override {}
+  virtual void visit(Dupl& instr) override {}
+  virtual void visit(Swap& instr) override {}
+  virtual void visit(Discard& instr) override {}
+  virtual void visit(Add& instr) override {}
+  virtual void visit(Sub& instr) override {}
+  virtual void visit(Mul& instr) override {}
+  virtual void visit(Div& instr) override {}
+  virtual void visit(Mod& instr) override {}
+  virtual void visit(Store& instr) override {}
+  virtual void visit(Retrieve& instr) override {}
+  virtual void visit(SetLbl& instr) override {}
+  virtual void visit(CallLbl& instr) override { resolve(instr.get_label()); }
+  virtual void visit(Jump& instr) override { resolve(instr.get_label()); }
+  virtual void visit(JumpZero& instr) override { resolve(instr.get_label()); }
+  virtual void visit(JumpNeg& instr) override { resolve(instr.get_label()); }
+  virtual void visit(Ret& instr) override {}
+  virtual void visit(End& instr) override {}
+  virtual void visit(PrintChar& instr) override {}
+  virtual void visit(PrintInt& instr) override {}
+  virtual void visit(ReadChar& instr) override {}
+  virtual void visit(ReadInt& instr) override {}
+
+};
+
+
+/**
+ * This visitor finds the label an instruction defines or refers to.
+ */
+class LabelFinder : public InstructionVisitor {
+
+private:
+
+  /**
+   * The label of the last instruction visited, or nullptr.
+   */
+  std::string const* label_;
+
+
+public:
+
+  LabelFinder() : label_(nullptr) {}
+
+
+  /**
+   * @param instr An instruction.
+   * @returns The label of instr, or nullptr if it has none.
+   */
+  std::string const* find(Instruction& instr) {
+
+    label_ = nullptr;
+    instr.accept(*this);
+
+    return label_;
+  }
+
+
+  virtual void visit(Push& instr) override {}
+  virtual void visit(Dupl& instr) override {}
+  virtual void visit(Swap& instr) override {}
+  virtual void visit(Discard& instr) override {}
+  virtual void visit(Add& instr) override {}
+  virtual void visit(Sub& instr) override {}
+  virtual void visit(Mul& instr) override {}
+  virtual void visit(Div& instr) override {}
+  virtual void visit(Mod& instr) override {}
+  virtual void visit(Store& instr) override {}
+  virtual void visit(Retrieve& instr) override {}
+  virtual void visit(SetLbl& instr) override { label_ = &instr.get_label(); }
+  virtual void visit(CallLbl& instr) override { label_ = &instr.get_label(); }
+  virtual void visit(Jump& instr) override { label_ = &instr.get_label(); }
+  virtual void visit(JumpZero& instr) override { label_ = &instr.get_label(); }
+  virtual void visit(JumpNeg& instr) override { label_ = &instr.get_label(); }
+  virtual void visit(Ret& instr) override {}
+  virtual void visit(End& instr) override {}
+  virtual void visit(PrintChar& instr) override {}
+  virtual void visit(PrintInt& instr) override {}
+  virtual void visit(ReadChar& instr) override {}
+  virtual void visit(ReadInt& instr) override {}
+
+};
+
+
+/**
+ * This visitor writes instructions as Whitespace.
+ */
+class Encoder : public InstructionVisitor {
+
+private:
+
+  /**
+   * The new name of every label, in spaces and tabs.
+   */
+  std::map<std::string, std::string> const& names_;
+
+
+  std::string& out_;
+
+
+  void number(int const num) {
+
+    out_ += (num < 0) ? '\t' : ' ';
+
+    // The magnitude of INT_MIN does not fit an int.
+    auto magnitude = (num < 0) ? 0u - static_cast<unsigned int>(num)
+                               : static_cast<unsigned int>(num);
+
+    std::string digits;
+
+    for (; magnitude > 0; magnitude >>= 1) {
+      digits += (magnitude & 1) ? '\t' : ' ';
+    }
+
+    out_.append(digits.rbegin(), digits.rend());
+    out_ += '\n';
+  }
+
+
+  void label(std::string const& label) {
+
+    out_ += names_.at(label);
+    out_ += '\n';
+  }
+
+
+public:
+
+  Encoder(std::map<std::string, std::string> const& names, std::string& out) :
+      names_(names), out_(out) {}
+
+
+  virtual void visit(Push& instr) override { out_ += "  "; number(instr.get_num()); }
+  virtual void visit(Dupl& instr) override { out_ += " \n "; }
+  virtual void visit(Swap& instr) override { out_ += " \n\t"; }
+  virtual void visit(Discard& instr) override { out_ += " \n\n"; }
+  virtual void visit(Add& instr) override { out_ += "\t   "; }
+  virtual void visit(Sub& instr) override { out_ += "\t  \t"; }
+  virtual void visit(Mul& instr) override { out_ += "\t  \n"; }
+  virtual void visit(Div& instr) override { out_ += "\t \t "; }
+  virtual void visit(Mod& instr) override { out_ += "\t \t\t"; }
+  virtual void visit(Store& instr) override { out_ += "\t\t "; }
+  virtual void visit(Retrieve& instr) override { out_ += "\t\t\t"; }
+  virtual void visit(SetLbl& instr) override { out_ += "\n  "; label(instr.get_label()); }
+  virtual void visit(CallLbl& instr) override { out_ += "\n \t"; label(instr.get_label()); }
+  virtual void visit(Jump& instr) override { out_ += "\n \n"; label(instr.get_label()); }
+  virtual void visit(JumpZero& instr) override { out_ += "\n\t "; label(instr.get_label()); }
+  virtual void visit(JumpNeg& instr) override { out_ += "\n\t\t"; label(instr.get_label()); }
+  virtual void visit(Ret& instr) override { out_ += "\n\t\n"; }
+  virtual void visit(End& instr) override { out_ += "\n\n\n"; }
+  virtual void visit(PrintChar& instr) override { out_ += "\t\n  "; }
+  virtual void visit(PrintInt& instr) override { out_ += "\t\n \t"; }
+  virtual void visit(ReadChar& instr) override { out_ += "\t\n\t "; }
+  virtual void visit(ReadInt& instr) override { out_ += "\t\n\t\t"; }
+
+};
+
+} // namespace
+
+
+Program::Program(instructions_t const& instructions,
+                 std::map<std::string, int> const& labels) :
+    instructions_(instructions), labels_(labels) {
+
+  TargetResolver resolver(labels_);
+
+  targets_.reserve(instructions_.size());
+  code_.reserve(instructions_.size());
+
+  for (auto const& instr : instructions_) {
+
+    targets_.emplace_back(resolver.resolve(*instr));
+    code_.emplace_back(instr.get());
+  }
+}
+
+
+std::uint64_t whitepp::fingerprint(Program const& program) {
+
+  std::uint64_t hash = 14695981039346656037ull;
+
+  for (auto const& instr : program.get_instructions()) {
+    for (char const c : instr->to_str() + '\n') {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 1099511628211ull;
+    }
+  }
+
+  return hash;
+}
+
+
+void whitepp::minify(Program const& program, std::ostream& out) {
+
+  auto const& instructions = program.get_instructions();
+
+  // Count the uses of every label, in the order of their first use.
+  std::vector<std::pair<std::string, std::size_t>> uses;
+  std::map<std::string, std::size_t> first_use;
+  LabelFinder finder;
+
+  for (auto const& instr : instructions) {
+
+    auto const label = finder.find(*instr);
+
+    if (label != nullptr) {
+
+      auto const it = first_use.emplace(*label, uses.size()).first;
+
+      if (it->second == uses.size()) {
+        uses.emplace_back(*label, 0);
+      }
+
+      ++uses[it->second].second;
+    }
+  }
+
+  std::stable_sort(uses.begin(), uses.end(),
+                   [](std::pair<std::string, std::size_t> const& a,
+                      std::pair<std::string, std::size_t> const& b) {
+                     return a.second > b.second;
+                   });
+
+  // Label n is named by the binary digits of n + 2 but the leading one, so
+  // there are two names of one character, four of two, and so on.
+  std::map<std::string, std::string> names;
+
+  for (std::size_t n = 0; n < uses.size(); ++n) {
+
+    std::string name;
+
+    for (auto m = n + 2; m > 1; m >>= 1) {
+      name += (m & 1) ? '\t' : ' ';
+    }
+
+    names.emplace(uses[n].first, std::string(name.rbegin(), name.rend()));
+  }
+
+  std::string code;
+  Encoder encoder(names, code);
+
+  for (auto const& instr : instructions) {
+    instr->accept(encoder);
+  }
+
+  out << code;
+}
+
+
+std::shared_ptr<Program const> whitepp::parse_program(std::istream& in) {
+
+  Tokeniser tokeniser;
+  tokeniser.tokenise(in);
+
+  auto tokens = tokeniser.get_tokens();
+
+  Parser parser;
+  parser.parse(tokens);
+
+  return std::make_shared<Program const>(parser.get_instructions(),
+                                         parser.get_labels());
+}
+
+
+std::shared_ptr<Program const> whitepp::load_program(std::string const& file) {
+
+  std::ifstream filestream(file);
+
+  if (!filestream) {
+    throw std::runtime_error("Cannot open " + file + ".");
+  }
+
+  return parse_program(filestream);
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "ProgramCache.h"
+
+#include <iterator>
+#include <sstream>
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * @param str A string.
+ * @returns The 64-bit FNV-1a hash of str.
+ */
+std::uint64_t fnv1a(std::string const& str) {
+
+  std::uint64_t hash = 14695981039346656037ull;
+
+  for (unsigned char const c : str) {
+
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+
+  return hash;
+}
+
+} // namespace
+
+
+std::pair<std::shared_ptr<Program const>, bool> ProgramCache::get(std::string const& source) {
+
+  auto const hash = fnv1a(source);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto const range = index_.equal_range(hash);
+
+    for (auto it = range.first; it != range.second; ++it) {
+
+      if (it->second->source == source) {
+
+        // Move the entry to the front.
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return std::make_pair(entries_.front().program, true);
+      }
+    }
+  }
+
+  std::istringstream in(source);
+  auto const program = parse_program(in);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Another thread may have added the program meanwhile; a duplicate is
+  // harmless and evicted eventually.
+  entries_.push_front(Entry{hash, source, program});
+  index_.emplace(hash, entries_.begin());
+
+  while (entries_.size() > capacity_) {
+
+    auto const last = std::prev(entries_.end());
+    auto const range = index_.equal_range(last->hash);
+
+    for (auto it = range.first; it != range.second; ++it) {
+
+      if (it->second == last) {
+
+        index_.erase(it);
+        break;
+      }
+    }
+
+    entries_.pop_back();
+  }
+
+  return std::make_pair(program, false);
+}
+
+
+std::size_t ProgramCache::size() {
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
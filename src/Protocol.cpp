@@ -0,0 +1,338 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Protocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace whitepp;
+using namespace whitepp::protocol;
+
+
+namespace {
+
+/**
+ * The number of bytes a string grows by while it is received.
+ */
+std::size_t const chunk_size = 1 << 16;
+
+
+/**
+ * Send all bytes, without raising SIGPIPE if the peer is gone.
+ */
+void send_all(int const fd, std::string const& data) {
+
+  char const* p = data.data();
+  std::size_t size = data.size();
+
+  while (size > 0) {
+
+    auto const sent = ::send(fd, p, size, MSG_NOSIGNAL);
+
+    if (sent < 0) {
+
+      if (errno == EINTR) {
+        continue;
+      }
+
+      throw std::runtime_error(std::string("Connection error: ") + std::strerror(errno));
+    }
+
+    p += sent;
+    size -= sent;
+  }
+}
+
+
+/**
+ * Receive exactly size bytes.
+ *
+ * @returns false if the peer closed the connection before the first byte.
+ */
+bool receive_all(int const fd, char* p, std::size_t size) {
+
+  std::size_t received = 0;
+
+  while (received < size) {
+
+    auto const n = ::recv(fd, p + received, size - received, 0);
+
+    if (n < 0) {
+
+      if (errno == EINTR) {
+        continue;
+      }
+
+      throw std::runtime_error(std::string("Connection error: ") + std::strerror(errno));
+    }
+
+    if (n == 0) {
+
+      if (received == 0) {
+        return false;
+      }
+
+      throw std::runtime_error("Connection error: Message truncated!");
+    }
+
+    received += n;
+  }
+
+  return true;
+}
+
+
+/**
+ * This class builds a message.
+ */
+class Writer {
+
+private:
+
+  std::string data_;
+
+
+public:
+
+  void put_u8(std::uint8_t const v) {
+    data_ += static_cast<char>(v);
+  }
+
+
+  void put_u32(std::uint32_t const v) {
+
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      data_ += static_cast<char>((v >> shift) & 0xff);
+    }
+  }
+
+
+  void put_u64(std::uint64_t const v) {
+
+    put_u32(static_cast<std::uint32_t>(v >> 32));
+    put_u32(static_cast<std::uint32_t>(v));
+  }
+
+
+  void put_str(std::string const& str) {
+
+    if (str.size() > max_length) {
+      throw std::runtime_error("Connection error: Message too long!");
+    }
+
+    put_u32(static_cast<std::uint32_t>(str.size()));
+    data_ += str;
+  }
+
+
+  std::string const& get_data() const {
+    return data_;
+  }
+
+};
+
+
+/**
+ * This class reads the fields of a message from a socket.
+ */
+class Reader {
+
+private:
+
+  int fd_;
+
+
+public:
+
+  Reader(int const fd) : fd_(fd) {}
+
+
+  std::uint8_t get_u8() {
+
+    char c;
+    if (!receive_all(fd_, &c, 1)) {
+      throw std::runtime_error("Connection error: Message truncated!");
+    }
+
+    return static_cast<unsigned char>(c);
+  }
+
+
+  /**
+   * @returns false if the peer closed the connection before the integer.
+   */
+  bool try_u32(std::uint32_t& v) {
+
+    unsigned char bytes[4];
+    if (!receive_all(fd_, reinterpret_cast<char*>(bytes), sizeof(bytes))) {
+      return false;
+    }
+
+    v = (static_cast<std::uint32_t>(bytes[0]) << 24) |
+        (static_cast<std::uint32_t>(bytes[1]) << 16) |
+        (static_cast<std::uint32_t>(bytes[2]) << 8) |
+        static_cast<std::uint32_t>(bytes[3]);
+
+    return true;
+  }
+
+
+  std::uint32_t get_u32() {
+
+    std::uint32_t v;
+    if (!try_u32(v)) {
+      throw std::runtime_error("Connection error: Message truncated!");
+    }
+
+    return v;
+  }
+
+
+  std::uint64_t get_u64() {
+
+    std::uint64_t const high = get_u32();
+    return (high << 32) | get_u32();
+  }
+
+
+  void get_str(std::string& str) {
+    get_str(str, get_u32());
+  }
+
+
+  /**
+   * @param str Receives the string.
+   * @param size The length of the string, read already.
+   */
+  void get_str(std::string& str, std::uint32_t const size) {
+
+    if (size > max_length) {
+      throw std::runtime_error("Connection error: Message too long!");
+    }
+
+    // Grow the string as the bytes arrive, so a peer cannot make us allocate
+    // more memory than it sends.
+    str.clear();
+
+    while (str.size() < size) {
+
+      auto const begin = str.size();
+      auto const chunk = std::min<std::size_t>(size - begin, chunk_size);
+
+      str.resize(begin + chunk);
+
+      if (!receive_all(fd_, &str[begin], chunk)) {
+        throw std::runtime_error("Connection error: Message truncated!");
+      }
+    }
+  }
+
+};
+
+} // namespace
+
+
+void protocol::write_request(int const fd, Request const& request) {
+
+  Writer writer;
+  writer.put_str(request.program);
+  writer.put_str(request.input);
+  writer.put_u64(request.max_steps);
+  writer.put_u32(request.timeout_ms);
+
+  send_all(fd, writer.get_data());
+}
+
+
+bool protocol::read_request(int const fd, Request& request) {
+
+  Reader reader(fd);
+
+  // The length of the program tells whether the client closed the
+  // connection.
+  std::uint32_t size;
+  if (!reader.try_u32(size)) {
+    return false;
+  }
+
+  reader.get_str(request.program, size);
+  reader.get_str(request.input);
+  request.max_steps = reader.get_u64();
+  request.timeout_ms = reader.get_u32();
+
+  return true;
+}
+
+
+void protocol::write_response(int const fd, Response const& response) {
+
+  Writer writer;
+  writer.put_u8(static_cast<std::uint8_t>(response.status));
+  writer.put_u8(response.cached ? 1 : 0);
+  writer.put_u64(response.steps);
+  writer.put_u64(response.time_us);
+  writer.put_str(response.output);
+  writer.put_str(response.error);
+
+  send_all(fd, writer.get_data());
+}
+
+
+void protocol::read_response(int const fd, Response& response) {
+
+  Reader reader(fd);
+
+  auto const status = reader.get_u8();
+
+  if (status > static_cast<std::uint8_t>(Status::Deadline)) {
+    throw std::runtime_error("Connection error: Unknown status!");
+  }
+
+  response.status = static_cast<Status>(status);
+  response.cached = reader.get_u8() != 0;
+  response.steps = reader.get_u64();
+  response.time_us = reader.get_u64();
+  reader.get_str(response.output);
+  reader.get_str(response.error);
+}
+
+
+int protocol::connect_to(std::string const& path) {
+
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path too long: " + path);
+  }
+
+  std::strcpy(address.sun_path, path.c_str());
+
+  int const fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (fd < 0) {
+    throw std::runtime_error(std::string("Connection error: ") + std::strerror(errno));
+  }
+
+  if (::connect(fd, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) < 0) {
+
+    auto const error = errno;
+    ::close(fd);
+
+    throw std::runtime_error("Cannot connect to " + path + ": " + std::strerror(error));
+  }
+
+  return fd;
+}
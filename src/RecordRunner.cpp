@@ -0,0 +1,122 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "RecordRunner.h"
+
+#include <stdexcept>
+
+#include "VirtualMachine.h"
+
+using namespace whitepp;
+
+
+RecordRunner::RecordRunner(std::shared_ptr<Program const> const& program,
+                           WorkStealingPool& pool, std::size_t const window,
+                           unsigned long long const max_steps) :
+    program_(program), pool_(pool), slots_(window > 0 ? window : 1),
+    max_steps_(max_steps) {}
+
+
+void RecordRunner::run_record(Slot& slot) {
+
+  MemoryInputSource source(slot.input.data(), slot.input.size());
+  StringOutputSink sink;
+
+  VirtualMachine vm(program_);
+  vm.set_input(source);
+  vm.set_output(sink);
+
+  try {
+
+    vm.run(max_steps_);
+    slot.output = sink.get_str();
+
+  } catch (std::runtime_error const& e) {
+
+    slot.error = e.what();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slot.done = true;
+  }
+
+  done_cv_.notify_all();
+}
+
+
+std::size_t RecordRunner::run(InputSource& in, char const delimiter,
+                              OutputSink& out, std::ostream& errors) {
+
+  auto const window = slots_.size();
+
+  // Records [written, read) are in flight.
+  std::size_t read = 0;
+  std::size_t written = 0;
+  std::size_t failures = 0;
+
+  // The slots must outlive the records in flight, even on errors.
+  try {
+
+    bool more = true;
+
+    for (;;) {
+
+      while (more && read - written < window) {
+
+        auto& slot = slots_[read % window];
+
+        if (!in.get_record(slot.input, delimiter)) {
+
+          more = false;
+          break;
+        }
+
+        slot.output.clear();
+        slot.error.clear();
+        slot.done = false;
+
+        auto* const s = &slot;
+        pool_.submit([this, s]() { run_record(*s); });
+
+        ++read;
+      }
+
+      if (written == read) {
+        break;
+      }
+
+      auto& slot = slots_[written % window];
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [&slot]() { return slot.done; });
+      }
+
+      if (slot.error.empty()) {
+
+        out.put_str(slot.output);
+
+      } else {
+
+        errors << "Record " << (written + 1) << ": " << slot.error << std::endl;
+        ++failures;
+      }
+
+      ++written;
+    }
+
+  } catch (...) {
+
+    pool_.wait();
+    throw;
+  }
+
+  out.flush();
+
+  return failures;
+}
@@ -0,0 +1,451 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Recording.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "Program.h"
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * The first line of every recording.
+ */
+char const recording_header[] = "White++ recording";
+
+
+/**
+ * The version of the recording format.
+ */
+unsigned int const recording_version = 1;
+
+
+/**
+ * This class reads the entries of a recording from memory.
+ */
+class Cursor {
+
+private:
+
+  std::string const& text_;
+
+
+  std::size_t pos_;
+
+
+  /**
+   * @throws std::runtime_error always.
+   */
+  [[noreturn]] static void fail() {
+    throw std::runtime_error("Replay error: Cannot read the recording!");
+  }
+
+
+  /**
+   * Parse a number with strtoull() or strtoll(), which must be followed by a
+   * space or newline.
+   */
+  template <typename T>
+  T parse(T (*convert)(char const*, char**, int), int const base) {
+
+    char const* const begin = text_.c_str() + pos_;
+    char* end;
+
+    errno = 0;
+    auto const value = convert(begin, &end, base);
+
+    if (end == begin || errno != 0 || (*end != ' ' && *end != '\n')) {
+      fail();
+    }
+
+    pos_ += end - begin + 1;
+
+    return value;
+  }
+
+
+public:
+
+  Cursor(std::string const& text) : text_(text), pos_(0) {}
+
+
+  /**
+   * @returns false at the end of the text.
+   */
+  bool at_end() const {
+    return pos_ == text_.size();
+  }
+
+
+  /**
+   * Skip a keyword and the space following it.
+   *
+   * @param keyword The keyword.
+   * @returns false if the text does not continue with the keyword.
+   */
+  bool skip(char const* const keyword) {
+
+    auto const size = std::strlen(keyword);
+
+    if (text_.compare(pos_, size, keyword) != 0 || text_.size() - pos_ <= size ||
+        text_[pos_ + size] != ' ') {
+      return false;
+    }
+
+    pos_ += size + 1;
+
+    return true;
+  }
+
+
+  /**
+   * @param base The base of the number.
+   * @returns The number up to the next space or newline.
+   */
+  unsigned long long number(int const base = 10) {
+    return parse(std::strtoull, base);
+  }
+
+
+  /**
+   * @returns The integer up to the next space or newline.
+   */
+  int integer() {
+
+    auto const value = parse(std::strtoll, 10);
+
+    if (value < INT_MIN || value > INT_MAX) {
+      fail();
+    }
+
+    return value;
+  }
+
+
+  /**
+   * @returns The characters up to the next newline, which is skipped.
+   */
+  std::string line() {
+
+    auto const end = text_.find('\n', pos_);
+
+    if (end == std::string::npos) {
+      fail();
+    }
+
+    auto const line = text_.substr(pos_, end - pos_);
+    pos_ = end + 1;
+
+    return line;
+  }
+
+
+  /**
+   * @returns The raw bytes following "input SIZE" or "output SIZE".
+   */
+  std::string bytes() {
+
+    auto const size = number();
+
+    if (size >= text_.size() - pos_ ||
+        text_[pos_ + size] != '\n') {
+      throw std::runtime_error("Replay error: The recording is truncated!");
+    }
+
+    auto const bytes = text_.substr(pos_, size);
+    pos_ += size + 1;
+
+    return bytes;
+  }
+
+};
+
+
+/**
+ * @returns A read as text.
+ */
+std::string describe(Recording::Read const& read) {
+
+  std::string value;
+
+  if (read.is_int) {
+    value = "the integer " + std::to_string(read.value);
+  } else if (read.value == InputSource::eof) {
+    value = "the end of the input";
+  } else {
+    value = "the character " + std::to_string(read.value);
+  }
+
+  return value + " after " + std::to_string(read.steps) + " instructions";
+}
+
+
+/**
+ * @returns An error as text.
+ */
+std::string describe(std::string const& error) {
+  return error.empty() ? "no error" : "\"" + error + "\"";
+}
+
+} // namespace
+
+
+void Recording::write(std::ostream& out) const {
+
+  out << recording_header << ' ' << recording_version << '\n'
+      << "program " << std::hex << program << std::dec << '\n';
+
+  for (auto const& read : reads) {
+    out << (read.is_int ? "int " : "char ") << read.steps << ' ' << read.value << '\n';
+  }
+
+  out << "steps " << steps << '\n';
+
+  if (!error.empty()) {
+    out << "error " << error << '\n';
+  }
+
+  out << "input " << input.size() << '\n' << input << '\n'
+      << "output " << output.size() << '\n' << output << '\n';
+}
+
+
+void Recording::read(std::istream& in) {
+
+  std::string text;
+  char chunk[1 << 16];
+
+  while (in.read(chunk, sizeof(chunk)) || in.gcount() > 0) {
+    text.append(chunk, in.gcount());
+  }
+
+  Cursor cursor(text);
+
+  if (text.compare(0, text.find('\n'),
+                   recording_header + (' ' + std::to_string(recording_version))) != 0) {
+    throw std::runtime_error("Replay error: Not a recording of this version!");
+  }
+
+  cursor.line();
+
+  reads.clear();
+  error.clear();
+
+  while (!cursor.at_end()) {
+
+    // Reads are by far the most frequent entries.
+    auto const is_int = cursor.skip("int");
+
+    if (is_int || cursor.skip("char")) {
+
+      Read read;
+      read.is_int = is_int;
+      read.steps = cursor.number();
+      read.value = cursor.integer();
+
+      reads.emplace_back(read);
+
+    } else if (cursor.skip("program")) {
+
+      program = cursor.number(16);
+
+    } else if (cursor.skip("steps")) {
+
+      steps = cursor.number();
+
+    } else if (cursor.skip("error")) {
+
+      error = cursor.line();
+
+    } else if (cursor.skip("input")) {
+
+      input = cursor.bytes();
+
+    } else if (cursor.skip("output")) {
+
+      output = cursor.bytes();
+      return;
+
+    } else {
+      throw std::runtime_error("Replay error: Unknown entry " + cursor.line() +
+                               " in the recording!");
+    }
+  }
+
+  throw std::runtime_error("Replay error: The recording is truncated!");
+}
+
+
+Recorder::Recorder(VirtualMachine& vm, Recording& recording, Mode const mode, InputSource& in,
+                   OutputSink& out) :
+    vm_(vm), recording_(recording), mode_(mode), steps_(vm.get_steps()), read_count_(0),
+    address_(0), pending_(false), failed_(false), original_in_(&in),
+    out_([this, &out](char const* data, std::size_t size) {
+
+      output_.append(data, size);
+
+      out.put_str(std::string(data, size));
+      out.flush();
+
+    }, out.get_mode()) {
+
+  auto const& program = *vm_.get_program();
+
+  if (mode_ == Mode::Record) {
+
+    recording_ = Recording();
+    recording_.program = fingerprint(program);
+
+    // The input is read as the program needs it, so interactive programs
+    // work, and kept.
+    in_.reset(new CallbackInputSource([this](char* buffer, std::size_t size) {
+
+      auto const count = original_in_->get_block(buffer, size);
+      recording_.input.append(buffer, count);
+
+      return count;
+    }));
+
+    in_->tie(&out_);
+
+  } else {
+
+    if (recording_.program != fingerprint(program)) {
+      throw std::runtime_error("Replay error: The recording belongs to another program!");
+    }
+
+    in_.reset(new StringInputSource(recording_.input));
+  }
+
+  vm_.set_input(*in_);
+  vm_.set_output(out_);
+
+  for (auto const& instr : program.get_instructions()) {
+
+    if (dynamic_cast<ReadChar const*>(instr.get()) != nullptr) {
+      reads_.emplace_back(1);
+    } else if (dynamic_cast<ReadInt const*>(instr.get()) != nullptr) {
+      reads_.emplace_back(2);
+    } else {
+      reads_.emplace_back(0);
+    }
+  }
+
+  // The end of the program.
+  reads_.emplace_back(0);
+
+  prepare(vm_.get_program_counter());
+}
+
+
+void Recorder::prepare(unsigned int const next) {
+
+  // Without an address, the instruction fails.
+  pending_ = (next < reads_.size() && reads_[next] != 0 &&
+              vm_.get_stack().peek(address_));
+}
+
+
+void Recorder::track(unsigned int const index, unsigned int const next) {
+
+  if (pending_) {
+
+    Recording::Read read;
+    read.steps = steps_;
+    read.is_int = (reads_[index] == 2);
+    read.value = vm_.get_heap().get(address_);
+
+    if (mode_ == Mode::Record) {
+
+      recording_.reads.emplace_back(read);
+
+    } else {
+
+      if (read_count_ == recording_.reads.size()) {
+
+        failed_ = true;
+        throw std::runtime_error("Replay error: The program reads more often than recorded!");
+      }
+
+      auto const& expected = recording_.reads[read_count_];
+
+      if (read.steps != expected.steps || read.is_int != expected.is_int ||
+          read.value != expected.value) {
+
+        failed_ = true;
+        throw std::runtime_error("Replay error: Read " + std::to_string(read_count_ + 1) +
+                                 " got " + describe(read) + " instead of " +
+                                 describe(expected) + "!");
+      }
+    }
+
+    ++read_count_;
+  }
+
+  prepare(next);
+}
+
+
+std::string Recorder::finish(std::string const& error) {
+
+  out_.flush();
+
+  if (mode_ == Mode::Record) {
+
+    recording_.steps = steps_;
+    recording_.error = error;
+    recording_.output = output_;
+
+    // The input source may have read ahead.
+    recording_.input.resize(in_->get_bytes_read());
+
+    return "";
+  }
+
+  // The difference was reported already.
+  if (failed_) {
+    return "";
+  }
+
+  if (read_count_ != recording_.reads.size()) {
+    return "Replay error: The program read " + std::to_string(read_count_) +
+           " times instead of " + std::to_string(recording_.reads.size()) + "!";
+  }
+
+  if (steps_ != recording_.steps) {
+    return "Replay error: The program performed " + std::to_string(steps_) +
+           " instructions instead of " + std::to_string(recording_.steps) + "!";
+  }
+
+  if (error != recording_.error) {
+    return "Replay error: The program ended with " + describe(error) + " instead of " +
+           describe(recording_.error) + "!";
+  }
+
+  if (output_ != recording_.output) {
+
+    std::size_t offset = 0;
+
+    while (offset < output_.size() && offset < recording_.output.size() &&
+           output_[offset] == recording_.output[offset]) {
+      ++offset;
+    }
+
+    return "Replay error: The output differs from the recording from byte " +
+           std::to_string(offset) + " on!";
+  }
+
+  return "";
+}
@@ -0,0 +1,877 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "RegisterEngine.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * The maximal number of instructions of a unit, which bounds the registers
+ * it needs.
+ */
+unsigned int const max_unit_length = 256;
+
+
+/**
+ * The maximal number of values a unit keeps in registers.  Beyond it, the
+ * lists of the registers on the stack when an operation fails grow too long.
+ */
+std::size_t const max_unit_depth = 64;
+
+
+/**
+ * While translating, registers are numbered by kind: the values consumed
+ * from the stack, the results of operations, and the constants.
+ */
+unsigned int const input_tag = 0u << 30;
+unsigned int const result_tag = 1u << 30;
+unsigned int const constant_tag = 2u << 30;
+unsigned int const tag_mask = 3u << 30;
+
+
+// The arithmetic wraps around, like in VirtualMachine.
+
+int add(int const x, int const y) {
+  return static_cast<int>(static_cast<unsigned int>(x) + static_cast<unsigned int>(y));
+}
+
+
+int subtract(int const x, int const y) {
+  return static_cast<int>(static_cast<unsigned int>(x) - static_cast<unsigned int>(y));
+}
+
+
+int multiply(int const x, int const y) {
+  return static_cast<int>(static_cast<unsigned int>(x) * static_cast<unsigned int>(y));
+}
+
+
+/**
+ * @param y Not 0.
+ */
+int divide(int const x, int const y) {
+  return (y != -1) ? x / y : static_cast<int>(0u - static_cast<unsigned int>(x));
+}
+
+
+/**
+ * @param y Not 0.
+ */
+int modulo(int const x, int const y) {
+  return (y != -1) ? x % y : 0;
+}
+
+
+/**
+ * @throws std::runtime_error always.
+ */
+[[noreturn]] void underflow() {
+  throw std::runtime_error("Runtime error: Stack underflow!");
+}
+
+} // namespace
+
+
+RegisterEngine::RegisterEngine(std::shared_ptr<Program const> const& program,
+                               InputSource& in, OutputSink& out) :
+    program_(program), in_(in), out_(out), program_counter_(0), steps_(0) {
+
+  auto const& instructions = program->get_instructions();
+
+  for (std::size_t i = 0; i < instructions.size(); ++i) {
+
+    auto const instr = instructions[i].get();
+
+    Instr decoded{ Kind::Label, 0, program->get_target(i) };
+
+    if (auto const push = dynamic_cast<Push const*>(instr)) {
+      decoded.kind = Kind::Push;
+      decoded.num = push->get_num();
+    } else if (dynamic_cast<Dupl const*>(instr) != nullptr) {
+      decoded.kind = Kind::Dupl;
+    } else if (dynamic_cast<Swap const*>(instr) != nullptr) {
+      decoded.kind = Kind::Swap;
+    } else if (dynamic_cast<Discard const*>(instr) != nullptr) {
+      decoded.kind = Kind::Discard;
+    } else if (dynamic_cast<Add const*>(instr) != nullptr) {
+      decoded.kind = Kind::Add;
+    } else if (dynamic_cast<Sub const*>(instr) != nullptr) {
+      decoded.kind = Kind::Sub;
+    } else if (dynamic_cast<Mul const*>(instr) != nullptr) {
+      decoded.kind = Kind::Mul;
+    } else if (dynamic_cast<Div const*>(instr) != nullptr) {
+      decoded.kind = Kind::Div;
+    } else if (dynamic_cast<Mod const*>(instr) != nullptr) {
+      decoded.kind = Kind::Mod;
+    } else if (dynamic_cast<Store const*>(instr) != nullptr) {
+      decoded.kind = Kind::Store;
+    } else if (dynamic_cast<Retrieve const*>(instr) != nullptr) {
+      decoded.kind = Kind::Retrieve;
+    } else if (dynamic_cast<CallLbl const*>(instr) != nullptr) {
+      decoded.kind = Kind::Call;
+    } else if (dynamic_cast<Jump const*>(instr) != nullptr) {
+      decoded.kind = Kind::Jump;
+    } else if (dynamic_cast<JumpZero const*>(instr) != nullptr) {
+      decoded.kind = Kind::JumpZero;
+    } else if (dynamic_cast<JumpNeg const*>(instr) != nullptr) {
+      decoded.kind = Kind::JumpNeg;
+    } else if (dynamic_cast<Ret const*>(instr) != nullptr) {
+      decoded.kind = Kind::Ret;
+    } else if (dynamic_cast<End const*>(instr) != nullptr) {
+      decoded.kind = Kind::End;
+    } else if (dynamic_cast<PrintChar const*>(instr) != nullptr) {
+      decoded.kind = Kind::PrintChar;
+    } else if (dynamic_cast<PrintInt const*>(instr) != nullptr) {
+      decoded.kind = Kind::PrintInt;
+    } else if (dynamic_cast<ReadChar const*>(instr) != nullptr) {
+      decoded.kind = Kind::ReadChar;
+    } else if (dynamic_cast<ReadInt const*>(instr) != nullptr) {
+      decoded.kind = Kind::ReadInt;
+    }
+
+    instrs_.emplace_back(decoded);
+  }
+
+  translate();
+}
+
+
+void RegisterEngine::translate() {
+
+  auto const size = instrs_.size();
+
+  // A basic block starts at the beginning, at labels and jump targets, and
+  // after instructions that do not continue with the next one.
+  std::vector<bool> leaders(size + 1, false);
+  leaders[0] = true;
+  leaders[size] = true;
+
+  for (std::size_t i = 0; i < size; ++i) {
+
+    auto const kind = instrs_[i].kind;
+
+    if (kind == Kind::Label) {
+      leaders[i] = true;
+    }
+
+    if (instrs_[i].target >= 0) {
+      leaders[instrs_[i].target] = true;
+    }
+
+    if (kind == Kind::Call || kind == Kind::Jump || kind == Kind::JumpZero ||
+        kind == Kind::JumpNeg || kind == Kind::Ret || kind == Kind::End) {
+      leaders[i + 1] = true;
+    }
+  }
+
+  unit_at_.assign(size, -1);
+
+  std::map<int, unsigned int> constants;
+  std::vector<int> values;
+  unsigned int frame = 0;
+
+  for (unsigned int begin = 0, limit = 0; begin < size; begin = units_.back().end) {
+
+    if (limit <= begin) {
+      for (limit = begin + 1; !leaders[limit]; ++limit) {}
+    }
+
+    unit_at_[begin] = units_.size();
+    frame = std::max(frame, translate_unit(begin, limit, constants, values));
+  }
+
+  // The constants follow the registers of the units.
+  auto const place = [frame](unsigned int& reg) {
+    if ((reg & tag_mask) == constant_tag) {
+      reg = frame + (reg & ~tag_mask);
+    }
+  };
+
+  for (auto& op : code_) {
+
+    place(op.d);
+    place(op.a);
+    place(op.b);
+  }
+
+  for (auto& slot : slots_) {
+    place(slot);
+  }
+
+  for (auto& unit : units_) {
+    place(unit.condition);
+  }
+
+  registers_.resize(frame);
+  registers_.insert(registers_.end(), values.begin(), values.end());
+}
+
+
+unsigned int RegisterEngine::translate_unit(unsigned int const begin, unsigned int const limit,
+                                            std::map<int, unsigned int>& constants,
+                                            std::vector<int>& values) {
+
+  Unit unit{ begin, begin, code_.size(), code_.size(), 0, 0, 0, 0, Kind::Label, 0, -1, false };
+
+  // The registers on the stack.
+  std::vector<unsigned int> stack;
+  unsigned int results = 0;
+
+  auto pop = [&]() {
+
+    if (stack.empty()) {
+      return input_tag | unit.inputs++;
+    }
+
+    auto const reg = stack.back();
+    stack.pop_back();
+
+    return reg;
+  };
+
+  auto is_constant = [](unsigned int const reg) {
+    return (reg & tag_mask) == constant_tag;
+  };
+
+  auto value_of = [&values](unsigned int const reg) {
+    return values[reg & ~tag_mask];
+  };
+
+  auto constant = [&](int const value) {
+
+    auto const it = constants.emplace(value, values.size());
+    if (it.second) {
+      values.emplace_back(value);
+    }
+
+    return constant_tag | it.first->second;
+  };
+
+  auto const first_failure = failures_.size();
+
+  // Note what the stack holds if the next operation fails.
+  auto may_fail = [&](unsigned int const index) {
+
+    failures_.emplace_back(Failure{ index, unit.inputs, slots_.size(), stack.size() });
+    slots_.insert(slots_.end(), stack.begin(), stack.end());
+
+    return failures_.size() - 1;
+  };
+
+  // Add an operation, and its result to the stack.
+  auto emit_result = [&](Kind const kind, unsigned int const a, unsigned int const b,
+                         std::size_t const failure) {
+
+    code_.emplace_back(Op{ kind, result_tag | results, a, b, static_cast<unsigned int>(failure) });
+    stack.emplace_back(result_tag | results++);
+  };
+
+  auto emit = [&](Kind const kind, unsigned int const a, unsigned int const b,
+                  std::size_t const failure) {
+    code_.emplace_back(Op{ kind, a, a, b, static_cast<unsigned int>(failure) });
+  };
+
+  auto& i = unit.end;
+
+  for (; i < limit; ++i) {
+
+    if (i > begin && (stack.size() >= max_unit_depth || i - begin >= max_unit_length)) {
+      break;
+    }
+
+    auto const& instr = instrs_[i];
+
+    switch (instr.kind) {
+
+      case Kind::Push:
+
+        stack.emplace_back(constant(instr.num));
+        break;
+
+      case Kind::Dupl: {
+
+        auto const reg = pop();
+        stack.emplace_back(reg);
+        stack.emplace_back(reg);
+        break;
+      }
+
+      case Kind::Swap: {
+
+        auto const y = pop();
+        auto const x = pop();
+        stack.emplace_back(y);
+        stack.emplace_back(x);
+        break;
+      }
+
+      case Kind::Discard:
+
+        pop();
+        break;
+
+      case Kind::Add:
+      case Kind::Sub:
+      case Kind::Mul:
+      case Kind::Div:
+      case Kind::Mod: {
+
+        auto const y = pop();
+        auto const x = pop();
+
+        auto const divides = (instr.kind == Kind::Div || instr.kind == Kind::Mod);
+
+        if (is_constant(x) && is_constant(y) && !(divides && value_of(y) == 0)) {
+
+          auto const a = value_of(x);
+          auto const b = value_of(y);
+
+          switch (instr.kind) {
+            case Kind::Add: stack.emplace_back(constant(add(a, b))); break;
+            case Kind::Sub: stack.emplace_back(constant(subtract(a, b))); break;
+            case Kind::Mul: stack.emplace_back(constant(multiply(a, b))); break;
+            case Kind::Div: stack.emplace_back(constant(divide(a, b))); break;
+            default:        stack.emplace_back(constant(modulo(a, b))); break;
+          }
+
+          break;
+        }
+
+        // Both operands are gone when a division by zero fails.
+        emit_result(instr.kind, x, y, divides ? may_fail(i) : 0);
+        break;
+      }
+
+      case Kind::Store: {
+
+        auto const value = pop();
+        auto const address = pop();
+        emit(Kind::Store, address, value, 0);
+        break;
+      }
+
+      case Kind::Retrieve:
+
+        emit_result(Kind::Retrieve, pop(), 0, 0);
+        break;
+
+      case Kind::Label:
+
+        break;
+
+      case Kind::JumpZero:
+      case Kind::JumpNeg:
+
+        unit.condition = pop();
+
+        // Fall through.
+
+      case Kind::Call:
+      case Kind::Jump:
+
+        unit.exit = instr.kind;
+        unit.target = instr.target;
+        unit.slow = (instr.target < 0);
+        break;
+
+      case Kind::Ret:
+      case Kind::End:
+
+        unit.exit = instr.kind;
+        break;
+
+      case Kind::PrintChar:
+      case Kind::PrintInt:
+      case Kind::ReadChar:
+      case Kind::ReadInt: {
+
+        // The operand is still on the stack when input or output fails.
+        auto const operand = pop();
+        stack.emplace_back(operand);
+        auto const failure = may_fail(i);
+        stack.pop_back();
+
+        emit(instr.kind, operand, 0, failure);
+        break;
+      }
+    }
+
+    if (unit.exit != Kind::Label) {
+
+      ++i;
+      break;
+    }
+  }
+
+  // The values consumed are loaded into the registers from 0 on, the
+  // deepest one first, and the results follow.
+  auto const inputs = unit.inputs;
+
+  auto const allocate = [inputs](unsigned int& reg) {
+
+    if ((reg & tag_mask) == input_tag) {
+      reg = inputs - 1 - reg;
+    } else if ((reg & tag_mask) == result_tag) {
+      reg = inputs + (reg & ~tag_mask);
+    }
+  };
+
+  unit.ops_end = code_.size();
+
+  for (auto op = code_.begin() + unit.ops_begin; op != code_.end(); ++op) {
+
+    allocate(op->d);
+    allocate(op->a);
+    allocate(op->b);
+  }
+
+  for (auto failure = failures_.begin() + first_failure; failure != failures_.end(); ++failure) {
+    std::for_each(slots_.begin() + failure->begin, slots_.begin() + failure->begin + failure->size,
+                  allocate);
+  }
+
+  allocate(unit.condition);
+
+  // The values left as they were need not be written back.
+  while (unit.keep < stack.size() && unit.keep < inputs &&
+         stack[unit.keep] == (input_tag | (inputs - 1 - unit.keep))) {
+    ++unit.keep;
+  }
+
+  unit.spill_begin = slots_.size();
+  unit.spill_size = stack.size() - unit.keep;
+
+  for (auto it = stack.begin() + unit.keep; it != stack.end(); ++it) {
+
+    auto reg = *it;
+    allocate(reg);
+    slots_.emplace_back(reg);
+  }
+
+  units_.emplace_back(unit);
+
+  return inputs + results;
+}
+
+
+void RegisterEngine::run_unit(Unit const& unit, std::vector<int>& written) {
+
+  auto const regs = registers_.data();
+  auto const base = stack_.size() - unit.inputs;
+
+  std::copy(stack_.begin() + base, stack_.end(), regs);
+
+  auto op = code_.data() + unit.ops_begin;
+  auto const end = code_.data() + unit.ops_end;
+
+  try {
+
+    for (; op != end; ++op) {
+
+      switch (op->kind) {
+
+        case Kind::Add:
+          regs[op->d] = add(regs[op->a], regs[op->b]);
+          break;
+
+        case Kind::Sub:
+          regs[op->d] = subtract(regs[op->a], regs[op->b]);
+          break;
+
+        case Kind::Mul:
+          regs[op->d] = multiply(regs[op->a], regs[op->b]);
+          break;
+
+        case Kind::Div:
+
+          if (regs[op->b] == 0) {
+            throw std::runtime_error("Runtime error: Division by zero!");
+          }
+
+          regs[op->d] = divide(regs[op->a], regs[op->b]);
+          break;
+
+        case Kind::Mod:
+
+          if (regs[op->b] == 0) {
+            throw std::runtime_error("Runtime error: Division by zero!");
+          }
+
+          regs[op->d] = modulo(regs[op->a], regs[op->b]);
+          break;
+
+        case Kind::Store:
+
+          heap_.set(regs[op->a], regs[op->b]);
+          written.emplace_back(regs[op->a]);
+          break;
+
+        case Kind::Retrieve:
+          regs[op->d] = heap_.get(regs[op->a]);
+          break;
+
+        case Kind::PrintChar:
+          out_.put_char(static_cast<char>(regs[op->a]));
+          break;
+
+        case Kind::PrintInt:
+          out_.put_int(regs[op->a]);
+          break;
+
+        case Kind::ReadChar:
+
+          // At the end of the input, -1 is stored.
+          heap_.set(regs[op->a], in_.get_char());
+          written.emplace_back(regs[op->a]);
+          break;
+
+        case Kind::ReadInt: {
+
+          int i;
+          if (!in_.get_int(i)) {
+            throw std::runtime_error("Input error: Integer expected!");
+          }
+
+          heap_.set(regs[op->a], i);
+          written.emplace_back(regs[op->a]);
+          break;
+        }
+
+        default:
+          break;
+      }
+    }
+
+  } catch (std::runtime_error const&) {
+
+    // Restore the stack as it was when the instruction failed.
+    auto const& failure = failures_[op->failure];
+
+    stack_.resize(base);
+    stack_.insert(stack_.end(), regs, regs + (unit.inputs - failure.consumed));
+
+    for (auto slot = failure.begin; slot < failure.begin + failure.size; ++slot) {
+      stack_.emplace_back(regs[slots_[slot]]);
+    }
+
+    program_counter_ = failure.index;
+    throw;
+  }
+
+  stack_.resize(base + unit.keep);
+
+  for (auto slot = unit.spill_begin; slot < unit.spill_begin + unit.spill_size; ++slot) {
+    stack_.emplace_back(regs[slots_[slot]]);
+  }
+
+  switch (unit.exit) {
+
+    case Kind::Call:
+
+      call_stack_.emplace_back(unit.end - 1);
+      program_counter_ = unit.target;
+      break;
+
+    case Kind::Jump:
+
+      program_counter_ = unit.target;
+      break;
+
+    case Kind::JumpZero:
+
+      program_counter_ = (regs[unit.condition] == 0) ? unit.target : unit.end;
+      break;
+
+    case Kind::JumpNeg:
+
+      program_counter_ = (regs[unit.condition] < 0) ? unit.target : unit.end;
+      break;
+
+    case Kind::Ret:
+
+      if (call_stack_.empty()) {
+
+        program_counter_ = unit.end - 1;
+        underflow();
+      }
+
+      program_counter_ = call_stack_.back() + 1;
+      call_stack_.pop_back();
+      break;
+
+    case Kind::End:
+
+      program_counter_ = instrs_.size();
+      break;
+
+    default:
+
+      program_counter_ = unit.end;
+      break;
+  }
+}
+
+
+void RegisterEngine::step(std::vector<int>& written) {
+
+  auto const& instr = instrs_[program_counter_];
+
+  auto top = [this]() -> int& {
+
+    if (stack_.empty()) {
+      underflow();
+    }
+
+    return stack_.back();
+  };
+
+  auto pop = [this]() {
+
+    if (stack_.empty()) {
+      underflow();
+    }
+
+    auto const value = stack_.back();
+    stack_.pop_back();
+
+    return value;
+  };
+
+  auto jump = [this, &instr]() {
+
+    if (instr.target < 0) {
+      throw std::runtime_error("Runtime error: Undefined label!");
+    }
+
+    program_counter_ = instr.target;
+  };
+
+  // Mirrors VirtualMachine, including what is left on the stack when an
+  // instruction fails.
+  switch (instr.kind) {
+
+    case Kind::Push:
+
+      stack_.emplace_back(instr.num);
+      ++program_counter_;
+      break;
+
+    case Kind::Dupl: {
+
+      auto const value = top();
+      stack_.emplace_back(value);
+      ++program_counter_;
+      break;
+    }
+
+    case Kind::Swap: {
+
+      auto const e1 = pop();
+      auto const e2 = pop();
+      stack_.emplace_back(e1);
+      stack_.emplace_back(e2);
+      ++program_counter_;
+      break;
+    }
+
+    case Kind::Discard:
+
+      pop();
+      ++program_counter_;
+      break;
+
+    case Kind::Add:
+    case Kind::Sub:
+    case Kind::Mul:
+    case Kind::Div:
+    case Kind::Mod: {
+
+      auto const y = pop();
+      auto const x = pop();
+
+      if ((instr.kind == Kind::Div || instr.kind == Kind::Mod) && y == 0) {
+        throw std::runtime_error("Runtime error: Division by zero!");
+      }
+
+      switch (instr.kind) {
+        case Kind::Add: stack_.emplace_back(add(x, y)); break;
+        case Kind::Sub: stack_.emplace_back(subtract(x, y)); break;
+        case Kind::Mul: stack_.emplace_back(multiply(x, y)); break;
+        case Kind::Div: stack_.emplace_back(divide(x, y)); break;
+        default:        stack_.emplace_back(modulo(x, y)); break;
+      }
+
+      ++program_counter_;
+      break;
+    }
+
+    case Kind::Store: {
+
+      auto const x = pop();
+      auto const l = pop();
+
+      heap_.set(l, x);
+      written.emplace_back(l);
+
+      ++program_counter_;
+      break;
+    }
+
+    case Kind::Retrieve: {
+
+      auto const l = pop();
+      stack_.emplace_back(heap_.get(l));
+
+      ++program_counter_;
+      break;
+    }
+
+    case Kind::Label:
+
+      ++program_counter_;
+      break;
+
+    case Kind::Call:
+
+      call_stack_.emplace_back(program_counter_);
+      jump();
+      break;
+
+    case Kind::Jump:
+
+      jump();
+      break;
+
+    case Kind::JumpZero:
+    case Kind::JumpNeg: {
+
+      auto const value = top();
+
+      if ((instr.kind == Kind::JumpZero) ? (value == 0) : (value < 0)) {
+        jump();
+      } else {
+        ++program_counter_;
+      }
+
+      stack_.pop_back();
+      break;
+    }
+
+    case Kind::Ret:
+
+      if (call_stack_.empty()) {
+        underflow();
+      }
+
+      program_counter_ = call_stack_.back() + 1;
+      call_stack_.pop_back();
+      break;
+
+    case Kind::End:
+
+      program_counter_ = instrs_.size();
+      break;
+
+    case Kind::PrintChar:
+
+      out_.put_char(static_cast<char>(top()));
+      stack_.pop_back();
+      ++program_counter_;
+      break;
+
+    case Kind::PrintInt:
+
+      out_.put_int(top());
+      stack_.pop_back();
+      ++program_counter_;
+      break;
+
+    case Kind::ReadChar: {
+
+      auto const address = top();
+
+      heap_.set(address, in_.get_char());
+      written.emplace_back(address);
+
+      stack_.pop_back();
+      ++program_counter_;
+      break;
+    }
+
+    case Kind::ReadInt: {
+
+      int i;
+      if (!in_.get_int(i)) {
+        throw std::runtime_error("Input error: Integer expected!");
+      }
+
+      auto const address = top();
+
+      heap_.set(address, i);
+      written.emplace_back(address);
+
+      stack_.pop_back();
+      ++program_counter_;
+      break;
+    }
+  }
+}
+
+
+void RegisterEngine::run_for(unsigned long long const max_steps, std::vector<int>& written) {
+
+  auto const size = instrs_.size();
+  auto const start = steps_;
+
+  while (program_counter_ < size && steps_ - start < max_steps) {
+
+    auto const id = unit_at_[program_counter_];
+
+    if (id >= 0) {
+
+      auto const& unit = units_[id];
+      auto const length = unit.end - unit.begin;
+
+      if (!unit.slow && length <= max_steps - (steps_ - start) &&
+          stack_.size() >= unit.inputs) {
+
+        try {
+
+          run_unit(unit, written);
+
+        } catch (std::runtime_error const&) {
+
+          // The program counter is left at the instruction that failed, and
+          // those of the unit before it were performed.
+          steps_ += program_counter_ - unit.begin;
+          throw;
+        }
+
+        steps_ += length;
+        continue;
+      }
+    }
+
+    step(written);
+    ++steps_;
+  }
+
+  out_.flush();
+}
+
+
+std::vector<int> RegisterEngine::get_stack_top(std::size_t const count) const {
+
+  auto const first = stack_.end() - std::min(count, stack_.size());
+  return std::vector<int>(first, stack_.end());
+}
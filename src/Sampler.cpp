@@ -0,0 +1,171 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Sampler.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/time.h>
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * True while a sampler exists.
+ */
+bool sampling = false;
+
+
+/**
+ * The frame of the outer calls beyond Sampler::max_depth.
+ */
+int const truncated = -2;
+
+
+/**
+ * Start or stop the timer.
+ *
+ * @param frequency The number of signals per second, or 0 to stop.
+ */
+int set_timer(unsigned int const frequency) {
+
+  itimerval timer;
+  std::memset(&timer, 0, sizeof(timer));
+
+  if (frequency > 0) {
+
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = (frequency < 1000000) ? 1000000 / frequency : 1;
+    timer.it_value = timer.it_interval;
+  }
+
+  return ::setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+} // namespace
+
+
+volatile std::sig_atomic_t Sampler::pending_ = 0;
+
+
+void Sampler::handle_signal(int) {
+  pending_ = 1;
+}
+
+
+Sampler::Sampler(VirtualMachine const& vm, unsigned int const frequency) : vm_(vm) {
+
+  if (sampling) {
+    throw std::runtime_error("Only one sampler may run at a time.");
+  }
+
+  if (frequency == 0) {
+    throw std::runtime_error("The sampling frequency must be positive.");
+  }
+
+  auto const& instructions = vm.get_program()->get_instructions();
+  labels_.reserve(instructions.size());
+
+  int label = -1;
+
+  for (std::size_t i = 0; i < instructions.size(); ++i) {
+
+    if (dynamic_cast<SetLbl const*>(instructions[i].get()) != nullptr) {
+      label = i;
+    }
+
+    labels_.emplace_back(label);
+  }
+
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = &Sampler::handle_signal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+
+  if (::sigaction(SIGPROF, &action, &old_action_) < 0) {
+    throw std::runtime_error(std::string("Cannot handle SIGPROF: ") + std::strerror(errno));
+  }
+
+  if (set_timer(frequency) < 0) {
+
+    auto const error = errno;
+    ::sigaction(SIGPROF, &old_action_, nullptr);
+
+    throw std::runtime_error(std::string("Cannot start the profiling timer: ") +
+                             std::strerror(error));
+  }
+
+  pending_ = 0;
+  sampling = true;
+}
+
+
+Sampler::~Sampler() {
+
+  set_timer(0);
+  ::sigaction(SIGPROF, &old_action_, nullptr);
+
+  sampling = false;
+}
+
+
+void Sampler::sample(unsigned int const index) {
+
+  pending_ = 0;
+
+  auto const& call_stack = vm_.get_call_stack();
+  auto const calls = call_stack.top(max_depth);
+
+  std::vector<int> stack;
+  stack.reserve(calls.size() + 2);
+
+  if (calls.size() < call_stack.size()) {
+    stack.emplace_back(truncated);
+  }
+
+  for (auto const call : calls) {
+    stack.emplace_back(labels_[call]);
+  }
+
+  stack.emplace_back(labels_[index]);
+
+  ++stacks_[stack];
+}
+
+
+void Sampler::write_folded(std::ostream& out) const {
+
+  auto const& instructions = vm_.get_program()->get_instructions();
+
+  for (auto const& entry : stacks_) {
+
+    bool first = true;
+
+    for (auto const label : entry.first) {
+
+      out << (first ? "" : ";");
+      first = false;
+
+      if (label == truncated) {
+        out << "(outer calls)";
+      } else if (label < 0) {
+        out << "(start)";
+      } else {
+        out << static_cast<SetLbl const&>(*instructions[label]).get_label();
+      }
+    }
+
+    out << ' ' << entry.second << '\n';
+  }
+
+  out.flush();
+}
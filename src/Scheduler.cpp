@@ -0,0 +1,265 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Scheduler.h"
+
+#include <stdexcept>
+
+using namespace whitepp;
+
+
+Scheduler::Scheduler(unsigned int workers, unsigned long long const quantum) :
+    quantum_(quantum), next_id_(0), stop_(false) {
+
+  if (workers == 0) {
+    workers = 1;
+  }
+
+  for (unsigned int i = 0; i < workers; ++i) {
+    workers_.emplace_back(&Scheduler::work, this);
+  }
+}
+
+
+Scheduler::~Scheduler() {
+
+  wait();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+
+  work_cv_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+
+Scheduler::id_t Scheduler::submit(std::unique_ptr<Session> session, Limits const& limits,
+                                  callback_t const& done) {
+
+  std::unique_ptr<Task> task(new Task());
+  task->session = std::move(session);
+  task->limits = limits;
+  task->done = done;
+  task->start = std::chrono::steady_clock::now();
+  task->status = VirtualMachine::Status::Preempted;
+  task->close = false;
+  task->parked = false;
+
+  if (task->limits.weight == 0) {
+    task->limits.weight = 1;
+  }
+
+  id_t id;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    id = task->id = next_id_++;
+    queue_.emplace_back(task.get());
+
+    if (task->limits.timeout != std::chrono::steady_clock::duration::zero()) {
+      deadlines_.emplace(task->start + task->limits.timeout, id);
+    }
+    tasks_.emplace(id, std::move(task));
+  }
+
+  work_cv_.notify_one();
+
+  return id;
+}
+
+
+bool Scheduler::feed(id_t const id, std::string const& input, bool const close) {
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto const it = tasks_.find(id);
+    if (it == tasks_.end()) {
+      return false;
+    }
+
+    // The input is handed to the session by the worker that runs it next.
+    auto& task = *it->second;
+    task.input += input;
+    task.close = task.close || close;
+
+    if (task.parked) {
+
+      task.parked = false;
+      queue_.emplace_back(&task);
+    }
+  }
+
+  work_cv_.notify_one();
+
+  return true;
+}
+
+
+void Scheduler::wait() {
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this]() { return tasks_.empty(); });
+}
+
+
+bool Scheduler::run_slice(Task& task, Result& result) {
+
+  auto& vm = task.session->get_vm();
+
+  auto const remaining = task.limits.max_steps - vm.get_steps();
+  auto const slice = quantum_ * task.limits.weight;
+
+  try {
+
+    task.status = task.session->run_for(slice < remaining ? slice : remaining);
+
+  } catch (std::runtime_error const& e) {
+
+    result.outcome = Outcome::Failed;
+    result.error = e.what();
+
+    return true;
+  }
+
+  task.output += task.session->take_output();
+
+  // The session is failed and its output cut when it ends in work().
+  if (task.output.size() > task.limits.max_output) {
+    return true;
+  }
+
+  if (task.status == VirtualMachine::Status::Finished) {
+
+    result.outcome = Outcome::Finished;
+    return true;
+  }
+
+  if (vm.get_steps() >= task.limits.max_steps) {
+
+    result.outcome = Outcome::StepLimit;
+    return true;
+  }
+
+  if (task.limits.timeout != std::chrono::steady_clock::duration::zero() &&
+      std::chrono::steady_clock::now() - task.start >= task.limits.timeout) {
+
+    result.outcome = Outcome::Deadline;
+    return true;
+  }
+
+  return false;
+}
+
+
+void Scheduler::work() {
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true) {
+
+    expire();
+
+    while (!stop_ && queue_.empty()) {
+
+      if (deadlines_.empty()) {
+        work_cv_.wait(lock);
+      } else {
+        work_cv_.wait_until(lock, deadlines_.top().first);
+      }
+
+      expire();
+    }
+
+    if (queue_.empty()) {
+      return;
+    }
+
+    auto& task = *queue_.front();
+    queue_.pop_front();
+
+    if (!task.input.empty()) {
+
+      task.session->push_input(task.input);
+      task.input.clear();
+    }
+
+    if (task.close) {
+      task.session->close_input();
+    }
+
+    lock.unlock();
+
+    Result result;
+    bool const ended = run_slice(task, result);
+
+    if (ended) {
+
+      result.output = std::move(task.output);
+      result.output += task.session->take_output();
+
+      if (result.output.size() > task.limits.max_output) {
+
+        result.output.resize(task.limits.max_output);
+        result.outcome = Outcome::Failed;
+        result.error = "Runtime error: Output limit exceeded!";
+      }
+      result.steps = task.session->get_vm().get_steps();
+      result.time = std::chrono::steady_clock::now() - task.start;
+
+      if (task.done) {
+        task.done(task.id, result);
+      }
+    }
+
+    lock.lock();
+
+    if (ended) {
+
+      tasks_.erase(task.id);
+
+      if (tasks_.empty()) {
+        idle_cv_.notify_all();
+      }
+
+    } else if (task.status == VirtualMachine::Status::NeedsInput &&
+               task.input.empty() && !task.close) {
+
+      task.parked = true;
+
+    } else {
+
+      queue_.emplace_back(&task);
+    }
+  }
+}
+
+
+void Scheduler::expire() {
+
+  auto const now = std::chrono::steady_clock::now();
+
+  while (!deadlines_.empty() && deadlines_.top().first <= now) {
+
+    auto const it = tasks_.find(deadlines_.top().second);
+    deadlines_.pop();
+
+    // A task that is queued or running checks its deadline after its slice.
+    if (it != tasks_.end() && it->second->parked) {
+
+      it->second->parked = false;
+      queue_.emplace_back(it->second.get());
+      work_cv_.notify_one();
+    }
+  }
+}
@@ -0,0 +1,266 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Server.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Session.h"
+
+using namespace whitepp;
+
+
+Server::Server(std::string const& path, unsigned int const workers,
+               std::size_t const cache_size, unsigned long long const max_steps,
+               std::size_t const max_connections) :
+    path_(path), fd_(-1), max_steps_(max_steps),
+    max_connections_(max_connections > 0 ? max_connections : 1), cache_(cache_size),
+    scheduler_(workers) {
+
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+
+  if (path_.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path too long: " + path_);
+  }
+
+  std::strcpy(address.sun_path, path_.c_str());
+
+  fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (fd_ < 0) {
+    throw std::runtime_error(std::string("Cannot create socket: ") + std::strerror(errno));
+  }
+
+  ::unlink(path_.c_str());
+
+  if (::bind(fd_, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) < 0 ||
+      ::listen(fd_, SOMAXCONN) < 0) {
+
+    auto const error = errno;
+    ::close(fd_);
+
+    throw std::runtime_error("Cannot listen on " + path_ + ": " + std::strerror(error));
+  }
+}
+
+
+Server::~Server() {
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // Make the threads waiting for requests see the end of their connection.
+  // The fds stay open until the threads are joined, so none is reused.
+  for (auto& connection : connections_) {
+    ::shutdown(connection.fd, SHUT_RDWR);
+  }
+
+  done_cv_.wait(lock, [this]() {
+    for (auto const& connection : connections_) {
+      if (!connection.done) {
+        return false;
+      }
+    }
+    return true;
+  });
+
+  reap();
+
+  lock.unlock();
+
+  ::close(fd_);
+  ::unlink(path_.c_str());
+}
+
+
+void Server::serve() {
+
+  for (;;) {
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+
+      reap();
+
+      if (connections_.size() >= max_connections_) {
+
+        // Further clients wait in the backlog until a connection is done.
+        done_cv_.wait(lock);
+        reap();
+        continue;
+      }
+    }
+
+    int const fd = ::accept(fd_, nullptr, nullptr);
+
+    if (fd < 0) {
+
+      switch (errno) {
+        case EINTR:
+        case ECONNABORTED:
+        case EPROTO:
+          continue;
+        case EMFILE:
+        case ENFILE:
+        case ENOBUFS:
+        case ENOMEM:
+          // Wait for connections or other processes to free resources.
+          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+          continue;
+        default:
+          throw std::runtime_error(std::string("Cannot accept connection: ") +
+                                   std::strerror(errno));
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    connections_.emplace_back();
+    auto& connection = connections_.back();
+    connection.fd = fd;
+    connection.done = false;
+
+    try {
+
+      connection.thread = std::thread(&Server::serve_connection, this, std::ref(connection));
+
+    } catch (std::system_error const&) {
+
+      // No thread could be started; drop the connection and retry later.
+      ::close(fd);
+      connections_.pop_back();
+    }
+  }
+}
+
+
+void Server::reap() {
+
+  for (auto it = connections_.begin(); it != connections_.end();) {
+
+    if (it->done) {
+
+      it->thread.join();
+      ::close(it->fd);
+      it = connections_.erase(it);
+
+    } else {
+
+      ++it;
+    }
+  }
+}
+
+
+void Server::serve_connection(Connection& connection) {
+
+  try {
+
+    protocol::Request request;
+
+    while (protocol::read_request(connection.fd, request)) {
+      protocol::write_response(connection.fd, execute(request));
+    }
+
+  } catch (std::runtime_error const&) {
+
+    // The client sent garbage or went away; drop the connection.
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  connection.done = true;
+  done_cv_.notify_all();
+}
+
+
+protocol::Response Server::execute(protocol::Request const& request) {
+
+  protocol::Response response;
+
+  std::shared_ptr<Program const> program;
+
+  try {
+
+    auto const entry = cache_.get(request.program);
+    program = entry.first;
+    response.cached = entry.second;
+
+  } catch (std::runtime_error const& e) {
+
+    response.status = protocol::Status::Failed;
+    response.error = e.what();
+
+    return response;
+  }
+
+  std::unique_ptr<Session> session(new Session(program));
+  session->push_input(request.input);
+  session->close_input();
+
+  Scheduler::Limits limits;
+  limits.max_steps = max_steps_;
+
+  // Longer output could not be sent.
+  limits.max_output = protocol::max_length;
+
+  if (request.max_steps > 0 && request.max_steps < limits.max_steps) {
+    limits.max_steps = request.max_steps;
+  }
+
+  if (request.timeout_ms > 0) {
+    limits.timeout = std::chrono::milliseconds(request.timeout_ms);
+  }
+
+  // The worker may still be inside set_value() when get() returns, so the
+  // promise is shared with it.
+  auto const promise = std::make_shared<std::promise<Scheduler::Result>>();
+  auto future = promise->get_future();
+
+  scheduler_.submit(std::move(session), limits,
+                    [promise](Scheduler::id_t, Scheduler::Result const& result) {
+                      promise->set_value(result);
+                    });
+
+  auto result = future.get();
+
+  switch (result.outcome) {
+    case Scheduler::Outcome::Finished:
+      response.status = protocol::Status::Finished;
+      break;
+    case Scheduler::Outcome::Failed:
+      response.status = protocol::Status::Failed;
+      break;
+    case Scheduler::Outcome::StepLimit:
+      response.status = protocol::Status::StepLimit;
+      break;
+    case Scheduler::Outcome::Deadline:
+      response.status = protocol::Status::Deadline;
+      break;
+  }
+
+  response.steps = result.steps;
+  response.time_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(result.time).count();
+  response.output = std::move(result.output);
+  response.error = result.error;
+
+  return response;
+}
@@ -0,0 +1,411 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "Trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * The names of the opcodes, in the order of the parser.
+ */
+char const* const opcode_names[] = {
+  "Push", "Dupl", "Swap", "Discard",
+  "Add", "Sub", "Mul", "Div", "Mod",
+  "Store", "Retrieve",
+  "SetLbl", "CallLbl", "Jump", "JumpZero", "JumpNeg", "Ret", "End",
+  "PrintChar", "PrintInt", "ReadChar", "ReadInt"
+};
+
+
+std::size_t const opcode_count = sizeof(opcode_names) / sizeof(opcode_names[0]);
+
+
+/**
+ * This visitor determines the opcode of an instruction, its index into
+ * opcode_names.
+ */
+class OpcodeFinder : public InstructionVisitor {
+
+private:
+
+  std::uint8_t opcode_;
+
+
+public:
+
+  OpcodeFinder() : opcode_(0) {}
+
+
+  /**
+   * @returns The opcode of an instruction.
+   */
+  std::uint8_t find(Instruction& instr) {
+
+    instr.accept(*this);
+    return opcode_;
+  }
+
+
+  virtual void visit(Push& instr) override { opcode_ = 0; }
+  virtual void visit(Dupl& instr) override { opcode_ = 1; }
+  virtual void visit(Swap& instr) override { opcode_ = 2; }
+  virtual void visit(Discard& instr) override { opcode_ = 3; }
+  virtual void visit(Add& instr) override { opcode_ = 4; }
+  virtual void visit(Sub& instr) override { opcode_ = 5; }
+  virtual void visit(Mul& instr) override { opcode_ = 6; }
+  virtual void visit(Div& instr) override { opcode_ = 7; }
+  virtual void visit(Mod& instr) override { opcode_ = 8; }
+  virtual void visit(Store& instr) override { opcode_ = 9; }
+  virtual void visit(Retrieve& instr) override { opcode_ = 10; }
+  virtual void visit(SetLbl& instr) override { opcode_ = 11; }
+  virtual void visit(CallLbl& instr) override { opcode_ = 12; }
+  virtual void visit(Jump& instr) override { opcode_ = 13; }
+  virtual void visit(JumpZero& instr) override { opcode_ = 14; }
+  virtual void visit(JumpNeg& instr) override { opcode_ = 15; }
+  virtual void visit(Ret& instr) override { opcode_ = 16; }
+  virtual void visit(End& instr) override { opcode_ = 17; }
+  virtual void visit(PrintChar& instr) override { opcode_ = 18; }
+  virtual void visit(PrintInt& instr) override { opcode_ = 19; }
+  virtual void visit(ReadChar& instr) override { opcode_ = 20; }
+  virtual void visit(ReadInt& instr) override { opcode_ = 21; }
+
+};
+
+
+/**
+ * The beginning of a binary dump, followed by capacity entries.
+ */
+struct Header {
+
+  char magic[8];
+
+
+  std::uint32_t version;
+
+
+  std::uint32_t capacity;
+
+
+  /**
+   * The number of instructions recorded, of which the last capacity ones
+   * are kept; entry i is at index i % capacity.
+   */
+  std::uint64_t recorded;
+
+
+  /**
+   * The fingerprint of the program traced.
+   */
+  std::uint64_t program;
+
+};
+
+
+char const trace_magic[8] = { 'W', 'h', 'i', 't', 'e', '+', '+', 'T' };
+
+
+/**
+ * The signals after which the trace is dumped before the process dies.
+ */
+int const crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+
+
+std::size_t const crash_signal_count = sizeof(crash_signals) / sizeof(crash_signals[0]);
+
+
+/**
+ * The trace that exists, or nullptr.
+ */
+Trace* active = nullptr;
+
+
+struct sigaction old_request_action;
+
+
+struct sigaction old_crash_actions[crash_signal_count];
+
+
+/**
+ * Write a buffer completely with write(2).
+ */
+void write_all(int const fd, void const* data, std::size_t size) {
+
+  auto bytes = static_cast<char const*>(data);
+
+  while (size > 0) {
+
+    auto const written = ::write(fd, bytes, size);
+
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (written <= 0) {
+      return;
+    }
+
+    bytes += written;
+    size -= written;
+  }
+}
+
+
+/**
+ * Print entries, the oldest first.
+ *
+ * @param first The number of instructions recorded before the first entry.
+ * @param recorded The number of instructions recorded in total.
+ */
+void print_entries(std::ostream& out, std::vector<Trace::Entry> const& entries,
+                   std::uint64_t const first, std::uint64_t const recorded,
+                   Program const* program) {
+
+  out << "# " << recorded << " instructions recorded, the last " << entries.size()
+      << " follow." << std::endl;
+
+  auto number = first;
+
+  for (auto const& entry : entries) {
+
+    out << std::setw(12) << number++ << std::setw(10) << entry.index << "  ";
+
+    auto const name = (program != nullptr) ? program->get_instructions()[entry.index]->to_str()
+                                           : std::string(Trace::opcode_name(entry.opcode));
+
+    out << std::left << std::setw(24) << name << std::right;
+
+    if ((entry.flags & Trace::failed) != 0) {
+      out << "  failed";
+    } else if ((entry.flags & Trace::has_top) != 0) {
+      out << "  top " << entry.top;
+    } else {
+      out << "  empty";
+    }
+
+    out << '\n';
+  }
+
+  out.flush();
+}
+
+} // namespace
+
+
+volatile std::sig_atomic_t Trace::pending_ = 0;
+
+
+void Trace::handle_request(int) {
+  pending_ = 1;
+}
+
+
+void Trace::handle_crash(int signal) {
+
+  // The instruction performed when the signal arrived is the one that
+  // crashed.  SA_RESETHAND restored the default action, so raising the
+  // signal again ends the process as it would have ended without trace.
+  if (active != nullptr) {
+
+    active->record_failure();
+    active->write_raw();
+  }
+
+  ::raise(signal);
+}
+
+
+Trace::Trace(VirtualMachine const& vm, std::size_t const capacity, std::string const& path,
+             bool const text) :
+    vm_(vm), program_(fingerprint(*vm.get_program())), recorded_(0), path_(path), text_(text) {
+
+  if (active != nullptr) {
+    throw std::runtime_error("Only one trace may be recorded at a time.");
+  }
+
+  if (capacity == 0 || capacity > (std::size_t(1) << 31)) {
+    throw std::runtime_error("The trace size must be between 1 and 2^31.");
+  }
+
+  std::size_t size = 1;
+  while (size < capacity) {
+    size *= 2;
+  }
+
+  entries_.resize(size);
+
+  OpcodeFinder finder;
+
+  for (auto const& instr : vm.get_program()->get_instructions()) {
+    opcodes_.emplace_back(finder.find(*instr));
+  }
+
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  sigemptyset(&action.sa_mask);
+
+  action.sa_handler = &Trace::handle_request;
+  action.sa_flags = SA_RESTART;
+  ::sigaction(SIGUSR2, &action, &old_request_action);
+
+  action.sa_handler = &Trace::handle_crash;
+  action.sa_flags = SA_RESETHAND;
+  for (std::size_t i = 0; i < crash_signal_count; ++i) {
+    ::sigaction(crash_signals[i], &action, &old_crash_actions[i]);
+  }
+
+  pending_ = 0;
+  active = this;
+}
+
+
+Trace::~Trace() {
+
+  ::sigaction(SIGUSR2, &old_request_action, nullptr);
+
+  for (std::size_t i = 0; i < crash_signal_count; ++i) {
+    ::sigaction(crash_signals[i], &old_crash_actions[i], nullptr);
+  }
+
+  active = nullptr;
+}
+
+
+void Trace::write_raw() const {
+
+  int const fd = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  if (fd < 0) {
+    return;
+  }
+
+  Header header;
+  std::memcpy(header.magic, trace_magic, sizeof(trace_magic));
+  header.version = version;
+  header.capacity = entries_.size();
+  header.recorded = recorded_;
+  header.program = program_;
+
+  write_all(fd, &header, sizeof(header));
+  write_all(fd, entries_.data(), entries_.size() * sizeof(Entry));
+
+  ::close(fd);
+}
+
+
+void Trace::dump() const {
+
+  std::ofstream out(path_, std::ios::binary);
+
+  if (text_) {
+    write_text(out);
+  } else {
+    write_binary(out);
+  }
+
+  if (!out) {
+    std::cerr << "Cannot write " << path_ << "." << std::endl;
+  }
+}
+
+
+void Trace::write_binary(std::ostream& out) const {
+
+  Header header;
+  std::memcpy(header.magic, trace_magic, sizeof(trace_magic));
+  header.version = version;
+  header.capacity = entries_.size();
+  header.recorded = recorded_;
+  header.program = program_;
+
+  out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+  out.write(reinterpret_cast<char const*>(entries_.data()), entries_.size() * sizeof(Entry));
+  out.flush();
+}
+
+
+void Trace::write_text(std::ostream& out) const {
+
+  auto const count = std::min<std::uint64_t>(recorded_, entries_.size());
+  auto const first = recorded_ - count;
+
+  std::vector<Entry> entries;
+  entries.reserve(count);
+
+  for (auto i = first; i < recorded_; ++i) {
+    entries.emplace_back(entries_[i & (entries_.size() - 1)]);
+  }
+
+  print_entries(out, entries, first, recorded_, vm_.get_program().get());
+}
+
+
+char const* Trace::opcode_name(unsigned int const opcode) {
+  return (opcode < opcode_count) ? opcode_names[opcode] : "?";
+}
+
+
+void Trace::decode(std::istream& in, Program const* program, std::ostream& out) {
+
+  Header header;
+
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      !std::equal(std::begin(trace_magic), std::end(trace_magic), header.magic)) {
+    throw std::runtime_error("Trace error: Not a trace!");
+  }
+
+  if (header.version != version) {
+    throw std::runtime_error("Trace error: Unsupported trace version!");
+  }
+
+  if (header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0) {
+    throw std::runtime_error("Trace error: Invalid trace size!");
+  }
+
+  if (program != nullptr && header.program != fingerprint(*program)) {
+    throw std::runtime_error("Trace error: Trace belongs to another program!");
+  }
+
+  std::vector<Entry> ring(header.capacity);
+
+  if (!in.read(reinterpret_cast<char*>(ring.data()), ring.size() * sizeof(Entry))) {
+    throw std::runtime_error("Trace error: Unexpected end of trace!");
+  }
+
+  auto const count = std::min<std::uint64_t>(header.recorded, ring.size());
+  auto const first = header.recorded - count;
+
+  std::vector<Entry> entries;
+  entries.reserve(count);
+
+  for (auto i = first; i < header.recorded; ++i) {
+
+    auto const& entry = ring[i & (ring.size() - 1)];
+
+    if (program != nullptr && entry.index >= program->size()) {
+      throw std::runtime_error("Trace error: Invalid trace entry!");
+    }
+
+    entries.emplace_back(entry);
+  }
+
+  print_entries(out, entries, first, header.recorded, program);
+}
@@ -7,15 +7,99 @@
  ******************************************************************************/
 #include "VirtualMachine.h"
 
-#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
 
 using namespace whitepp;
 
 
+namespace {
+
+/**
+ * The magic string at the beginning of every snapshot.
+ */
+char const snapshot_magic[8] = { 'W', 'h', 'i', 't', 'e', '+', '+', 'S' };
+
+
+/**
+ * The version of the snapshot format.
+ */
+std::uint32_t const snapshot_version = 1;
+
+
+template <typename T>
+void write_value(std::ostream& out, T const value) {
+  out.write(reinterpret_cast<char const*>(&value), sizeof(value));
+}
+
+
+template <typename T>
+T read_value(std::istream& in) {
+
+  T value;
+  if (!in.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+    throw std::runtime_error("Snapshot error: Unexpected end of snapshot!");
+  }
+
+  return value;
+}
+
+
+template <typename T>
+void write_values(std::ostream& out, std::vector<T> const& values) {
+
+  write_value<std::uint64_t>(out, values.size());
+  for (auto const value : values) {
+    write_value<std::int32_t>(out, value);
+  }
+}
+
+
+template <typename T>
+std::vector<T> read_values(std::istream& in) {
+
+  auto const size = read_value<std::uint64_t>(in);
+
+  std::vector<T> values;
+  for (std::uint64_t i = 0; i < size; ++i) {
+    values.emplace_back(read_value<std::int32_t>(in));
+  }
+
+  return values;
+}
+
+} // namespace
+
+
+volatile std::sig_atomic_t VirtualMachine::state_requested_ = 0;
+
+
+std::ostream* VirtualMachine::state_out_ = nullptr;
+
+
+void VirtualMachine::jump() {
+
+  auto const target = program_->get_target(program_counter_);
+  if (target < 0) {
+    throw std::runtime_error("Runtime error: Undefined label!");
+  }
+
+  program_counter_ = target;
+  branch_taken_ = true;
+}
+
+
 void VirtualMachine::visit(Push& instr) {
 
   stack_.emplace_back(instr.get_num());
   ++program_counter_;
+
+  // Only Push and Dupl grow the stack.
+  if (stack_.size() > peak_stack_) {
+    peak_stack_ = stack_.size();
+  }
 }
 
 
@@ -23,6 +107,10 @@ void VirtualMachine::visit(Dupl& instr) {
 
   stack_.emplace_back(stack_.back());
   ++program_counter_;
+
+  if (stack_.size() > peak_stack_) {
+    peak_stack_ = stack_.size();
+  }
 }
 
 
@@ -98,7 +186,12 @@ void VirtualMachine::visit(Div& instr) {
   auto const x = stack_.back();
   stack_.pop_back();
 
-  stack_.emplace_back(x / y);
+  if (y == 0) {
+    throw std::runtime_error("Runtime error: Division by zero!");
+  }
+
+  // INT_MIN / -1 traps, so it wraps around like the other operations.
+  stack_.emplace_back((y != -1) ? x / y : static_cast<int>(0u - static_cast<unsigned int>(x)));
 
   ++program_counter_;
 }
@@ -112,7 +205,12 @@ void VirtualMachine::visit(Mod& instr) {
   auto const x = stack_.back();
   stack_.pop_back();
 
-  stack_.emplace_back(x % y);
+  if (y == 0) {
+    throw std::runtime_error("Runtime error: Division by zero!");
+  }
+
+  // INT_MIN / -1 traps, so it wraps around like the other operations.
+  stack_.emplace_back((y != -1) ? x % y : 0);
 
   ++program_counter_;
 }
@@ -126,7 +224,7 @@ void VirtualMachine::visit(Store& instr) {
   auto const l = stack_.back();
   stack_.pop_back();
 
-  heap_[l] = x;
+  heap_.set(l, x);
 
   ++program_counter_;
 }
@@ -137,7 +235,7 @@ void VirtualMachine::visit(Retrieve& instr) {
   auto const l = stack_.back();
   stack_.pop_back();
 
-  stack_.emplace_back(heap_[l]);
+  stack_.emplace_back(heap_.get(l));
 
   ++program_counter_;
 }
@@ -152,22 +250,27 @@ void VirtualMachine::visit(CallLbl& instr) {
 
   call_stack_.emplace_back(program_counter_);
 
-  program_counter_ = labels_[instr.get_label()];
+  if (call_stack_.size() > peak_calls_) {
+    peak_calls_ = call_stack_.size();
+  }
+
+  jump();
 }
 
 
 void VirtualMachine::visit(Jump& instr) {
 
-  program_counter_ = labels_[instr.get_label()];
+  jump();
 }
 
 
 void VirtualMachine::visit(JumpZero& instr) {
 
   if (stack_.back() == 0) {
-    program_counter_ = labels_[instr.get_label()];
+    jump();
   } else {
     ++program_counter_;
+    branch_taken_ = false;
   }
 
   stack_.pop_back();
@@ -178,11 +281,12 @@ void VirtualMachine::visit(JumpNeg& instr) {
 
   if (stack_.back() < 0) {
 
-    program_counter_ = labels_[instr.get_label()];
+    jump();
 
   } else {
 
     ++program_counter_;
+    branch_taken_ = false;
   }
 
   stack_.pop_back();
@@ -199,34 +303,53 @@ void VirtualMachine::visit(Ret& instr) {
 void VirtualMachine::visit(End& instr) {
 
   // End by setting program counter to invalid position.
-  program_counter_ = instructions_.size();
+  program_counter_ = program_->size();
 }
 
 
 void VirtualMachine::visit(PrintChar& instr) {
 
-  std::cout << static_cast<char>(stack_.back());
+  out_->put_char(static_cast<char>(stack_.back()));
   stack_.pop_back();
 
+  if (out_->has_backlog()) {
+    suspend(Status::HasOutput);
+  }
+
   ++program_counter_;
 }
 
 
 void VirtualMachine::visit(PrintInt& instr) {
 
-  std::cout << stack_.back();
+  out_->put_int(stack_.back());
   stack_.pop_back();
 
+  if (out_->has_backlog()) {
+    suspend(Status::HasOutput);
+  }
+
   ++program_counter_;
 }
 
 
 void VirtualMachine::visit(ReadChar& instr) {
 
-  char c;
-  std::cin.get(c);
+  if (stop_at_input_ || !in_->ready_char()) {
+    waiting_for_input_ = true;
+    suspend(Status::NeedsInput);
+    return;
+  }
+
+  // The instruction is performed again once a state request that arrives
+  // while waiting is answered.
+  if (!in_->wait(state_requested_, false)) {
+    waiting_for_input_ = true;
+    return;
+  }
 
-  heap_[stack_.back()] = static_cast<int>(c);
+  // At the end of the input, -1 is stored.
+  heap_.set(stack_.back(), in_->get_char());
   stack_.pop_back();
 
   ++program_counter_;
@@ -235,28 +358,189 @@ void VirtualMachine::visit(ReadChar& instr) {
 
 void VirtualMachine::visit(ReadInt& instr) {
 
+  if (stop_at_input_ || !in_->ready_int()) {
+    waiting_for_input_ = true;
+    suspend(Status::NeedsInput);
+    return;
+  }
+
+  if (!in_->wait(state_requested_, true)) {
+    waiting_for_input_ = true;
+    return;
+  }
+
   int i;
-  std::cin >> i;
+  if (!in_->get_int(i)) {
+    throw std::runtime_error("Input error: Integer expected!");
+  }
 
-  heap_[stack_.back()] = i;
+  heap_.set(stack_.back(), i);
   stack_.pop_back();
 
   ++program_counter_;
 }
 
 
-void VirtualMachine::run() {
+void VirtualMachine::check_finished(Status const status) const {
+
+  if (status == Status::NeedsInput) {
+    throw std::runtime_error("Runtime error: Input not available!");
+  } else if (status == Status::Preempted) {
+    throw std::runtime_error("Runtime error: Step limit exceeded!");
+  }
+}
+
+
+VirtualMachine::Status VirtualMachine::resume() {
+  return run_for(std::numeric_limits<unsigned long long>::max());
+}
+
+
+VirtualMachine::Status VirtualMachine::end_slice() {
+
+  out_->flush();
+
+  if (suspended_) {
+
+    suspended_ = false;
+    return suspend_status_;
+  }
+
+  if (program_counter_ < program_->size()) {
+    return Status::Preempted;
+  }
+
+  finished_ = true;
+  return Status::Finished;
+}
+
+
+void VirtualMachine::answer_state_request(unsigned long long const steps) const {
+
+  state_requested_ = 0;
+
+  if (state_out_ != nullptr) {
+    write_state(*state_out_, steps);
+  }
+}
+
+
+void VirtualMachine::write_state(std::ostream& out, unsigned long long const steps) const {
+
+  // The number of stack values and calls printed, the topmost first.
+  std::size_t const shown = 16;
+
+  auto const& instructions = program_->get_instructions();
+
+  out << "State after " << steps << " instructions:" << std::endl;
+
+  if (program_counter_ < instructions.size()) {
+    out << "  Next:  " << program_counter_ << ": " << instructions[program_counter_]->to_str()
+        << std::endl;
+  } else {
+    out << "  Next:  " << program_counter_ << ": (end of program)" << std::endl;
+  }
+
+  auto const values = stack_.top(shown);
+
+  out << "  Stack: " << stack_.size() << " values";
+  for (auto it = values.rbegin(); it != values.rend(); ++it) {
+    out << (it == values.rbegin() ? ", top first: " : " ") << *it;
+  }
+  out << (values.size() < stack_.size() ? " …" : "") << std::endl;
+
+  auto const calls = call_stack_.top(shown);
+
+  out << "  Calls: " << call_stack_.size() << " deep";
+  for (auto it = calls.rbegin(); it != calls.rend(); ++it) {
+    out << (it == calls.rbegin() ? ", innermost first: " : " < ")
+        << static_cast<CallLbl const&>(*instructions[*it]).get_label() << " (from " << *it
+        << ")";
+  }
+  out << (calls.size() < call_stack_.size() ? " < …" : "") << std::endl;
+
+  out << "  Heap:  " << heap_.size() << " cells" << std::endl;
+}
+
+
+void VirtualMachine::run_until_input(unsigned long long const max_steps) {
 
   if (finished_) {
     return;
   }
 
-  // Perform the instructions.
-  while (program_counter_ < instructions_.size()) {
-    instructions_[program_counter_]->accept(*this);
+  stop_at_input_ = true;
+
+  execute(max_steps);
+
+  stop_at_input_ = false;
+  suspended_ = false;
+}
+
+
+void VirtualMachine::save_snapshot(std::ostream& out, std::string const& output) const {
+
+  out.write(snapshot_magic, sizeof(snapshot_magic));
+  write_value<std::uint32_t>(out, snapshot_version);
+  write_value<std::uint64_t>(out, fingerprint(*program_));
+
+  write_value<std::uint32_t>(out, program_counter_);
+  write_value<std::uint8_t>(out, finished_);
+
+  write_values(out, stack_.to_vector());
+  write_values(out, call_stack_.to_vector());
+
+  write_value<std::uint64_t>(out, heap_.size());
+  for (auto const& entry : heap_.entries()) {
+    write_value<std::int32_t>(out, entry.first);
+    write_value<std::int32_t>(out, entry.second);
+  }
+
+  write_value<std::uint64_t>(out, output.size());
+  out.write(output.data(), output.size());
+
+  if (!out) {
+    throw std::runtime_error("Snapshot error: Cannot write snapshot!");
   }
+}
 
-  finished_ = true;
+
+std::string VirtualMachine::load_snapshot(std::istream& in) {
+
+  char magic[sizeof(snapshot_magic)];
+  if (!in.read(magic, sizeof(magic)) ||
+      !std::equal(std::begin(magic), std::end(magic), std::begin(snapshot_magic))) {
+    throw std::runtime_error("Snapshot error: Not a snapshot!");
+  }
+
+  if (read_value<std::uint32_t>(in) != snapshot_version) {
+    throw std::runtime_error("Snapshot error: Unsupported snapshot version!");
+  }
+
+  if (read_value<std::uint64_t>(in) != fingerprint(*program_)) {
+    throw std::runtime_error("Snapshot error: Snapshot belongs to another program!");
+  }
+
+  reset();
+
+  program_counter_ = read_value<std::uint32_t>(in);
+  finished_ = read_value<std::uint8_t>(in);
+
+  stack_.assign(read_values<int>(in));
+  call_stack_.assign(read_values<int>(in));
+
+  auto const heap_size = read_value<std::uint64_t>(in);
+  for (std::uint64_t i = 0; i < heap_size; ++i) {
+    auto const address = read_value<std::int32_t>(in);
+    heap_.set(address, read_value<std::int32_t>(in));
+  }
+
+  std::string output(read_value<std::uint64_t>(in), '\0');
+  if (!in.read(&output[0], output.size())) {
+    throw std::runtime_error("Snapshot error: Unexpected end of snapshot!");
+  }
+
+  return output;
 }
 
 
@@ -267,6 +551,47 @@ void VirtualMachine::reset() {
   call_stack_.clear();
 
   program_counter_ = 0;
+  steps_ = 0;
+  peak_stack_ = 0;
+  peak_calls_ = 0;
 
   finished_ = false;
+  stop_at_input_ = false;
+  suspended_ = false;
+}
+
+
+void VirtualMachine::reset(std::shared_ptr<Program const> const& program) {
+
+  program_ = program;
+  reset();
+}
+
+
+VirtualMachine::Checkpoint VirtualMachine::checkpoint() {
+
+  stack_.freeze();
+  call_stack_.freeze();
+
+  Checkpoint checkpoint;
+
+  checkpoint.heap_ = heap_;
+  checkpoint.stack_ = stack_;
+  checkpoint.call_stack_ = call_stack_;
+  checkpoint.program_counter_ = program_counter_;
+  checkpoint.steps_ = steps_;
+  checkpoint.finished_ = finished_;
+
+  return checkpoint;
+}
+
+
+void VirtualMachine::restore(Checkpoint const& checkpoint) {
+
+  heap_ = checkpoint.heap_;
+  stack_ = checkpoint.stack_;
+  call_stack_ = checkpoint.call_stack_;
+  program_counter_ = checkpoint.program_counter_;
+  steps_ = checkpoint.steps_;
+  finished_ = checkpoint.finished_;
 }
@@ -0,0 +1,166 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include "WorkStealingPool.h"
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * The pool the current thread works for, if any.
+ */
+thread_local WorkStealingPool const* current_pool = nullptr;
+
+
+/**
+ * The index of the current thread in current_pool.
+ */
+thread_local std::size_t current_index = 0;
+
+} // namespace
+
+
+WorkStealingPool::WorkStealingPool(unsigned int workers) :
+    unclaimed_(0), pending_(0), next_queue_(0), stop_(false) {
+
+  if (workers == 0) {
+    workers = 1;
+  }
+
+  for (unsigned int i = 0; i < workers; ++i) {
+    queues_.emplace_back(new Queue());
+  }
+
+  for (unsigned int i = 0; i < workers; ++i) {
+    workers_.emplace_back(&WorkStealingPool::work, this, i);
+  }
+}
+
+
+WorkStealingPool::~WorkStealingPool() {
+
+  wait();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+
+  work_cv_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+
+void WorkStealingPool::submit(task_t task) {
+
+  std::size_t index;
+
+  if (current_pool == this) {
+
+    index = current_index;
+
+  } else {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    index = next_queue_++ % queues_.size();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+    queues_[index]->tasks.emplace_back(std::move(task));
+  }
+
+  // The task is counted only once it is queued, so a worker that claims it
+  // is sure to find a task.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    ++unclaimed_;
+    ++pending_;
+  }
+
+  work_cv_.notify_one();
+}
+
+
+void WorkStealingPool::wait() {
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this]() { return pending_ == 0; });
+}
+
+
+WorkStealingPool::task_t WorkStealingPool::take(std::size_t const index) {
+
+  auto const count = queues_.size();
+
+  for (;;) {
+
+    for (std::size_t i = 0; i < count; ++i) {
+
+      auto& queue = *queues_[(index + i) % count];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+
+      if (queue.tasks.empty()) {
+        continue;
+      }
+
+      task_t task;
+
+      if (i == 0) {
+
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+
+      } else {
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      }
+
+      return task;
+    }
+
+    // Another worker took the task ahead of us while a new one was queued
+    // in a queue already passed, so look once more.
+    std::this_thread::yield();
+  }
+}
+
+
+void WorkStealingPool::work(std::size_t const index) {
+
+  current_pool = this;
+  current_index = index;
+
+  for (;;) {
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cv_.wait(lock, [this]() { return stop_ || unclaimed_ > 0; });
+
+      if (unclaimed_ == 0) {
+        return;
+      }
+
+      --unclaimed_;
+    }
+
+    take(index)();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (--pending_ == 0) {
+      idle_cv_.notify_all();
+    }
+  }
+}
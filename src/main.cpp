@@ -5,48 +5,926 @@
  * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
  *                                                                            *
  ******************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
 
+#include <unistd.h>
+
+#include "AsyncIo.h"
+#include "Batch.h"
+#include "Engine.h"
+#include "InputSource.h"
+#include "Lockstep.h"
+#include "Metrics.h"
+#include "OutputSink.h"
 #include "Parser.h"
+#include "PerfCounters.h"
+#include "Layout.h"
+#include "Profiler.h"
+#include "Program.h"
+#include "Protocol.h"
+#include "RecordRunner.h"
+#include "Recording.h"
+#include "Sampler.h"
+#include "Server.h"
 #include "Tokeniser.h"
+#include "Trace.h"
 #include "VirtualMachine.h"
+#include "WorkStealingPool.h"
 
 
 using namespace whitepp;
 
 
+/**
+ * This struct holds the command line options.
+ */
+struct Options {
+
+  /**
+   * The whitespace program.
+   */
+  std::string file;
+
+
+  /**
+   * The snapshot to write, if any.
+   */
+  std::string snapshot_out;
+
+
+  /**
+   * The snapshot to resume from, if any.
+   */
+  std::string snapshot_in;
+
+
+  /**
+   * The maximal number of instructions performed before taking a snapshot.
+   */
+  unsigned long long snapshot_steps = std::numeric_limits<unsigned long long>::max();
+
+
+  /**
+   * The buffering mode of the standard output.
+   */
+  OutputSink::Mode buffering = isatty(STDOUT_FILENO) ? OutputSink::Mode::Line
+                                                     : OutputSink::Mode::Full;
+
+
+  /**
+   * If true, a dedicated thread performs the input and output.
+   */
+  bool async_io = false;
+
+
+  /**
+   * The maximal number of instructions the program may perform.
+   */
+  unsigned long long max_steps = std::numeric_limits<unsigned long long>::max();
+
+
+  /**
+   * The manifest of a batch of jobs, if any.
+   */
+  std::string batch;
+
+
+  /**
+   * The number of threads running a batch.
+   */
+  unsigned int jobs = std::thread::hardware_concurrency();
+
+
+  /**
+   * If true, the program runs once per record of the standard input.
+   */
+  bool records = false;
+
+
+  /**
+   * The character that ends a record.
+   */
+  char delimiter = '\n';
+
+
+  /**
+   * The maximal number of records in flight, or 0 for a default.
+   */
+  std::size_t window = 0;
+
+
+  /**
+   * The socket to serve requests on, if any.
+   */
+  std::string serve;
+
+
+  /**
+   * The socket of the daemon to send the program to, if any.
+   */
+  std::string client;
+
+
+  /**
+   * The maximal number of programs the daemon keeps parsed.
+   */
+  std::size_t cache_size = 256;
+
+
+  /**
+   * The wall-clock limit in milliseconds the client requests, or 0.
+   */
+  unsigned int timeout_ms = 0;
+
+
+  /**
+   * If true, the client reports the statistics of the execution.
+   */
+  bool stats = false;
+
+
+  /**
+   * If true, the hardware events of each phase are counted and reported.
+   */
+  bool perf_counters = false;
+
+
+  /**
+   * If true, the instructions performed are counted and listed on exit.
+   */
+  bool profile = false;
+
+
+  /**
+   * The file to write the instruction counts to, if any.
+   */
+  std::string profile_out;
+
+
+  /**
+   * The instruction counts to lay out the program by, if any.
+   */
+  std::string layout;
+
+
+  /**
+   * The file to write sampled stacks to, if any.
+   */
+  std::string sample;
+
+
+  /**
+   * The number of samples per second of CPU time.
+   */
+  unsigned int sample_frequency = 997;
+
+
+  /**
+   * The file to write the metrics of the run to, if any.
+   */
+  std::string metrics;
+
+
+  /**
+   * The file to dump the trace of the last instructions to, if any.
+   */
+  std::string trace;
+
+
+  /**
+   * The number of instructions the trace keeps.
+   */
+  std::size_t trace_size = 4096;
+
+
+  /**
+   * If true, the trace is dumped as text instead of binary.
+   */
+  bool trace_text = false;
+
+
+  /**
+   * The file the state is appended to on SIGUSR1, if not the standard error.
+   */
+  std::string state_file;
+
+
+  /**
+   * The engine to run in lockstep with the reference, if any.
+   */
+  std::string verify_against;
+
+
+  /**
+   * The engine to run the program on instead of the virtual machine, if any.
+   */
+  std::string engine;
+
+
+  /**
+   * If true, the program is written in its most compact form instead of run.
+   */
+  bool minify = false;
+
+
+  /**
+   * The file to record the input and output of the run to, if any.
+   */
+  std::string record;
+
+
+  /**
+   * The recording to replay instead of reading the standard input, if any.
+   */
+  std::string replay;
+
+};
+
+
+/**
+ * @returns The names of the engines, separated by commas.
+ */
+std::string engine_list() {
+
+  std::string list;
+
+  for (auto const& name : engine_names()) {
+    list += (list.empty() ? "" : ", ") + name;
+  }
+
+  return list;
+}
+
+
 void print_usage(std::string const& prgName, std::string const& errorMsg) {
 
-  std::cout << "Usage: "   << prgName  << " FILE" << std::endl
+  std::cout << "Usage: "   << prgName  << " [OPTIONS] FILE" << std::endl
+            << "       "   << prgName  << " [OPTIONS] --batch MANIFEST" << std::endl
+            << "       "   << prgName  << " [OPTIONS] --serve SOCKET" << std::endl
+            << "       "   << prgName  << " [OPTIONS] --client SOCKET FILE" << std::endl
             << "This program is a whitespace interpreter." << std::endl
             << "FILE is a whitespace program." << std::endl
+            << "Options:" << std::endl
+            << "  --snapshot-out SNAP   Run until the first input instruction and" << std::endl
+            << "                        write the state to SNAP." << std::endl
+            << "  --snapshot-steps N    Take the snapshot after at most N instructions." << std::endl
+            << "  --snapshot-in SNAP    Resume from the state in SNAP." << std::endl
+            << "  --buffering MODE      Buffer the output per line or fully (MODE is" << std::endl
+            << "                        line or full; default: line on terminals)." << std::endl
+            << "  --async-io            Perform input and output in a separate thread" << std::endl
+            << "                        and report the time the program waited for it." << std::endl
+            << "  --max-steps N         Abort the program after N instructions." << std::endl
+            << "  --batch MANIFEST      Run the jobs in MANIFEST, one \"PROGRAM INPUT" << std::endl
+            << "                        OUTPUT\" per line, and print a summary." << std::endl
+            << "  --records DELIM       Run the program once per record of the input, in" << std::endl
+            << "                        parallel, and write the outputs in order.  DELIM" << std::endl
+            << "                        ends a record: a character, newline, or nul." << std::endl
+            << "  --window N            Keep at most N records in flight." << std::endl
+            << "  --jobs N              Run a batch, records or requests on N threads" << std::endl
+            << "                        (default: one per core)." << std::endl
+            << "  --serve SOCKET        Run programs sent to the Unix socket SOCKET." << std::endl
+            << "  --cache N             Keep the N most recently used programs parsed." << std::endl
+            << "  --client SOCKET       Let the daemon at SOCKET run FILE on the input." << std::endl
+            << "  --timeout MS          Let the daemon abort the program after MS ms." << std::endl
+            << "  --stats               Report the statistics of the daemon's execution." << std::endl
+            << "  --perf-counters       Report the cycles, instructions, branch misses" << std::endl
+            << "                        and cache misses of each phase." << std::endl
+            << "  --profile             Count the instructions performed and print an" << std::endl
+            << "                        annotated listing, hottest blocks first." << std::endl
+            << "  --profile-out FILE    Count the instructions performed and write the" << std::endl
+            << "                        counts to FILE." << std::endl
+            << "  --layout FILE         Reorder the program by the counts in FILE, hot" << std::endl
+            << "                        code first and cold code last." << std::endl
+            << "  --sample FILE         Sample the calls by label on SIGPROF and write" << std::endl
+            << "                        them to FILE as folded stacks for flame graphs." << std::endl
+            << "  --sample-rate HZ      Take HZ samples per second of CPU time" << std::endl
+            << "                        (default: 997)." << std::endl
+            << "  --metrics FILE        Write the times, instructions, peak stack depths," << std::endl
+            << "                        heap size and I/O of the run to FILE as JSON." << std::endl
+            << "  --trace FILE          Keep the last instructions performed and dump" << std::endl
+            << "                        them to FILE on failure, crash or SIGUSR2." << std::endl
+            << "  --trace-size N        Keep the last N instructions (default: 4096)." << std::endl
+            << "  --trace-text          Dump the trace as text instead of binary." << std::endl
+            << "  --state-file FILE     On SIGUSR1, append the state of the program to" << std::endl
+            << "                        FILE instead of the standard error." << std::endl
+            << "  --verify-against ENG  Run the engine ENG in lockstep with the reference" << std::endl
+            << "                        and stop at the first basic block after which" << std::endl
+            << "                        they differ (ENG is " << engine_list() << ")." << std::endl
+            << "  --engine ENG          Run the program on the engine ENG instead of the" << std::endl
+            << "                        virtual machine." << std::endl
+            << "  --minify              Write the program to the standard output without" << std::endl
+            << "                        comments, with the shortest numbers and labels," << std::endl
+            << "                        instead of running it." << std::endl
+            << "  --record FILE         Record the input read, the instructions it was" << std::endl
+            << "                        read after, and the output to FILE." << std::endl
+            << "  --replay FILE         Feed the input recorded in FILE to the program" << std::endl
+            << "                        instead of the standard input, and check that" << std::endl
+            << "                        the run matches the recording." << std::endl
             << "  Error: " << errorMsg << std::endl;
 }
 
 
+/**
+ * This helper function parses the command line.
+ *
+ * Options with a value can be given as "--option value" or "--option=value".
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @returns The options.
+ * @throws std::runtime_error if the command line is invalid.
+ */
+Options parse_options(int argc, char const* argv[]) {
+
+  Options options;
+
+  for (int i = 1; i < argc; ++i) {
+
+    std::string arg = argv[i];
+
+    if (arg.compare(0, 2, "--") != 0) {
+
+      if (!options.file.empty()) {
+        throw std::runtime_error("Please specify exactly one program.");
+      }
+
+      options.file = arg;
+      continue;
+    }
+
+    std::string value;
+    bool has_value = false;
+
+    auto const eq = arg.find('=');
+    if (eq != std::string::npos) {
+
+      value = arg.substr(eq + 1);
+      arg.erase(eq);
+      has_value = true;
+    }
+
+    auto next_value = [&]() {
+
+      if (!has_value) {
+
+        if (i + 1 >= argc) {
+          throw std::runtime_error("Option " + arg + " requires a value.");
+        }
+
+        value = argv[++i];
+      }
+
+      return value;
+    };
+
+    if (arg == "--snapshot-out") {
+      options.snapshot_out = next_value();
+    } else if (arg == "--snapshot-in") {
+      options.snapshot_in = next_value();
+    } else if (arg == "--snapshot-steps") {
+      options.snapshot_steps = std::stoull(next_value());
+    } else if (arg == "--async-io") {
+      options.async_io = true;
+    } else if (arg == "--max-steps") {
+      options.max_steps = std::stoull(next_value());
+    } else if (arg == "--batch") {
+      options.batch = next_value();
+    } else if (arg == "--jobs") {
+      options.jobs = std::stoul(next_value());
+    } else if (arg == "--records") {
+
+      auto const delimiter = next_value();
+      if (delimiter == "newline") {
+        options.delimiter = '\n';
+      } else if (delimiter == "nul") {
+        options.delimiter = '\0';
+      } else if (delimiter.size() == 1) {
+        options.delimiter = delimiter[0];
+      } else {
+        throw std::runtime_error("Unknown delimiter " + delimiter + ".");
+      }
+
+      options.records = true;
+
+    } else if (arg == "--window") {
+      options.window = std::stoul(next_value());
+    } else if (arg == "--serve") {
+      options.serve = next_value();
+    } else if (arg == "--cache") {
+      options.cache_size = std::stoul(next_value());
+    } else if (arg == "--client") {
+      options.client = next_value();
+    } else if (arg == "--timeout") {
+      options.timeout_ms = std::stoul(next_value());
+    } else if (arg == "--stats") {
+      options.stats = true;
+    } else if (arg == "--perf-counters") {
+      options.perf_counters = true;
+    } else if (arg == "--profile") {
+      options.profile = true;
+    } else if (arg == "--profile-out") {
+      options.profile_out = next_value();
+    } else if (arg == "--layout") {
+      options.layout = next_value();
+    } else if (arg == "--sample") {
+      options.sample = next_value();
+    } else if (arg == "--sample-rate") {
+      options.sample_frequency = std::stoul(next_value());
+    } else if (arg == "--metrics") {
+      options.metrics = next_value();
+    } else if (arg == "--trace") {
+      options.trace = next_value();
+    } else if (arg == "--trace-size") {
+      options.trace_size = std::stoul(next_value());
+    } else if (arg == "--trace-text") {
+      options.trace_text = true;
+    } else if (arg == "--state-file") {
+      options.state_file = next_value();
+    } else if (arg == "--verify-against") {
+      options.verify_against = next_value();
+    } else if (arg == "--engine") {
+      options.engine = next_value();
+    } else if (arg == "--minify") {
+      options.minify = true;
+    } else if (arg == "--record") {
+      options.record = next_value();
+    } else if (arg == "--replay") {
+      options.replay = next_value();
+    } else if (arg == "--buffering") {
+
+      auto const mode = next_value();
+      if (mode == "line") {
+        options.buffering = OutputSink::Mode::Line;
+      } else if (mode == "full") {
+        options.buffering = OutputSink::Mode::Full;
+      } else {
+        throw std::runtime_error("Unknown buffering mode " + mode + ".");
+      }
+
+    } else {
+      throw std::runtime_error("Unknown option " + arg + ".");
+    }
+  }
+
+  if ((options.profile || !options.profile_out.empty()) + !options.sample.empty() + !options.trace.empty() +
+      !options.record.empty() + !options.replay.empty() > 1) {
+    throw std::runtime_error("Please either profile, sample, trace, record or replay the program.");
+  }
+
+  // The counts would belong to the reordered program.
+  if (!options.layout.empty() && !options.profile_out.empty()) {
+    throw std::runtime_error("Please either lay out the program or write its profile.");
+  }
+
+  if (!options.snapshot_out.empty() && !(options.record.empty() && options.replay.empty())) {
+    throw std::runtime_error("Please either take a snapshot or record or replay the program.");
+  }
+
+  if (options.file.empty() == (options.batch.empty() && options.serve.empty())) {
+    throw std::runtime_error("Please specify either one program, a batch, or a socket to serve.");
+  }
+
+  return options;
+}
+
+
+/**
+ * This helper function runs a batch of jobs.
+ *
+ * @param options The options.
+ * @returns The exit code.
+ */
+int run_batch(Options const& options) {
+
+  try {
+
+    std::ifstream manifest(options.batch);
+
+    if (!manifest) {
+      throw std::runtime_error("Cannot open " + options.batch + ".");
+    }
+
+    Batch batch(manifest);
+    WorkStealingPool pool(options.jobs);
+
+    batch.run(pool, options.max_steps);
+    batch.print_summary(std::cout);
+
+    return (batch.get_failures() == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  } catch (std::runtime_error const& e) {
+
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
+
+
+/**
+ * This helper function runs the program once per record of the standard
+ * input.
+ *
+ * @param options The options.
+ * @returns The exit code.
+ */
+int run_records(Options const& options) {
+
+  try {
+
+    auto const program = load_program(options.file);
+
+    WorkStealingPool pool(options.jobs);
+    auto const window = (options.window > 0) ? options.window : 16 * pool.size();
+
+    RecordRunner runner(program, pool, window, options.max_steps);
+
+    OutputSink& out = standard_output();
+    out.set_mode(options.buffering);
+
+    auto const failures = runner.run(standard_input(), options.delimiter, out, std::cerr);
+
+    if (failures > 0) {
+
+      std::cerr << failures << " records failed." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+  } catch (std::runtime_error const& e) {
+
+    standard_output().flush();
+
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+ * This helper function runs the program in lockstep with the reference.
+ *
+ * @param options The options.
+ * @returns The exit code.
+ */
+int run_verified(Options const& options) {
+
+  try {
+
+    auto const program = load_program(options.file);
+
+    OutputSink& out = standard_output();
+    out.set_mode(options.buffering);
+
+    Lockstep lockstep(program, options.verify_against, standard_input(), out);
+
+    if (!lockstep.run(options.max_steps, std::cerr)) {
+      return EXIT_FAILURE;
+    }
+
+  } catch (std::runtime_error const& e) {
+
+    standard_output().flush();
+
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+ * This helper function runs the program on another engine.
+ *
+ * @param options The options.
+ * @returns The exit code.
+ */
+int run_engine(Options const& options) {
+
+  // The number of instructions after which the addresses written to, which
+  // are of no use here, are discarded.
+  unsigned long long const slice = 1 << 16;
+
+  try {
+
+    auto const program = load_program(options.file);
+
+    OutputSink& out = standard_output();
+    out.set_mode(options.buffering);
+
+    auto const engine = make_engine(options.engine, program, standard_input(), out);
+    std::vector<int> written;
+
+    while (engine->get_program_counter() < program->size()) {
+
+      if (engine->get_steps() >= options.max_steps) {
+        throw std::runtime_error("Runtime error: Step limit exceeded!");
+      }
+
+      written.clear();
+      engine->run_for(std::min(options.max_steps - engine->get_steps(), slice), written);
+    }
+
+  } catch (std::runtime_error const& e) {
+
+    standard_output().flush();
+
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+ * This helper function writes the program in its most compact form.
+ *
+ * @param options The options.
+ * @returns The exit code.
+ */
+int run_minify(Options const& options) {
+
+  try {
+
+    auto const program = load_program(options.file);
+
+    minify(*program, std::cout);
+    std::cout.flush();
+
+    if (!std::cout) {
+      throw std::runtime_error("Cannot write the program.");
+    }
+
+  } catch (std::runtime_error const& e) {
+
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+ * This helper function runs the daemon.
+ *
+ * @param options The options.
+ * @returns The exit code.
+ */
+int run_server(Options const& options) {
+
+  try {
+
+    Server server(options.serve, options.jobs, options.cache_size, options.max_steps);
+    server.serve();
+
+  } catch (std::runtime_error const& e) {
+
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+ * This helper function lets the daemon run the program on the standard
+ * input.
+ *
+ * @param options The options.
+ * @returns The exit code.
+ */
+int run_client(Options const& options) {
+
+  try {
+
+    protocol::Request request;
+
+    std::ifstream file(options.file, std::ios::binary);
+
+    if (!file) {
+      throw std::runtime_error("Cannot open " + options.file + ".");
+    }
+
+    request.program.assign(std::istreambuf_iterator<char>(file),
+                           std::istreambuf_iterator<char>());
+    request.input.assign(std::istreambuf_iterator<char>(std::cin),
+                         std::istreambuf_iterator<char>());
+
+    if (options.max_steps != std::numeric_limits<unsigned long long>::max()) {
+      request.max_steps = options.max_steps;
+    }
+
+    request.timeout_ms = options.timeout_ms;
+
+    protocol::Response response;
+
+    int const fd = protocol::connect_to(options.client);
+
+    try {
+
+      protocol::write_request(fd, request);
+      protocol::read_response(fd, response);
+
+    } catch (std::runtime_error const&) {
+
+      close(fd);
+      throw;
+    }
+
+    close(fd);
+
+    OutputSink& out = standard_output();
+    out.put_str(response.output);
+    out.flush();
+
+    if (options.stats) {
+
+      std::cerr << "Steps: " << response.steps << ", time: " << response.time_us
+                << " us, cached: " << (response.cached ? "yes" : "no") << std::endl;
+    }
+
+    switch (response.status) {
+      case protocol::Status::Finished:
+        return EXIT_SUCCESS;
+      case protocol::Status::Failed:
+        std::cerr << response.error << std::endl;
+        break;
+      case protocol::Status::StepLimit:
+        std::cerr << "Runtime error: Step limit exceeded!" << std::endl;
+        break;
+      case protocol::Status::Deadline:
+        std::cerr << "Runtime error: Time limit exceeded!" << std::endl;
+        break;
+    }
+
+  } catch (std::runtime_error const& e) {
+
+    std::cerr << e.what() << std::endl;
+  }
+
+  return EXIT_FAILURE;
+}
+
+
+/**
+ * Let the virtual machine print its state at the next instruction.
+ */
+void handle_state_request(int) {
+  VirtualMachine::request_state();
+}
+
+
 int main(int argc, char const* argv[]) {
 
   std::string prgName = argv[0];
 
-  if (argc != 2) {
-    print_usage(prgName, "Please specify one argument.");
+  Options options;
+
+  try {
+
+    options = parse_options(argc, argv);
+
+  } catch (std::exception const& e) {
+
+    print_usage(prgName, e.what());
     return EXIT_FAILURE;
   }
 
+  // Only a plain run answers state requests, see below.  Nothing else
+  // should die of one.
+  struct sigaction ignore_action;
+  std::memset(&ignore_action, 0, sizeof(ignore_action));
+  ignore_action.sa_handler = SIG_IGN;
+  sigemptyset(&ignore_action.sa_mask);
+  ::sigaction(SIGUSR1, &ignore_action, nullptr);
+
+  if (!options.batch.empty()) {
+    return run_batch(options);
+  }
+
+  if (options.records) {
+    return run_records(options);
+  }
+
+  if (!options.serve.empty()) {
+    return run_server(options);
+  }
+
+  if (!options.verify_against.empty()) {
+    return run_verified(options);
+  }
+
+  if (options.minify) {
+    return run_minify(options);
+  }
+
+  if (!options.engine.empty()) {
+    return run_engine(options);
+  }
+
+  if (!options.client.empty()) {
+    return run_client(options);
+  }
+
+  std::ofstream state_file;
+
+  if (!options.state_file.empty()) {
+
+    state_file.open(options.state_file, std::ios::app);
+
+    if (!state_file) {
+
+      std::cerr << "Cannot open " << options.state_file << "." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  VirtualMachine::set_state_output(state_file.is_open() ? &state_file : &std::cerr);
+
+  struct sigaction state_action;
+  std::memset(&state_action, 0, sizeof(state_action));
+  state_action.sa_handler = &handle_state_request;
+  // Without SA_RESTART, the signal interrupts a read waiting for input, so
+  // the request is answered at once.
+  state_action.sa_flags = 0;
+  sigemptyset(&state_action.sa_mask);
+  ::sigaction(SIGUSR1, &state_action, nullptr);
+
+  std::unique_ptr<PerfCounters> counters;
+  PerfCounters::phases_t phases;
+  PerfCounters::values_t phase_events;
+
+  if (options.perf_counters) {
+
+    counters.reset(new PerfCounters());
+    phase_events = counters->read();
+  }
+
+  Metrics metrics;
+
+  typedef std::chrono::steady_clock clock;
+  auto phase_time = clock::now();
+
+  // Record the time and the events since the previous phase ended.
+  auto end_phase = [&](char const* name) {
+
+    auto const now = clock::now();
+    metrics.add_phase(name, now - phase_time);
+    phase_time = now;
+
+    if (counters) {
+
+      auto const events = counters->read();
+      phases.emplace_back(name, PerfCounters::difference(phase_events, events));
+      phase_events = events;
+    }
+  };
+
+  auto write_metrics = [&]() {
+
+    if (options.metrics.empty()) {
+      return;
+    }
+
+    std::ofstream out(options.metrics);
+    metrics.write_json(out);
+
+    if (!out) {
+      std::cerr << "Cannot write " << options.metrics << "." << std::endl;
+    }
+  };
+
   //
   // Get tokens.
   //
 
   Tokeniser tokeniser;
 
-  std::ifstream filestream(argv[1]);
+  std::ifstream filestream(options.file);
   tokeniser.tokenise(filestream);
   filestream.close();
 
   auto tokens = tokeniser.get_tokens();
+  metrics.set_tokens(tokens.size());
+
+  end_phase("tokenise");
 
   //
   // Parse tokens.
@@ -60,6 +938,9 @@ int main(int argc, char const* argv[]) {
 
   } catch (std::runtime_error const& e) {
 
+    metrics.set_error(e.what());
+    write_metrics();
+
     print_usage(prgName, e.what());
     return EXIT_FAILURE;
   }
@@ -68,9 +949,243 @@ int main(int argc, char const* argv[]) {
   // Run virtual machine.
   //
 
-  VirtualMachine vm(parser.get_instructions(), parser.get_labels());
+  auto program = std::make_shared<Program const>(parser.get_instructions(),
+                                                parser.get_labels());
+
+  if (!options.layout.empty()) {
+
+    try {
+
+      std::ifstream file(options.layout);
+
+      if (!file) {
+        throw std::runtime_error("Cannot open " + options.layout + ".");
+      }
+
+      program = lay_out(program, Profiler::read(file, *program));
+
+    } catch (std::runtime_error const& e) {
+
+      metrics.set_error(e.what());
+      write_metrics();
+
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  VirtualMachine vm(program);
+
+  end_phase("parse");
+
+  std::unique_ptr<Profiler> profiler;
+
+  if (options.profile || !options.profile_out.empty()) {
+    profiler.reset(new Profiler(vm));
+  }
+
+  std::unique_ptr<Sampler> sampler;
+  std::unique_ptr<Trace> trace;
+
+  Recording recording;
+  std::unique_ptr<Recorder> recorder;
+
+  // The first difference of the run to the recording replayed.
+  std::string replay_error;
+
+  bool reported = false;
+
+  // Report the counters, the profile, the samples and the metrics, whether
+  // or not the program failed, and dump the trace if it failed.
+  auto report = [&](std::string const& error) {
+
+    if (reported) {
+      return;
+    }
+
+    reported = true;
+
+    end_phase("run");
+
+    if (counters) {
+      counters->print(std::cerr, phases);
+    }
+
+    if (profiler && options.profile) {
+      profiler->print(std::cerr);
+    }
+
+    if (profiler && !options.profile_out.empty()) {
+
+      std::ofstream file(options.profile_out);
+      profiler->write(file);
+
+      if (!file) {
+        std::cerr << "Cannot write " << options.profile_out << "." << std::endl;
+      }
+    }
+
+    if (sampler) {
+
+      std::ofstream folded(options.sample);
+      sampler->write_folded(folded);
+      sampler.reset();
+
+      if (!folded) {
+        std::cerr << "Cannot write " << options.sample << "." << std::endl;
+      }
+    }
+
+    if (trace && !error.empty()) {
+
+      trace->record_failure();
+      trace->dump();
+    }
+
+    if (recorder) {
+      replay_error = recorder->finish(error);
+    }
+
+    if (recorder && !options.record.empty()) {
+
+      std::ofstream file(options.record, std::ios::binary);
+      recording.write(file);
+
+      if (!file) {
+        std::cerr << "Cannot write " << options.record << "." << std::endl;
+      }
+    }
+
+    metrics.set_error(error);
+    metrics.collect(vm);
+    write_metrics();
+  };
+
+  std::unique_ptr<AsyncIo> async_io;
+
+  // Declared here, so the metrics can still read it after a failure.
+  StringOutputSink captured;
+
+  try {
+
+    if (options.async_io) {
 
-  vm.run();
+      async_io.reset(new AsyncIo(STDIN_FILENO, STDOUT_FILENO));
+
+      vm.set_input(async_io->input());
+      vm.set_output(async_io->output());
+    }
+
+    InputSource& in = async_io ? async_io->input() : standard_input();
+    OutputSink& out = async_io ? async_io->output() : standard_output();
+    out.set_mode(options.buffering);
+
+    std::string output;
+
+    if (!options.snapshot_in.empty()) {
+
+      std::ifstream snapshot(options.snapshot_in, std::ios::binary);
+      output = vm.load_snapshot(snapshot);
+    }
+
+    if (!options.snapshot_out.empty()) {
+
+      // Capture the output produced before the first input instruction.
+      vm.set_output(captured);
+
+      vm.run_until_input(options.snapshot_steps);
+
+      std::ofstream snapshot(options.snapshot_out, std::ios::binary);
+      vm.save_snapshot(snapshot, output + captured.get_str());
+
+      report("");
+      return EXIT_SUCCESS;
+    }
+
+    out.put_str(output);
+
+    if (!options.replay.empty()) {
+
+      std::ifstream file(options.replay, std::ios::binary);
+
+      if (!file) {
+        throw std::runtime_error("Cannot open " + options.replay + ".");
+      }
+
+      recording.read(file);
+      recorder.reset(new Recorder(vm, recording, Recorder::Mode::Replay, in, out));
+
+      // Loading the recording is not part of the run to be measured.
+      end_phase("replay");
+
+    } else if (!options.record.empty()) {
+
+      recorder.reset(new Recorder(vm, recording, Recorder::Mode::Record, in, out));
+    }
+
+    if (profiler) {
+
+      vm.run(options.max_steps, *profiler);
+
+    } else if (!options.sample.empty()) {
+
+      sampler.reset(new Sampler(vm, options.sample_frequency));
+      vm.run(options.max_steps, *sampler);
+
+    } else if (!options.trace.empty()) {
+
+      trace.reset(new Trace(vm, options.trace_size, options.trace, options.trace_text));
+      vm.run(options.max_steps, *trace);
+
+    } else if (recorder) {
+
+      vm.run(options.max_steps, *recorder);
+
+    } else {
+
+      vm.run(options.max_steps);
+    }
+
+    out.flush();
+    report("");
+
+    if (async_io) {
+
+      async_io->stop();
+      async_io->print_stalls(std::cerr);
+    }
+
+    if (!replay_error.empty()) {
+
+      std::cerr << replay_error << std::endl;
+      return EXIT_FAILURE;
+    }
+
+  } catch (std::runtime_error const& e) {
+
+    try {
+
+      if (async_io) {
+        async_io->stop();
+      }
+
+      standard_output().flush();
+
+    } catch (std::runtime_error const&) {
+
+      // The error reported below is more relevant.
+    }
+
+    report(e.what());
+
+    std::cerr << e.what() << std::endl;
+
+    if (!replay_error.empty()) {
+      std::cerr << replay_error << std::endl;
+    }
+
+    return EXIT_FAILURE;
+  }
 
   return EXIT_SUCCESS;
 }
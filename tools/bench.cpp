@@ -0,0 +1,623 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "InputSource.h"
+#include "OutputSink.h"
+#include "Parser.h"
+#include "PerfCounters.h"
+#include "Program.h"
+#include "Tokeniser.h"
+#include "VirtualMachine.h"
+
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * The phases timed separately.
+ */
+char const* const phases[] = { "tokenise", "parse", "run" };
+
+
+std::size_t const phase_count = sizeof(phases) / sizeof(phases[0]);
+
+
+/**
+ * The statistics of one phase, in nanoseconds.
+ */
+struct Timing {
+
+  double median = 0;
+
+
+  double p95 = 0;
+
+
+  double min = 0;
+
+
+  /**
+   * The median of each hardware counter, or -1 if it is unavailable.
+   */
+  PerfCounters::values_t counters;
+
+};
+
+
+/**
+ * The result of a benchmark.
+ */
+struct Result {
+
+  std::string name;
+
+
+  unsigned int reps = 0;
+
+
+  std::size_t source_bytes = 0;
+
+
+  unsigned long long instructions = 0;
+
+
+  std::size_t output_bytes = 0;
+
+
+  Timing timings[phase_count];
+
+};
+
+
+/**
+ * @param samples The samples, which are sorted.
+ * @returns The statistics of the samples.
+ */
+Timing summarise(std::vector<double>& samples) {
+
+  std::sort(samples.begin(), samples.end());
+
+  auto const n = samples.size();
+
+  Timing timing;
+  timing.min = samples.front();
+  timing.median = (n % 2 == 1) ? samples[n / 2]
+                               : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+
+  // Nearest rank.
+  auto rank = (95 * n + 99) / 100;
+  timing.p95 = samples[(rank > 0 ? rank : 1) - 1];
+
+  return timing;
+}
+
+
+/**
+ * @param file The name of a file.
+ * @returns The contents of the file.
+ * @throws std::runtime_error if the file cannot be read.
+ */
+std::string read_file(std::string const& file) {
+
+  std::ifstream in(file, std::ios::binary);
+
+  if (!in) {
+    throw std::runtime_error("Cannot open " + file + ".");
+  }
+
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+
+/**
+ * @param samples The samples of each counter in a phase.
+ * @returns The median of each counter, or -1 if it is unavailable.
+ */
+PerfCounters::values_t summarise(std::vector<PerfCounters::values_t> const& samples) {
+
+  PerfCounters::values_t medians;
+
+  for (std::size_t i = 0; i < PerfCounters::count; ++i) {
+
+    std::vector<long long> values;
+
+    for (auto const& sample : samples) {
+      values.emplace_back(sample[i]);
+    }
+
+    std::sort(values.begin(), values.end());
+    medians[i] = values[values.size() / 2];
+  }
+
+  return medians;
+}
+
+
+/**
+ * Run a benchmark.  The input of FILE.ws is FILE.in, if it exists.
+ *
+ * @param file The program.
+ * @param reps The number of repetitions.
+ * @param counters The hardware counters of the thread.
+ * @returns The result.
+ * @throws std::runtime_error if the program fails.
+ */
+Result run_benchmark(std::string const& file, unsigned int const reps,
+                     PerfCounters const& counters) {
+
+  Result result;
+
+  auto const slash = file.find_last_of('/');
+  result.name = file.substr(slash == std::string::npos ? 0 : slash + 1);
+
+  auto const source = read_file(file);
+  result.source_bytes = source.size();
+  result.reps = reps;
+
+  std::string input;
+  auto const dot = file.find_last_of('.');
+  std::ifstream input_file(file.substr(0, dot) + ".in", std::ios::binary);
+
+  if (input_file) {
+    input.assign(std::istreambuf_iterator<char>(input_file), std::istreambuf_iterator<char>());
+  }
+
+  std::vector<double> samples[phase_count];
+  std::vector<PerfCounters::values_t> counter_samples[phase_count];
+
+  for (unsigned int rep = 0; rep < reps; ++rep) {
+
+    typedef std::chrono::steady_clock clock;
+
+    PerfCounters::values_t events[phase_count + 1];
+
+    events[0] = counters.read();
+    auto const start = clock::now();
+
+    Tokeniser tokeniser;
+    std::istringstream in(source);
+    tokeniser.tokenise(in);
+    auto tokens = tokeniser.get_tokens();
+
+    auto const tokenised = clock::now();
+    events[1] = counters.read();
+
+    Parser parser;
+    parser.parse(tokens);
+    auto const program = std::make_shared<Program const>(parser.get_instructions(),
+                                                        parser.get_labels());
+
+    auto const parsed = clock::now();
+    events[2] = counters.read();
+
+    MemoryInputSource source_in(input.data(), input.size());
+    std::size_t output_bytes = 0;
+    CallbackOutputSink sink([&output_bytes](char const*, std::size_t size) {
+      output_bytes += size;
+    });
+
+    VirtualMachine vm(program);
+    vm.set_input(source_in);
+    vm.set_output(sink);
+    vm.run();
+    sink.flush();
+
+    auto const ran = clock::now();
+    events[3] = counters.read();
+
+    std::chrono::duration<double, std::nano> const durations[phase_count] = {
+      tokenised - start, parsed - tokenised, ran - parsed
+    };
+
+    for (std::size_t i = 0; i < phase_count; ++i) {
+
+      samples[i].emplace_back(durations[i].count());
+      counter_samples[i].emplace_back(PerfCounters::difference(events[i], events[i + 1]));
+    }
+
+    result.instructions = vm.get_steps();
+    result.output_bytes = output_bytes;
+  }
+
+  for (std::size_t i = 0; i < phase_count; ++i) {
+
+    result.timings[i] = summarise(samples[i]);
+    result.timings[i].counters = summarise(counter_samples[i]);
+  }
+
+  return result;
+}
+
+
+/**
+ * Write the results as JSON.  Unavailable counters are null.
+ */
+void write_json(std::ostream& out, std::vector<Result> const& results,
+                PerfCounters const& counters) {
+
+  out << "{\n  \"perf_counters\": \""
+      << (counters.is_available() ? "available" : "unavailable: " + counters.get_error())
+      << "\",\n  \"benchmarks\": [";
+
+  for (std::size_t r = 0; r < results.size(); ++r) {
+
+    auto const& result = results[r];
+    auto const run_ns = result.timings[phase_count - 1].median;
+
+    out << (r > 0 ? "," : "") << "\n    {\n"
+        << "      \"name\": \"" << result.name << "\",\n"
+        << "      \"reps\": " << result.reps << ",\n"
+        << "      \"source_bytes\": " << result.source_bytes << ",\n"
+        << "      \"instructions\": " << result.instructions << ",\n"
+        << "      \"output_bytes\": " << result.output_bytes << ",\n"
+        << "      \"instructions_per_second\": "
+        << static_cast<unsigned long long>(run_ns > 0 ? result.instructions * 1e9 / run_ns : 0)
+        << ",\n";
+
+    for (std::size_t i = 0; i < phase_count; ++i) {
+
+      auto const& timing = result.timings[i];
+
+      out << "      \"" << phases[i] << "\": { \"median_ns\": "
+          << static_cast<unsigned long long>(timing.median) << ", \"p95_ns\": "
+          << static_cast<unsigned long long>(timing.p95) << ", \"min_ns\": "
+          << static_cast<unsigned long long>(timing.min) << ",\n"
+          << "        \"counters\": {";
+
+      for (std::size_t c = 0; c < PerfCounters::count; ++c) {
+
+        out << (c > 0 ? ", " : " ") << '"' << PerfCounters::name(c) << "\": ";
+
+        if (timing.counters[c] < 0) {
+          out << "null";
+        } else {
+          out << timing.counters[c];
+        }
+      }
+
+      out << " } }" << (i + 1 < phase_count ? "," : "") << "\n";
+    }
+
+    out << "    }";
+  }
+
+  out << "\n  ]\n}\n";
+}
+
+
+/**
+ * This class reads the medians back from the JSON written above.  It
+ * understands only as much JSON as write_json() produces.
+ */
+class JsonReader {
+
+private:
+
+  std::string text_;
+
+
+  std::size_t pos_;
+
+
+  /**
+   * The name of the benchmark read last.
+   */
+  std::string name_;
+
+
+  void skip_space() {
+
+    while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+      ++pos_;
+    }
+  }
+
+
+  void expect(char const c) {
+
+    skip_space();
+
+    if (pos_ >= text_.size() || text_[pos_] != c) {
+      throw std::runtime_error(std::string("Malformed results: expected '") + c + "'.");
+    }
+
+    ++pos_;
+  }
+
+
+  bool accept(char const c) {
+
+    skip_space();
+
+    if (pos_ < text_.size() && text_[pos_] == c) {
+
+      ++pos_;
+      return true;
+    }
+
+    return false;
+  }
+
+
+  std::string read_string() {
+
+    expect('"');
+
+    auto const end = text_.find('"', pos_);
+    if (end == std::string::npos) {
+      throw std::runtime_error("Malformed results: unterminated string.");
+    }
+
+    auto const str = text_.substr(pos_, end - pos_);
+    pos_ = end + 1;
+
+    return str;
+  }
+
+
+  /**
+   * Read a value, storing numbers as "prefix" -> value.
+   */
+  void read_value(std::string const& prefix, std::map<std::string, double>& values) {
+
+    skip_space();
+
+    if (accept('{')) {
+
+      if (accept('}')) {
+        return;
+      }
+
+      do {
+
+        auto const key = read_string();
+        expect(':');
+        read_value(prefix.empty() ? key : prefix + "." + key, values);
+
+      } while (accept(','));
+
+      expect('}');
+
+    } else if (accept('[')) {
+
+      if (accept(']')) {
+        return;
+      }
+
+      do {
+        read_value(prefix, values);
+      } while (accept(','));
+
+      expect(']');
+
+    } else if (pos_ < text_.size() && text_[pos_] == '"') {
+
+      auto const str = read_string();
+
+      // Names start a new benchmark.
+      if (prefix == "benchmarks.name") {
+        values["#" + str] = 0;
+        name_ = str;
+      }
+
+    } else if (text_.compare(pos_, 4, "null") == 0) {
+
+      pos_ += 4;
+
+    } else {
+
+      char* end;
+      auto const number = std::strtod(text_.c_str() + pos_, &end);
+
+      if (end == text_.c_str() + pos_) {
+        throw std::runtime_error("Malformed results: expected a value.");
+      }
+
+      pos_ = end - text_.c_str();
+      values[name_ + ":" + prefix] = number;
+    }
+  }
+
+
+public:
+
+  JsonReader(std::string const& text) : text_(text), pos_(0) {}
+
+
+  /**
+   * @returns The numbers, keyed by "NAME:benchmarks.FIELD", and the names
+   *          keyed by "#NAME".
+   */
+  std::map<std::string, double> read() {
+
+    std::map<std::string, double> values;
+    read_value("", values);
+
+    return values;
+  }
+
+};
+
+
+/**
+ * Compare two results and report regressions.
+ *
+ * @returns The number of regressions.
+ */
+unsigned int compare(std::string const& old_file, std::string const& new_file,
+                     double const threshold, double const noise_ns) {
+
+  auto const old_values = JsonReader(read_file(old_file)).read();
+  auto const new_values = JsonReader(read_file(new_file)).read();
+
+  unsigned int regressions = 0;
+
+  std::cout << "benchmark\tphase\told_ns\tnew_ns\tchange" << std::endl
+            << std::fixed;
+
+  for (auto const& entry : new_values) {
+
+    if (entry.first[0] != '#') {
+      continue;
+    }
+
+    auto const name = entry.first.substr(1);
+
+    if (old_values.count(entry.first) == 0) {
+
+      std::cout << name << "\t-\t-\t-\tnew" << std::endl;
+      continue;
+    }
+
+    for (auto const phase : phases) {
+
+      auto const key = name + ":benchmarks." + phase + ".median_ns";
+      auto const old_it = old_values.find(key);
+      auto const new_it = new_values.find(key);
+
+      if (old_it == old_values.end() || new_it == new_values.end()) {
+        continue;
+      }
+
+      auto const change = (old_it->second > 0)
+          ? (new_it->second - old_it->second) / old_it->second * 100 : 0;
+
+      // Phases of a few microseconds vary by more than any threshold.
+      bool const regressed = change > threshold &&
+                             new_it->second - old_it->second > noise_ns;
+      regressions += regressed ? 1 : 0;
+
+      std::cout << name << '\t' << phase << '\t' << std::setprecision(0)
+                << old_it->second << '\t' << new_it->second << '\t'
+                << std::setprecision(1) << (change >= 0 ? "+" : "") << change << '%'
+                << (regressed ? "\tREGRESSION" : "") << std::endl;
+    }
+  }
+
+  return regressions;
+}
+
+
+void print_usage(std::string const& prgName) {
+
+  std::cerr << "Usage: " << prgName << " [--reps N] [--out FILE.json] PROGRAM..." << std::endl
+            << "       " << prgName << " --compare OLD.json NEW.json [--threshold PERCENT]" << std::endl
+            << "       " << std::string(prgName.size(), ' ') << " [--noise NS]" << std::endl
+            << "Times tokenising, parsing and running each PROGRAM separately and" << std::endl
+            << "reports median, 95th percentile, the median hardware counters and" << std::endl
+            << "instructions per second as JSON; unavailable counters are null." << std::endl
+            << "The input of FILE.ws is FILE.in, if it exists.  --compare flags" << std::endl
+            << "phases whose median grew by more than PERCENT (default: 5) and by" << std::endl
+            << "more than NS nanoseconds (default: 100000)." << std::endl;
+}
+
+} // namespace
+
+
+int main(int argc, char const* argv[]) {
+
+  unsigned int reps = 10;
+  std::string out_file;
+  std::vector<std::string> files;
+  std::vector<std::string> compare_files;
+  double threshold = 5;
+  double noise_ns = 100000;
+
+  try {
+
+    for (int i = 1; i < argc; ++i) {
+
+      std::string const arg = argv[i];
+
+      auto next_value = [&]() {
+
+        if (i + 1 >= argc) {
+          throw std::runtime_error("Option " + arg + " requires a value.");
+        }
+
+        return std::string(argv[++i]);
+      };
+
+      if (arg == "--reps") {
+        reps = std::stoul(next_value());
+      } else if (arg == "--out") {
+        out_file = next_value();
+      } else if (arg == "--compare") {
+
+        compare_files.emplace_back(next_value());
+        compare_files.emplace_back(next_value());
+
+      } else if (arg == "--threshold") {
+        threshold = std::stod(next_value());
+      } else if (arg == "--noise") {
+        noise_ns = std::stod(next_value());
+      } else if (arg.compare(0, 2, "--") == 0) {
+        throw std::runtime_error("Unknown option " + arg + ".");
+      } else {
+        files.emplace_back(arg);
+      }
+    }
+
+    if (files.empty() == compare_files.empty() || reps == 0) {
+
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+
+    if (!compare_files.empty()) {
+      auto const regressions = compare(compare_files[0], compare_files[1], threshold, noise_ns);
+      return (regressions == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::vector<Result> results;
+    PerfCounters counters;
+
+    if (!counters.is_available()) {
+      std::cerr << "Performance counters unavailable (" << counters.get_error() << ")" << std::endl;
+    }
+
+    for (auto const& file : files) {
+
+      std::cerr << "Running " << file << " …" << std::endl;
+      results.emplace_back(run_benchmark(file, reps, counters));
+    }
+
+    if (out_file.empty()) {
+
+      write_json(std::cout, results, counters);
+
+    } else {
+
+      std::ofstream out(out_file);
+      write_json(out, results, counters);
+    }
+
+  } catch (std::exception const& e) {
+
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,419 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Engine.h"
+#include "InputSource.h"
+#include "Lockstep.h"
+#include "OutputSink.h"
+#include "Parser.h"
+#include "Program.h"
+
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * The parameters of the fuzzing.
+ */
+struct Parameters {
+
+  std::uint64_t seed = 1;
+
+
+  unsigned long long runs = 1000;
+
+
+  /**
+   * The number of instructions of every program.
+   */
+  unsigned long long size = 64;
+
+
+  /**
+   * The number of bytes of input of every program.
+   */
+  unsigned long long input = 32;
+
+
+  unsigned long long max_steps = 100000;
+
+
+  std::string engine = "reference";
+
+};
+
+
+/**
+ * This class generates random programs.
+ *
+ * The programs are built from instructions directly, so they can contain
+ * what no sensible program does: jumps to undefined labels, reads from
+ * cells never written, divisions by zero, and values near the limits of int.
+ * Literals are mostly small, so that stack values can serve as heap
+ * addresses and jump conditions.  The depth of the stack is tracked as if
+ * the program ran straight through, except that a label assumes the least
+ * depth any jump or call to it arrives with, and no jump back arrives with
+ * fewer values than its label assumes.  Returns only follow calls.  So
+ * most programs run for a while before they fail, if at all.
+ */
+class Generator {
+
+private:
+
+  std::mt19937_64 random_;
+
+
+  /**
+   * The instructions to choose from, with their weights.
+   */
+  enum Kind {
+    push, dupl, swap, discard, add, sub, mul, div, mod, store, retrieve,
+    call, jump, jump_zero, jump_neg, ret, end, print_char, print_int, read_char, read_int
+  };
+
+
+  std::discrete_distribution<int> kinds_;
+
+
+  /**
+   * The number of values each kind of instruction pops, and pushes.
+   */
+  static int operands(int const kind, int& results) {
+
+    static int const pops[] = { 0, 1, 2, 1, 2, 2, 2, 2, 2, 2, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 1 };
+    static int const pushes[] = { 1, 2, 2, 0, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    results = pushes[kind];
+    return pops[kind];
+  }
+
+
+  /**
+   * @returns The name of label number n.
+   */
+  static std::string label_name(unsigned long long n) {
+
+    std::string name;
+
+    for (++n; n > 0; n >>= 1) {
+      name += (n & 1) ? 'B' : 'A';
+    }
+
+    return name;
+  }
+
+
+  int literal() {
+
+    switch (std::uniform_int_distribution<int>(0, 15)(random_)) {
+      case 0:
+        return INT_MIN + std::uniform_int_distribution<int>(0, 2)(random_);
+      case 1:
+        return INT_MAX - std::uniform_int_distribution<int>(0, 2)(random_);
+      default:
+        return std::uniform_int_distribution<int>(-4, 16)(random_);
+    }
+  }
+
+
+public:
+
+  /**
+   * The standard constructor.
+   *
+   * @param seed The seed of the random numbers.
+   */
+  Generator(std::uint64_t const seed) :
+      random_(seed),
+      kinds_({ 12, 3, 3, 3, 2, 2, 2, 1, 1, 3, 3, 2, 2, 2, 2, 2, 0.5, 1, 2, 1, 1 }) {}
+
+
+  /**
+   * Generate a program.
+   *
+   * @param size The number of instructions.
+   * @returns The program.
+   */
+  std::shared_ptr<Program const> program(unsigned long long const size) {
+
+    auto const label_count = size / 8 + 1;
+
+    // One label more is used than defined, to cover undefined ones.
+    std::uniform_int_distribution<unsigned long long> used(0, label_count);
+    std::bernoulli_distribution defines(2.0 * label_count / size);
+
+    instructions_t instructions;
+    std::map<std::string, int> labels;
+    int depth = 0;
+
+    // The depth every label assumes: the least depth it is reached with by
+    // the jumps and calls generated so far, or by falling through.
+    std::map<std::string, int> depths;
+
+    // The calls not matched by a return yet, as if the program ran straight
+    // through.
+    int calls = 0;
+
+    while (instructions.size() < size) {
+
+      if (labels.size() < label_count && defines(random_)) {
+
+        auto const name = label_name(labels.size());
+
+        auto const it = depths.find(name);
+        if (it != depths.end() && it->second < depth) {
+          depth = it->second;
+        }
+
+        depths[name] = depth;
+
+        labels.emplace(name, instructions.size());
+        instructions.emplace_back(std::make_shared<SetLbl>(name));
+        continue;
+      }
+
+      auto kind = kinds_(random_);
+      int results;
+
+      // Returns without a call fail at once, as do operations on a too
+      // shallow stack, so pushes are generated instead.
+      if (operands(kind, results) > depth || (kind == ret && calls == 0)) {
+        kind = push;
+      }
+
+      std::string target;
+
+      if (kind == call || kind == jump || kind == jump_zero || kind == jump_neg) {
+
+        target = label_name(used(random_));
+
+        auto const arrival = depth - operands(kind, results);
+        auto const it = depths.find(target);
+
+        if (it == depths.end()) {
+
+          depths.emplace(target, arrival);
+
+        } else if (labels.count(target) == 0) {
+
+          it->second = std::min(it->second, arrival);
+
+        } else if (arrival < it->second) {
+
+          // A jump back that arrives with too few values drains the stack
+          // on every iteration.
+          kind = push;
+        }
+      }
+
+      auto const pops = operands(kind, results);
+
+      calls += (kind == call) - (kind == ret);
+      depth += results - pops;
+
+      std::shared_ptr<Instruction> instr;
+
+      switch (kind) {
+        case push:       instr = std::make_shared<Push>(literal()); break;
+        case dupl:       instr = std::make_shared<Dupl>(); break;
+        case swap:       instr = std::make_shared<Swap>(); break;
+        case discard:    instr = std::make_shared<Discard>(); break;
+        case add:        instr = std::make_shared<Add>(); break;
+        case sub:        instr = std::make_shared<Sub>(); break;
+        case mul:        instr = std::make_shared<Mul>(); break;
+        case div:        instr = std::make_shared<Div>(); break;
+        case mod:        instr = std::make_shared<Mod>(); break;
+        case store:      instr = std::make_shared<Store>(); break;
+        case retrieve:   instr = std::make_shared<Retrieve>(); break;
+        case call:       instr = std::make_shared<CallLbl>(target); break;
+        case jump:       instr = std::make_shared<Jump>(target); break;
+        case jump_zero:  instr = std::make_shared<JumpZero>(target); break;
+        case jump_neg:   instr = std::make_shared<JumpNeg>(target); break;
+        case ret:        instr = std::make_shared<Ret>(); break;
+        case end:        instr = std::make_shared<End>(); break;
+        case print_char: instr = std::make_shared<PrintChar>(); break;
+        case print_int:  instr = std::make_shared<PrintInt>(); break;
+        case read_char:  instr = std::make_shared<ReadChar>(); break;
+        default:         instr = std::make_shared<ReadInt>(); break;
+      }
+
+      instructions.emplace_back(instr);
+    }
+
+    return std::make_shared<Program const>(instructions, labels);
+  }
+
+
+  /**
+   * Generate input, mostly numbers in lines.
+   *
+   * @param size The number of bytes.
+   * @returns The input.
+   */
+  std::string input(unsigned long long const size) {
+
+    static char const alphabet[] = "0123456789-\n\n ab";
+
+    std::uniform_int_distribution<std::size_t> pick(0, sizeof(alphabet) - 2);
+    std::string result;
+
+    while (result.size() < size) {
+      result += alphabet[pick(random_)];
+    }
+
+    return result;
+  }
+
+};
+
+
+void print_usage(std::string const& prgName) {
+
+  std::cerr << "Usage: " << prgName << " [OPTIONS]" << std::endl
+            << "Runs random programs on an engine in lockstep with the reference" << std::endl
+            << "engine and stops at the first program on which they differ." << std::endl
+            << std::endl
+            << "  --seed N       the seed of the first program (default 1); program i" << std::endl
+            << "                 uses seed N + i, so a difference can be reproduced" << std::endl
+            << "                 with --seed N + i --runs 1" << std::endl
+            << "  --runs N       the number of programs (default 1000)" << std::endl
+            << "  --size N       the number of instructions of a program (default 64)" << std::endl
+            << "  --input N      the number of bytes of input of a program (default 32)" << std::endl
+            << "  --max-steps N  the instructions a program may perform (default 100000)" << std::endl
+            << "  --engine NAME  the engine to verify (default reference)" << std::endl;
+}
+
+} // namespace
+
+
+int main(int argc, char const* argv[]) {
+
+  Parameters params;
+
+  try {
+
+    for (int i = 1; i < argc; ++i) {
+
+      std::string const arg = argv[i];
+
+      auto next_value = [&]() {
+
+        if (i + 1 >= argc) {
+          throw std::runtime_error("Option " + arg + " requires a value.");
+        }
+
+        return std::string(argv[++i]);
+      };
+
+      if (arg == "--seed") {
+        params.seed = std::stoull(next_value());
+      } else if (arg == "--runs") {
+        params.runs = std::stoull(next_value());
+      } else if (arg == "--size") {
+        params.size = std::stoull(next_value());
+      } else if (arg == "--input") {
+        params.input = std::stoull(next_value());
+      } else if (arg == "--max-steps") {
+        params.max_steps = std::stoull(next_value());
+      } else if (arg == "--engine") {
+        params.engine = next_value();
+      } else {
+
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    }
+
+    if (params.size < 1 || params.size > INT_MAX) {
+      throw std::runtime_error("The programs must have 1 to 2147483647 instructions.");
+    }
+
+    unsigned long long finished = 0;
+    unsigned long long limited = 0;
+    std::map<std::string, unsigned long long> errors;
+
+    for (unsigned long long run = 0; run < params.runs; ++run) {
+
+      auto const seed = params.seed + run;
+
+      Generator generator(seed);
+      auto const program = generator.program(params.size);
+      auto const input = generator.input(params.input);
+
+      StringInputSource in(input);
+      StringOutputSink out;
+      std::ostringstream report;
+
+      bool agree;
+
+      try {
+
+        Lockstep lockstep(program, params.engine, in, out);
+        agree = lockstep.run(params.max_steps, report);
+
+        if (agree) {
+          ++finished;
+        }
+
+      } catch (std::runtime_error const& e) {
+
+        agree = true;
+
+        if (std::string(e.what()) == "Runtime error: Step limit exceeded!") {
+          ++limited;
+        } else {
+          ++errors[e.what()];
+        }
+      }
+
+      if (!agree) {
+
+        std::cout << "Program " << run + 1 << " (seed " << seed << ") differs." << std::endl
+                  << report.str() << "Input: " << input.size() << " bytes" << std::endl
+                  << "Program:" << std::endl;
+
+        auto const& instructions = program->get_instructions();
+
+        for (std::size_t i = 0; i < instructions.size(); ++i) {
+          std::cout << "  " << std::setw(8) << i << "  " << instructions[i]->to_str() << std::endl;
+        }
+
+        return EXIT_FAILURE;
+      }
+    }
+
+    std::cout << params.runs << " programs agree: " << finished << " ended, " << limited
+              << " exceeded the step limit, and" << std::endl;
+
+    for (auto const& error : errors) {
+      std::cout << std::setw(10) << error.second << " failed with: " << error.first << std::endl;
+    }
+
+  } catch (std::exception const& e) {
+
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
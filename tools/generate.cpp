@@ -0,0 +1,581 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "OutputSink.h"
+
+
+using namespace whitepp;
+
+
+namespace {
+
+/**
+ * The parameters of a generated program.
+ */
+struct Parameters {
+
+  std::uint64_t seed = 1;
+
+
+  /**
+   * The source size to reach with dead code after the end of the program.
+   */
+  unsigned long long size = 0;
+
+
+  /**
+   * The expected fraction of comment characters.
+   */
+  double comment_density = 0;
+
+
+  /**
+   * The number of labels in the dead code.
+   */
+  unsigned long long labels = 0;
+
+
+  unsigned int label_length = 8;
+
+
+  /**
+   * The number of bits of the literals in the dead code.
+   */
+  unsigned int literal_bits = 16;
+
+
+  unsigned long long call_depth = 0;
+
+
+  unsigned long long heap_cells = 0;
+
+
+  /**
+   * The distance between the addresses of two heap cells.
+   */
+  unsigned long long heap_stride = 1;
+
+
+  /**
+   * The number of bytes to output.
+   */
+  unsigned long long output = 0;
+
+};
+
+
+/**
+ * The commands, spelt out in whitespace.
+ */
+namespace cmd {
+
+char const* const push = "  ";
+char const* const dup = " \n ";
+char const* const swap = " \n\t";
+char const* const drop = " \n\n";
+char const* const add = "\t   ";
+char const* const sub = "\t  \t";
+char const* const mul = "\t  \n";
+char const* const div = "\t \t ";
+char const* const mod = "\t \t\t";
+char const* const store = "\t\t ";
+char const* const load = "\t\t\t";
+char const* const put_char = "\t\n  ";
+char const* const put_int = "\t\n \t";
+char const* const get_char = "\t\n\t ";
+char const* const get_int = "\t\n\t\t";
+char const* const mark = "\n  ";
+char const* const call = "\n \t";
+char const* const jump = "\n \n";
+char const* const jump_zero = "\n\t ";
+char const* const jump_neg = "\n\t\t";
+char const* const ret = "\n\t\n";
+char const* const end = "\n\n\n";
+
+} // namespace cmd
+
+
+/**
+ * The labels of the part of the program that runs.  The labels of the dead
+ * code are numbered from label_count on.
+ */
+enum Label : unsigned long long {
+  InitLoop, InitEnd, SumLoop, SumEnd, SumOk, OutLoop, OutNewline, OutNext, OutEnd,
+  Recurse, RecurseEnd, label_count
+};
+
+
+/**
+ * The characters of comments.
+ */
+char const comment_chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789#;.,";
+
+
+/**
+ * This class writes a program, counting its bytes and sprinkling comments
+ * between the tokens.
+ */
+class Generator {
+
+private:
+
+  OutputSink& out_;
+
+
+  Parameters const& params_;
+
+
+  std::mt19937_64 rng_;
+
+
+  unsigned long long written_;
+
+
+  /**
+   * A comment character follows a token iff a random number is below this.
+   */
+  std::uint64_t comment_threshold_;
+
+
+  /**
+   * The length of all labels, enough to tell them apart.
+   */
+  unsigned int label_length_;
+
+
+  void put(char const c) {
+
+    out_.put_char(c);
+    ++written_;
+
+    while (comment_threshold_ > 0 && rng_() < comment_threshold_) {
+
+      out_.put_char(comment_chars[rng_() % (sizeof(comment_chars) - 1)]);
+      ++written_;
+    }
+  }
+
+
+  void put(char const* str) {
+
+    while (*str != '\0') {
+      put(*str++);
+    }
+  }
+
+
+  /**
+   * Write a number with exactly the given number of binary digits.
+   */
+  void number(bool const negative, std::uint64_t const value, unsigned int const bits) {
+
+    put(negative ? '\t' : ' ');
+
+    for (auto bit = bits; bit > 0; --bit) {
+      put(((value >> (bit - 1)) & 1) != 0 ? '\t' : ' ');
+    }
+
+    put('\n');
+  }
+
+
+  /**
+   * Write a number in its shortest form.
+   */
+  void number(long long const n) {
+
+    std::uint64_t const value = (n < 0) ? -static_cast<std::uint64_t>(n) : n;
+
+    unsigned int bits = 1;
+    while (bits < 64 && (value >> bits) != 0) {
+      ++bits;
+    }
+
+    number(n < 0, value, bits);
+  }
+
+
+  void label(unsigned long long const index) {
+
+    for (auto bit = label_length_; bit > 0; --bit) {
+      put(bit <= 64 && ((index >> (bit - 1)) & 1) != 0 ? '\t' : ' ');
+    }
+
+    put('\n');
+  }
+
+
+  void command(char const* cmd, long long const n) {
+
+    put(cmd);
+    number(n);
+  }
+
+
+  void command(char const* cmd, Label const lbl) {
+
+    put(cmd);
+    label(lbl);
+  }
+
+
+  /**
+   * Write the part of the program that runs.
+   */
+  void write_main();
+
+
+  /**
+   * Write a random command of the dead code.
+   */
+  void write_dead_command();
+
+
+public:
+
+  Generator(OutputSink& out, Parameters const& params);
+
+
+  void generate();
+
+};
+
+
+Generator::Generator(OutputSink& out, Parameters const& params) :
+    out_(out), params_(params), rng_(params.seed), written_(0), label_length_(1) {
+
+  // A comment follows a token with probability d, so a fraction d of all
+  // characters are comments.
+  comment_threshold_ = (params.comment_density <= 0) ? 0
+      : static_cast<std::uint64_t>(params.comment_density * 18446744073709551615.0);
+
+  auto const labels = label_count + params.labels;
+  while (label_length_ < 64 && ((labels - 1) >> label_length_) != 0) {
+    ++label_length_;
+  }
+
+  if (params.label_length > label_length_) {
+    label_length_ = params.label_length;
+  }
+}
+
+
+void Generator::write_main() {
+
+  auto const cells = static_cast<long long>(params_.heap_cells);
+  auto const stride = static_cast<long long>(params_.heap_stride);
+
+  // Sets the cells 1, 1 + stride, 1 + 2 * stride, … to 1.
+  command(cmd::push, cells - 1);
+  command(cmd::mark, InitLoop);
+  put(cmd::dup);
+  command(cmd::jump_neg, InitEnd);
+  put(cmd::dup);
+  command(cmd::push, stride);
+  put(cmd::mul);
+  command(cmd::push, 1);
+  put(cmd::add);
+  command(cmd::push, 1);
+  put(cmd::store);
+  command(cmd::push, 1);
+  put(cmd::sub);
+  command(cmd::jump, InitLoop);
+  command(cmd::mark, InitEnd);
+  put(cmd::drop);
+
+  // Sums the cells into cell 0 and divides by zero unless the sum is right.
+  command(cmd::push, 0);
+  command(cmd::push, 0);
+  put(cmd::store);
+  command(cmd::push, cells - 1);
+  command(cmd::mark, SumLoop);
+  put(cmd::dup);
+  command(cmd::jump_neg, SumEnd);
+  put(cmd::dup);
+  command(cmd::push, stride);
+  put(cmd::mul);
+  command(cmd::push, 1);
+  put(cmd::add);
+  put(cmd::load);
+  command(cmd::push, 0);
+  put(cmd::load);
+  put(cmd::add);
+  command(cmd::push, 0);
+  put(cmd::swap);
+  put(cmd::store);
+  command(cmd::push, 1);
+  put(cmd::sub);
+  command(cmd::jump, SumLoop);
+  command(cmd::mark, SumEnd);
+  put(cmd::drop);
+  command(cmd::push, 0);
+  put(cmd::load);
+  command(cmd::push, cells);
+  put(cmd::sub);
+  command(cmd::jump_zero, SumOk);
+  command(cmd::push, 1);
+  command(cmd::push, 0);
+  put(cmd::div);
+  command(cmd::mark, SumOk);
+
+  // Prints lines of 'x', 64 characters each including the newline.
+  command(cmd::push, static_cast<long long>(params_.output) - 1);
+  command(cmd::mark, OutLoop);
+  put(cmd::dup);
+  command(cmd::jump_neg, OutEnd);
+  put(cmd::dup);
+  command(cmd::push, 64);
+  put(cmd::mod);
+  command(cmd::jump_zero, OutNewline);
+  command(cmd::push, 'x');
+  put(cmd::put_char);
+  command(cmd::jump, OutNext);
+  command(cmd::mark, OutNewline);
+  command(cmd::push, '\n');
+  put(cmd::put_char);
+  command(cmd::mark, OutNext);
+  command(cmd::push, 1);
+  put(cmd::sub);
+  command(cmd::jump, OutLoop);
+  command(cmd::mark, OutEnd);
+  put(cmd::drop);
+
+  command(cmd::push, static_cast<long long>(params_.call_depth));
+  command(cmd::call, Recurse);
+  put(cmd::drop);
+  put(cmd::end);
+
+  // Calls itself until the argument is zero.
+  command(cmd::mark, Recurse);
+  put(cmd::dup);
+  command(cmd::jump_zero, RecurseEnd);
+  command(cmd::push, 1);
+  put(cmd::sub);
+  command(cmd::call, Recurse);
+  command(cmd::mark, RecurseEnd);
+  put(cmd::ret);
+}
+
+
+void Generator::write_dead_command() {
+
+  static char const* const simple[] = {
+    cmd::dup, cmd::swap, cmd::drop, cmd::add, cmd::sub, cmd::mul, cmd::div, cmd::mod,
+    cmd::store, cmd::load, cmd::put_char, cmd::put_int, cmd::get_char, cmd::get_int,
+    cmd::ret, cmd::end
+  };
+
+  static char const* const jumps[] = { cmd::call, cmd::jump, cmd::jump_zero, cmd::jump_neg };
+
+  auto const choice = rng_() % 8;
+
+  if (choice < 3) {
+
+    auto const bits = params_.literal_bits;
+    auto const top = std::uint64_t(1) << (bits - 1);
+
+    put(cmd::push);
+    number(rng_() % 2 == 0, top | (rng_() & (top - 1)), bits);
+
+  } else if (choice < 4 && params_.labels > 0) {
+
+    put(jumps[rng_() % 4]);
+    label(label_count + rng_() % params_.labels);
+
+  } else {
+
+    put(simple[rng_() % (sizeof(simple) / sizeof(simple[0]))]);
+  }
+}
+
+
+void Generator::generate() {
+
+  write_main();
+
+  // The dead code fills the rest, with its labels spread evenly.
+  auto const start = written_;
+  auto const budget = (params_.size > start) ? params_.size - start : 0;
+  unsigned long long next_label = 0;
+
+  while (written_ < params_.size || next_label < params_.labels) {
+
+    if (next_label < params_.labels &&
+        (written_ - start) >= static_cast<double>(budget) * next_label / params_.labels) {
+
+      put(cmd::mark);
+      label(label_count + next_label++);
+
+    } else if (written_ < params_.size) {
+
+      write_dead_command();
+
+    } else {
+
+      break;
+    }
+  }
+
+  out_.flush();
+}
+
+
+/**
+ * @param str A number with an optional suffix K, M or G.
+ * @returns The number.
+ * @throws std::runtime_error if str is no number.
+ */
+unsigned long long parse_size(std::string const& str) {
+
+  std::size_t pos;
+  auto value = std::stoull(str, &pos);
+
+  if (pos + 1 == str.size()) {
+
+    switch (str[pos]) {
+      case 'K': case 'k': return value << 10;
+      case 'M': case 'm': return value << 20;
+      case 'G': case 'g': return value << 30;
+    }
+  }
+
+  if (pos != str.size()) {
+    throw std::runtime_error("Invalid size " + str + ".");
+  }
+
+  return value;
+}
+
+
+void print_usage(std::string const& prgName) {
+
+  std::cerr << "Usage: " << prgName << " [--seed N] [--size BYTES] [--comment-density D]" << std::endl
+            << "       " << std::string(prgName.size(), ' ') << " [--labels N] [--label-length BITS] [--literal-bits BITS]" << std::endl
+            << "       " << std::string(prgName.size(), ' ') << " [--call-depth N] [--heap-cells N] [--heap-stride N]" << std::endl
+            << "       " << std::string(prgName.size(), ' ') << " [--output BYTES] [--out FILE.ws]" << std::endl
+            << "Writes a Whitespace program that fills CELLS heap cells STRIDE apart," << std::endl
+            << "sums them, prints BYTES bytes and recurses N calls deep.  Dead code" << std::endl
+            << "after its end, with N labels and literals of BITS bits (at most 31)," << std::endl
+            << "pads the source to SIZE bytes.  Sizes take a suffix K, M or G.  A" << std::endl
+            << "fraction D (below 1) of the characters are comments.  Labels are" << std::endl
+            << "made longer if needed to tell them apart.  The same parameters and" << std::endl
+            << "seed give the same program." << std::endl;
+}
+
+} // namespace
+
+
+int main(int argc, char const* argv[]) {
+
+  Parameters params;
+  std::string out_file;
+
+  try {
+
+    for (int i = 1; i < argc; ++i) {
+
+      std::string const arg = argv[i];
+
+      auto next_value = [&]() {
+
+        if (i + 1 >= argc) {
+          throw std::runtime_error("Option " + arg + " requires a value.");
+        }
+
+        return std::string(argv[++i]);
+      };
+
+      if (arg == "--seed") {
+        params.seed = std::stoull(next_value());
+      } else if (arg == "--size") {
+        params.size = parse_size(next_value());
+      } else if (arg == "--comment-density") {
+        params.comment_density = std::stod(next_value());
+      } else if (arg == "--labels") {
+        params.labels = parse_size(next_value());
+      } else if (arg == "--label-length") {
+        params.label_length = std::stoul(next_value());
+      } else if (arg == "--literal-bits") {
+        params.literal_bits = std::stoul(next_value());
+      } else if (arg == "--call-depth") {
+        params.call_depth = parse_size(next_value());
+      } else if (arg == "--heap-cells") {
+        params.heap_cells = parse_size(next_value());
+      } else if (arg == "--heap-stride") {
+        params.heap_stride = parse_size(next_value());
+      } else if (arg == "--output") {
+        params.output = parse_size(next_value());
+      } else if (arg == "--out") {
+        out_file = next_value();
+      } else {
+
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    }
+
+    // The interpreter computes with int.
+    unsigned long long const max = INT_MAX;
+
+    if (params.comment_density < 0 || params.comment_density >= 1) {
+      throw std::runtime_error("The comment density must be at least 0 and below 1.");
+    }
+
+    if (params.literal_bits < 1 || params.literal_bits > 31) {
+      throw std::runtime_error("The literals must have 1 to 31 bits.");
+    }
+
+    if (params.label_length > 4096) {
+      throw std::runtime_error("The labels must have at most 4096 bits.");
+    }
+
+    if (params.heap_stride < 1 || params.call_depth > max || params.output > max ||
+        (params.heap_cells > 0 && (params.heap_cells - 1) > (max - 1) / params.heap_stride)) {
+      throw std::runtime_error("The calls, heap addresses and output must fit in an int.");
+    }
+
+    int fd = STDOUT_FILENO;
+
+    if (!out_file.empty()) {
+
+      fd = ::open(out_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+      if (fd < 0) {
+        throw std::runtime_error("Cannot open " + out_file + ": " + std::strerror(errno));
+      }
+    }
+
+    {
+      FdOutputSink out(fd);
+      Generator(out, params).generate();
+    }
+
+    if (!out_file.empty() && ::close(fd) < 0) {
+      throw std::runtime_error("Cannot write " + out_file + ": " + std::strerror(errno));
+    }
+
+  } catch (std::exception const& e) {
+
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
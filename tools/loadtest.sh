@@ -0,0 +1,84 @@
+#!/bin/sh
+#******************************************************************************
+#* This file is part of White++.                                              *
+#*                                                                            *
+#* Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+#* Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+#*                                                                            *
+#******************************************************************************
+#
+# Load test for the daemon, entirely on localhost.
+#
+# Starts "White++ --serve" on a temporary socket, sends REQUESTS executions
+# of PROGRAM with CONCURRENCY clients in flight, and compares the wall-clock
+# time with starting one interpreter per execution.  The client is a process
+# of its own, so this measures the parsing and set-up saved per execution;
+# services speaking the protocol directly save the process start as well.
+#
+# Usage: tools/loadtest.sh [PROGRAM [INPUT [REQUESTS [CONCURRENCY]]]]
+
+set -e
+
+BIN=${BIN:-bin/White++}
+REQUESTS=${3:-2000}
+CONCURRENCY=${4:-8}
+
+DIR=$(mktemp -d)
+trap 'kill $SERVER 2> /dev/null; rm -rf "$DIR"' EXIT INT TERM
+
+if [ -n "$1" ]; then
+  PROGRAM=$1
+else
+  # A program printing "Hi" and the sum of two integers it reads.
+  PROGRAM=$DIR/sum.ws
+  printf '   \t  \t   \n\t\n     \t\t \t  \t\n\t\n     \t \t \n\t\n     \n' > "$PROGRAM"
+  printf '\t\n\t\t   \t\n\t\n\t\t   \n\t\t\t   \t\n\t\t\t\t   \t\n \t   \t' >> "$PROGRAM"
+  printf ' \t \n\t\n  \n\n\n' >> "$PROGRAM"
+fi
+
+if [ -n "$2" ]; then
+  INPUT=$2
+else
+  INPUT=$DIR/input.txt
+  printf '20\n22\n' > "$INPUT"
+fi
+
+SOCKET=$DIR/whitepp.sock
+
+"$BIN" --serve "$SOCKET" &
+SERVER=$!
+
+while [ ! -S "$SOCKET" ]; do
+  sleep 0.1
+done
+
+# Check the program once, so a broken setup does not produce timings.
+"$BIN" --client "$SOCKET" --stats "$PROGRAM" < "$INPUT" > /dev/null
+
+now() {
+  date +%s.%N
+}
+
+elapsed() {
+  awk -v start="$1" -v end="$(now)" 'BEGIN { printf "%.3f", end - start }'
+}
+
+rate() {
+  awk -v n="$REQUESTS" -v t="$1" 'BEGIN { printf "%.0f", n / t }'
+}
+
+run() {
+  seq "$REQUESTS" | xargs -P "$CONCURRENCY" -I {} sh -c "$1" > /dev/null
+}
+
+START=$(now)
+run "\"$BIN\" --client \"$SOCKET\" \"$PROGRAM\" < \"$INPUT\""
+DAEMON=$(elapsed "$START")
+
+START=$(now)
+run "\"$BIN\" \"$PROGRAM\" < \"$INPUT\""
+SPAWN=$(elapsed "$START")
+
+echo "$REQUESTS requests, $CONCURRENCY concurrent"
+echo "daemon: $DAEMON s ($(rate "$DAEMON") requests/s)"
+echo "spawn:  $SPAWN s ($(rate "$SPAWN") requests/s)"
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * This file is part of White++.                                              *
+ *                                                                            *
+ * Written by Marcel Lippmann <marcel.lippmann@tu-dresden.de>.                *
+ * Copyright (c) 2016 by Marcel Lippmann.  All rights reserved.               *
+ *                                                                            *
+ ******************************************************************************/
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "Program.h"
+#include "Trace.h"
+
+
+using namespace whitepp;
+
+
+namespace {
+
+void print_usage(std::string const& prgName) {
+
+  std::cerr << "Usage: " << prgName << " TRACE [PROGRAM]" << std::endl
+            << "Prints a trace dumped by White++ --trace, one instruction per line," << std::endl
+            << "the oldest first.  With the traced PROGRAM, the instructions are" << std::endl
+            << "printed with their arguments, and a trace of another program is" << std::endl
+            << "rejected." << std::endl;
+}
+
+} // namespace
+
+
+int main(int argc, char const* argv[]) {
+
+  if (argc < 2 || argc > 3) {
+
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  try {
+
+    std::shared_ptr<Program const> program;
+
+    if (argc == 3) {
+      program = load_program(argv[2]);
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+
+    if (!in) {
+      throw std::runtime_error(std::string("Cannot open ") + argv[1] + ".");
+    }
+
+    Trace::decode(in, program.get(), std::cout);
+
+  } catch (std::runtime_error const& e) {
+
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}